@@ -36,18 +36,33 @@
  */
 
 #include <errno.h>
+#include <math.h>
 #include <pthread.h>
+#include <sched.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/time.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
 #include <time.h>
 
 #include "assert.h"
+#include "capture.h"
+#include "cmdq.h"
 #include "input.h"
 #include "modex.h"
 #include "photo.h"
+#include "port.h"
+#include "profile.h"
+#include "render.h"
+#include "replay.h"
 #include "text.h"
+#include "tile.h"
+#include "trace.h"
+#include "video.h"
+#include "wheel.h"
 #include "world.h"
 #include "./module/tuxctl-ioctl.h"
 #include "./module/mtcp.h"
@@ -63,8 +78,6 @@ static int sanity_check (void);
 #endif
 
 /* My Own Constants */
-#define FOUR_PLANE_SIZE 5760   /* four planes' total size */
-#define FOUR_PLANE_SIZE_M1 5759  /* four planes' size minus 1 */
 #define STATUS_BAR_LENGTH 40     /* length of the bar */
 #define STATUS_BAR_LENGTH_M1 39   /* lenght of the bar minus one */
 const int halfbar = 20;		/* half bar's length */
@@ -74,12 +87,14 @@ const int nearly_fullbar40 = 39; /* full bar's length minus 1 */
 
 /* a few constants */
 #define TICK_USEC      50000 /* tick length in microseconds          */
+#define TICKS_PER_SEC  (1000000 / TICK_USEC)
+#define MAX_CATCHUP    5     /* most late ticks simulated at once    */
+#define LOOP_EVENTS    4     /* events taken per epoll_wait          */
 #define STATUS_MSG_LEN 40    /* maximum length of status message     */
 #define MOTION_SPEED   2     /* pixels moved per command             */
 
 /* Some of the variable */
 static int initial_time = 0;
-static uint8_t bt;
 int32_t enter_room;      /* player has changed rooms        */
 /* outcome of the game */
 typedef enum {GAME_WON, GAME_QUIT} game_condition_t;
@@ -88,10 +103,20 @@ typedef enum {GAME_WON, GAME_QUIT} game_condition_t;
 typedef struct {
     room_t*      where;		 /* current room for player               */
     unsigned int map_x, map_y;   /* current upper left display pixel      */
+    int          overview;       /* 1 if the whole room is shown          */
+    unsigned int back_x, back_y; /* display pixel before the overview     */
     int          x_speed;        /* number of pixels of x motion per move */
     int          y_speed;        /* number of pixels of y motion per move */
 } game_info_t;
 
+/* a count of events per second */
+typedef struct rate_t rate_t;
+struct rate_t {
+    uint32_t cur;		/* events so far this second    */
+    uint32_t total;		/* events in completed seconds  */
+    uint32_t min, max;		/* fewest and most in a second  */
+};
+
 
 /* 
  * enumerated values, structure, and static data used for parsing typed 
@@ -112,6 +137,7 @@ typedef enum { /* TC = typed command */
     TC_GO,
     TC_INSTALL,
     TC_INVENTORY,
+    TC_MAP,
     TC_SIGH,
     TC_USE,
     TC_WEAR,
@@ -138,6 +164,7 @@ static const typed_cmd_t cmd_list[] = {
     {"grab",      2, TC_GET},
     {"install",   3, TC_INSTALL},
     {"inventory", 1, TC_INVENTORY},
+    {"map",       3, TC_MAP},
     {"sigh",      4, TC_SIGH},
     {"use",       3, TC_USE},
     {"wear",      4, TC_WEAR},
@@ -148,7 +175,7 @@ static const typed_cmd_t cmd_list[] = {
 /* local functions--see function headers for details */
 
 static void cancel_tux_thread(void* ignore);
-static void cancel_status_thread (void* ignore);
+static void enter_new_room (void);
 static game_condition_t game_loop (void);
 static int32_t handle_typing (void);
 static void init_game (void);
@@ -157,52 +184,115 @@ static void move_photo_left (void);
 static void move_photo_right (void);
 static void move_photo_up (void);
 static void redraw_room (void);
-static void* status_thread (void* ignore);
-static int time_is_after (struct timeval* t1, struct timeval* t2);
+static void* tux_thread (void* ignore);
+static void expire_status (void* id);
+static uint32_t read_status_msg (char* text, struct timespec* posted);
+static void add_usec (struct timespec* t, long usec);
+static long usec_between (struct timespec* t1, struct timespec* t2);
+static int watch_loop_events (struct timespec* first_tick);
+static void simulate_tick (uint32_t tick);
+static void count_second (rate_t* r);
+static void frame_report (FILE* f);
+static void tick_report (FILE* f);
+static void cpu_report (FILE* f, const struct timespec* start);
+static void write_port_log (void);
 
 
 /* file-scope variables */
 
 static game_info_t game_info; /* game information */
 
+/*
+ * Tick timing, for tick_report: the time spent in each tick or wakeup
+ * for input (handling commands and drawing, from waking up until waiting
+ * again), how late each tick woke relative to its scheduled time, the
+ * number of late ticks simulated to catch up, and the number of ticks
+ * skipped because the loop fell more than MAX_CATCHUP ticks behind.
+ * Times are in microseconds.
+ */
+static uint32_t tick_count;
+static uint32_t ticks_caught_up;
+static uint32_t ticks_missed;
+static uint32_t input_wakes;	/* wakeups for input only      */
+static double   tick_work_sum, tick_work_sq, tick_work_max;
+static double   tick_late_sum, tick_late_sq, tick_late_max;
 
 /* 
- * The variables below are used to keep track of the status message helper
- * thread, with Posix thread id recorded in status_thread_id.  
- *
- * The status_msg records the current status message: when the
- * string recorded there is empty, no status message need be displayed, and
- * the status bar should instead reflect the name of the current room and the
- * player's typing (for typed commands).
- *
- * The status_msg is protected by the msg_lock mutex, which should be
- * acquired before reading or writing the message.  Further, if the message
- * is changed, the helper thread must be notified by signaling it with the 
- * condition variable msg_cv (while holding the msg_lock).
+ * The game loop sleeps in epoll_wait on loop_fd, which watches tick_fd, a
+ * timer that becomes readable at each tick, and the input devices.
  */
-static pthread_t status_thread_id;
-static pthread_mutex_t msg_lock = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t  msg_cv = PTHREAD_COND_INITIALIZER;
-static char status_msg[STATUS_MSG_LEN + 1] = {'\0'};
+static int tick_fd = -1;
+static int loop_fd = -1;
+
+/*
+ * Game state advances in fixed ticks of TICK_USEC, but frames are drawn
+ * by the render thread (see render.h), at its own pace, from views that 
+ * the game loop publishes when what the screen should show changes.  A
+ * view names the room by room_gen, which changes on entering a room, and
+ * the objects by obj_gen, which changes when the room must be redrawn;
+ * the render thread redraws the whole screen when either changes, and 
+ * otherwise draws only what scrolling exposes.  Simulated ticks, drawn
+ * frames, and dropped frames are counted per simulated second for 
+ * frame_report, which divides their totals by the time those seconds 
+ * took to run from the first tick simulated (less than a second each 
+ * when a replay runs fast).
+ */
+static view_t          view;		/* view being built            */
+static view_t          published;	/* view last published         */
+static uint32_t        room_gen;	/* changes on entering a room  */
+static struct timespec room_entered;	/* time room_gen last changed  */
+static uint32_t        obj_gen;		/* changes on redrawing a room */
+static uint32_t        sim_tick;	/* last tick simulated         */
+static uint32_t        seconds;		/* seconds counted             */
+static struct timespec count_start;	/* first tick simulated        */
+static double          counted_secs;	/* time the seconds took       */
+static rate_t          tick_rate, frame_rate, drop_rate;
+static uint32_t        frames_counted, drops_counted; /* by seconds   */
 
-static pthread_t tux_thread_id;
-static pthread_mutex_t tux_lock = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t  tux_cv = PTHREAD_COND_INITIALIZER;
 
 /* 
- * cancel_status_thread
- *   DESCRIPTION: Terminates the status message helper thread.  Used as
- *                a cleanup method to ensure proper shutdown.
- *   INPUTS: none (ignored)
- *   OUTPUTS: none
- *   RETURN VALUE: none
- *   SIDE EFFECTS: none
+ * The current status message is shown in place of the name of the current
+ * room and the player's typing (for typed commands) until it expires; when
+ * there is none, the status bar shows the room and the typing.
+ *
+ * Messages are passed without locks, so neither show_status nor the game
+ * loop ever waits for the other.  show_status copies a message into the
+ * next of MSG_SLOTS slots (numbered by msg_next), publishes its number in
+ * msg_pub (which only increases).  Each slot is a sequence lock: its seq
+ * is odd while the slot is written, so a reader that sees an odd or 
+ * changed seq, or a slot that now holds a newer message, reads again; 
+ * after MSG_SPIN_READS tries in a row, it yields the processor to the 
+ * writer between tries.  When the game loop first sees a message, it sets
+ * msg_timer on the timer wheel to expire the message MSG_EXPIRE_USEC 
+ * after it was posted by recording its number in msg_expired; a newer 
+ * message moves the timer.  Message number 0 means no message.
  */
-static void
-cancel_status_thread (void* ignore)
-{
-    (void)pthread_cancel (status_thread_id);
-}
+#define MSG_SLOTS       4
+#define MSG_SPIN_READS  4
+#define MSG_EXPIRE_USEC 1500000
+typedef struct msg_slot_t msg_slot_t;
+struct msg_slot_t {
+    uint32_t        seq;		/* odd while being written     */
+    uint32_t        id;			/* message number              */
+    struct timespec posted;		/* time posted (monotonic)     */
+    char            text[STATUS_MSG_LEN + 1];
+};
+static msg_slot_t msg_slot[MSG_SLOTS];
+static uint32_t   msg_next;		/* last message number used    */
+static uint32_t   msg_pub;		/* newest message published    */
+static uint32_t   msg_expired;		/* newest message expired      */
+static uint32_t   msg_timed;		/* message msg_timer expires   */
+static wheel_timer_t msg_timer;	/* expires current message     */
+static uint32_t   msg_retries;		/* reads repeated (torn slot)  */
+static double     msg_read_sum, msg_read_max; /* game loop reads (us) */
+
+static pthread_t tux_thread_id;
+
+/* command names for the trace (see trace.h) */
+static const char* const cmd_name[NUM_COMMANDS] = {
+    "none", "right", "left", "up", "down", "move left", "enter", 
+    "move right", "typed", "quit"
+};
 
 /* 
  * cancel_tux_thread
@@ -232,24 +322,37 @@ cancel_tux_thread (void* ignore)
 static game_condition_t
 game_loop ()
 {
-	unsigned int what_time_is_it;
     /* 
      * Variables used to carry information between event loop ticks; see
      * initialization below for explanations of purpose.
      */
-    struct timeval start_time, tick_time;
-
-    struct timeval cur_time; /* current time (during tick)      */
-    cmd_t cmd;               /* command issued by input control */
+    struct timespec start_time, tick_time;
+
+    struct timespec cur_time;  /* current time (during tick)        */
+    struct timespec wake_time; /* time at which the tick began      */
+    struct epoll_event ev[LOOP_EVENTS]; /* events that woke the loop */
+    uint64_t expired;          /* ticks due since the last wakeup   */
+    int input;                 /* 1 if woken by input               */
+    uint64_t count;            /* commands queued (unused)          */
+    int n, i;                  /* count of and index over events    */
+    double usec;               /* duration measured for a tick      */
+    cmd_t cmd;                 /* command issued by input control   */
+    cmd_event_t cev;           /* command taken from the queue      */
 
     /* Record the starting time--assume success. */
-    (void)gettimeofday (&start_time, NULL);
+    (void)clock_gettime (CLOCK_MONOTONIC, &start_time);
+    wake_time = start_time;
 
     /* Calculate the time at which the first event loop tick should occur. */
     tick_time = start_time;
-    if ((tick_time.tv_usec += TICK_USEC) > 1000000) {
-	tick_time.tv_sec++;
-	tick_time.tv_usec -= 1000000;
+    add_usec (&tick_time, TICK_USEC);
+
+    /* Start the tick timer, and watch it and the input devices. */
+    if (0 != watch_loop_events (&tick_time)) {
+	clear_mode_X ();
+	shutdown_input ();
+	perror ("tick timer");
+	exit (3);
     }
 
     /* The player has just entered the first room. */
@@ -258,30 +361,17 @@ game_loop ()
     /* The main event loop. */
     while (1) {
 	/* 
-	 * Update the screen, preparing the VGA palette and photo-drawing
-	 * routines and drawing a new room photo first if the player has
-	 * entered a new room, then showing the screen (and status bar,
-	 * once you have it working).
+	 * Update the view, resetting it first if the player has entered a
+	 * new room, then publish it (with the status bar) for the render
+	 * thread.
 	 */
 	if (enter_room) {
-	    /* Reset the view window to (0,0). */
-	    game_info.map_x = game_info.map_y = 0;
-	    set_view_window (game_info.map_x, game_info.map_y);
-
-	    /* Discard any partially-typed command. */
-	    reset_typed_command ();
-	    
-	    /* Adjust colors and photo drawing for the current room photo. */
-	    prep_room (game_info.where);
-
-	    /* Draw the room (calls show. */
-	    redraw_room ();
+	    enter_new_room ();
 
 	    /* Only draw once on entry. */
 	    enter_room = 0;
 	}
 
-	show_screen ();
 	/*
 	 *  Draw the status bar, in order to draw the status bar:
 	 	1. We should aggregate all of the useful message into a brand new char* .
@@ -290,15 +380,34 @@ game_loop ()
 	*/
 
 	unsigned char status_bar_input[STATUS_BAR_LENGTH];
-	/* Load the data of status buffer */
-	unsigned char status_bar_buf[FOUR_PLANE_SIZE];
-
-	/* Critical Section, add a lock to control the message */
-	(void)pthread_mutex_lock(&msg_lock);
-	/*initialize status_bar_buffer*/
-	int itera = 0;
-	for(itera = 0; itera < FOUR_PLANE_SIZE_M1; itera++){
-		status_bar_buf[itera] = 0;
+
+	/* Take a snapshot of the status message (without a lock) */
+	char status_msg[STATUS_MSG_LEN + 1];
+	struct timespec read_start, read_end, posted;
+	uint32_t msg_id;
+	long delay;
+	PROF_BEGIN (status_start);
+	(void)clock_gettime (CLOCK_MONOTONIC, &read_start);
+	msg_id = read_status_msg (status_msg, &posted);
+	(void)clock_gettime (CLOCK_MONOTONIC, &read_end);
+	usec = (read_end.tv_sec - read_start.tv_sec) * 1e6 +
+	       (read_end.tv_nsec - read_start.tv_nsec) / 1e3;
+	msg_read_sum += usec;
+	if (usec > msg_read_max) {
+		msg_read_max = usec;
+	}
+
+	/* Expire a newly seen message MSG_EXPIRE_USEC after it was posted. */
+	if (msg_id != msg_timed) {
+		msg_timed = msg_id;
+		if (0 != msg_id) {
+			delay = (posted.tv_sec - read_end.tv_sec) * 1000000L +
+				(posted.tv_nsec - read_end.tv_nsec) / 1000 +
+				MSG_EXPIRE_USEC;
+			wheel_add (&msg_timer, 
+				   delay <= 0 ? 0 : (delay + TICK_USEC - 1) / TICK_USEC,
+				   expire_status, (void*)(uintptr_t)msg_id);
+		}
 	}
 
 	/* FIRST, AGGREGATE THE THREE PART OF THE STRING (room_name(game_info.where), status_msg, get_typed_command()) */
@@ -359,104 +468,201 @@ game_loop ()
 			status_bar_input[nearly_fullbar40] = UNDERLINE;
 		}
 	}
+	PROF_END (PROF_STATUS_TEXT, status_start);
 	
-	
-	/* Call show_status_bar(status_bar_input) */
-	show_status_bar(status_bar_input,status_bar_buf);
+	/* 
+	 * Publish the view for the render thread if it has changed.  The
+	 * objects are copied each time, as commands may move them.
+	 */
+	PROF_BEGIN (publish_start);
+	view.photo = room_photo (game_info.where);
+	view.room_gen = room_gen;
+	view.entered = room_entered;
+	view.obj_gen = obj_gen;
+	view.map_x = game_info.map_x;
+	view.map_y = game_info.map_y;
+	view.overview = game_info.overview;
+	view.n_objs = get_room_objects (game_info.where, view.obj, 
+					PHOTO_MAX_OBJS);
+	(void)memset (&view.obj[view.n_objs], 0, 
+		      (PHOTO_MAX_OBJS - view.n_objs) * sizeof (view.obj[0]));
+	(void)memcpy (view.status, status_bar_input, STATUS_BAR_CELLS);
+	if (0 != memcmp (&view, &published, sizeof (view))) {
+	    published = view;
+	    render_publish (&view);
+	    TRACE_MARK ("publish view", NULL);
+
+	    /* When replaying in steps, every view is drawn. */
+	    if (replay_step ()) {
+		render_sync ();
+	    }
+	}
+	PROF_END (PROF_PUBLISH, publish_start);
+
+	/* Record the time spent in this tick. */
+	(void)clock_gettime (CLOCK_MONOTONIC, &cur_time);
+	usec = usec_between (&wake_time, &cur_time);
+	tick_work_sum += usec;
+	tick_work_sq += usec * usec;
+	if (tick_work_max < usec) {
+	    tick_work_max = usec;
+	}
 
-	/* End of Critical Section: Unlock it */
-	(void)pthread_mutex_unlock (&msg_lock);
 	/*
 	 * Wait for tick.  The tick defines the basic timing of our
 	 * event loop, and is the minimum amount of time between events.
+	 * The loop sleeps until the tick timer expires or input arrives,
+	 * and handles input as soon as it arrives rather than at the next
+	 * tick.  The timer counts each tick that comes due; if we missed 
+	 * one or more ticks completely, each is simulated once to catch up,
+	 * up to MAX_CATCHUP ticks, and any more are skipped.  Ticks caught
+	 * up and skipped are counted for tick_report.  When replaying as 
+	 * fast as possible, the loop does not wait; each tick is due at 
+	 * once.
 	 */
-	do {
-	    if (gettimeofday (&cur_time, NULL) != 0) {
+	expired = 0;
+	input = 0;
+	PROF_BEGIN (wait_start);
+	if (replay_fast ()) {
+	    expired = 1;
+	}
+	while (0 == expired && !input) {
+	    n = epoll_wait (loop_fd, ev, LOOP_EVENTS, -1);
+	    if (0 > n && EINTR != errno) {
 		/* Panic!  (should never happen) */
 		clear_mode_X ();
 		shutdown_input ();
-		perror ("gettimeofday");
+		perror ("epoll_wait");
 		exit (3);
 	    }
-	} while (!time_is_after (&cur_time, &tick_time));
-
-	/*
-	 * Advance the tick time.  If we missed one or more ticks completely, 
-	 * i.e., if the current time is already after the time for the next 
-	 * tick, just skip the extra ticks and advance the clock to the one
-	 * that we haven't missed.
-	 */
-	do {
-	    if ((tick_time.tv_usec += TICK_USEC) > 1000000) {
-		tick_time.tv_sec++;
-		tick_time.tv_usec -= 1000000;
+	    for (i = 0; n > i; i++) {
+		if (tick_fd == ev[i].data.fd) {
+		    if (sizeof (expired) != 
+			read (tick_fd, &expired, sizeof (expired))) {
+			expired = 0;
+		    }
+		    continue;
+		}
+		/* Stop watching input that has closed, or we would spin. */
+		if (0 != (ev[i].events & (EPOLLHUP | EPOLLERR))) {
+		    (void)epoll_ctl (loop_fd, EPOLL_CTL_DEL, ev[i].data.fd,
+				     NULL);
+		}
+		input = 1;
 	    }
-	} while (time_is_after (&cur_time, &tick_time));
+	}
+	PROF_END (PROF_WAIT, wait_start);
+	(void)clock_gettime (CLOCK_MONOTONIC, &cur_time);
+	wake_time = cur_time;
+	prof_poll (stdout);
+
+	if (0 == expired) {
+	    input_wakes++;
+	} else {
+	    /* 
+	     * Record how late the last tick due woke up (unless replaying
+	     * fast, when ticks are not waited for).
+	     */
+	    if (!replay_fast ()) {
+		add_usec (&tick_time, (long)(expired - 1) * TICK_USEC);
+		usec = usec_between (&tick_time, &cur_time);
+		tick_late_sum += usec;
+		tick_late_sq += usec * usec;
+		if (tick_late_max < usec) {
+		    tick_late_max = usec;
+		}
+		add_usec (&tick_time, TICK_USEC);
+	    }
+	    tick_count++;
 
-	/*
-	 * Handle asynchronous events.  These events use real time rather
-	 * than tick counts for timing, although the real time is rounded
-	 * off to the nearest tick by definition.
-	 */
-	/* get the time from the beginning of the game */
-	what_time_is_it = tick_time.tv_sec - start_time.tv_sec;
-	if(what_time_is_it != initial_time){
-		display_time_on_tux(what_time_is_it);	/* display the time on the TUX */
-		initial_time = what_time_is_it;	/* update the initial time */
+	    /* Simulate each tick due once, skipping any beyond MAX_CATCHUP. */
+	    if (MAX_CATCHUP < expired) {
+		ticks_missed += expired - MAX_CATCHUP;
+		sim_tick += expired - MAX_CATCHUP;
+		expired = MAX_CATCHUP;
+	    }
+	    ticks_caught_up += expired - 1;
+	    PROF_BEGIN (ticks_start);
+	    TRACE_BEGIN (ticks_trace);
+	    while (0 < expired--) {
+		simulate_tick (++sim_tick);
+	    }
+	    TRACE_END ("ticks", NULL, ticks_trace);
+	    PROF_END (PROF_TICKS, ticks_start);
 	}
+
 	/* 
 	 * Handle synchronous events--in this case, only player commands. 
 	 * Note that typed commands that move objects may cause the room
 	 * to be redrawn.
 	 */
 	
-	/* handle the sync case */
-
-	/* Sync in TUX part Begin */
-	//button
-	get_button_status(&bt);	/* ioctl(fd,TUX_BUTTONS,&buttons) */
-	pthread_mutex_lock(&tux_lock);
-	if((bt & 0xFF) != 0xFF){ /* bt has button pressed */
-		pthread_cond_signal(&tux_cv);
-	}else{
-		setinputcmd();	/* update the button in input.c */
-	}
-	pthread_mutex_unlock(&tux_lock); /* add a lock */
-
-	/* Sync in TUX part END */
-
-	/* the following code is the same logic as the command */
-	cmd = get_command ();
-	switch (cmd) {
-	    case CMD_UP:    move_photo_down ();  break;
-	    case CMD_RIGHT: move_photo_left ();  break;
-	    case CMD_DOWN:  move_photo_up ();    break;
-	    case CMD_LEFT:  move_photo_right (); break;
-	    case CMD_MOVE_LEFT:   
-		enter_room = (TC_CHANGE_ROOM == 
-			      try_to_move_left (&game_info.where));
-		break;
-	    case CMD_ENTER:
-		enter_room = (TC_CHANGE_ROOM ==
-			      try_to_enter (&game_info.where));
-		break;
-	    case CMD_MOVE_RIGHT:
-		enter_room = (TC_CHANGE_ROOM == 
-			      try_to_move_right (&game_info.where));
-		break;
-	    case CMD_TYPED:
-		if (handle_typing ()) {
-		    enter_room = 1;
+	/* 
+	 * Queue any command typed at the keyboard behind those from the
+	 * Tux controller thread, then handle all queued commands in order.
+	 * The queue's wakeup is cleared first, so that a command queued 
+	 * while we take the others wakes the loop again.
+	 * A command that changes rooms enters the new room before the next
+	 * command is handled.  Each command and change to the typed 
+	 * command is recorded, if recording, with the last tick simulated;
+	 * when replaying, get_command returns each command recorded up to
+	 * that tick in turn, and each is handled before the next is read,
+	 * as reading a record replaces the typed command.
+	 */
+	do {
+	    PROF_BEGIN (input_start);
+	    replay_tick (sim_tick);
+	    while (CMD_NONE != (cmd = get_command ())) {
+		(void)cmdq_push (cmd);
+		if (replay_playing ()) {
+		    break;
+		}
+	    }
+	    replay_record (CMD_NONE, get_typed_command ());
+	    PROF_END (PROF_INPUT, input_start);
+	    PROF_BEGIN (commands_start);
+	    (void)read (cmdq_fd (), &count, sizeof (count)); /* clear wakeup */
+	    while (cmdq_pop (&cev)) {
+		TRACE_BEGIN (cmd_trace);
+		replay_record (cev.cmd, get_typed_command ());
+		switch (cev.cmd) {
+		    case CMD_UP:    move_photo_down ();  break;
+		    case CMD_RIGHT: move_photo_left ();  break;
+		    case CMD_DOWN:  move_photo_up ();    break;
+		    case CMD_LEFT:  move_photo_right (); break;
+		    case CMD_MOVE_LEFT:   
+			enter_room = (TC_CHANGE_ROOM == 
+				      try_to_move_left (&game_info.where));
+			break;
+		    case CMD_ENTER:
+			enter_room = (TC_CHANGE_ROOM ==
+				      try_to_enter (&game_info.where));
+			break;
+		    case CMD_MOVE_RIGHT:
+			enter_room = (TC_CHANGE_ROOM == 
+				      try_to_move_right (&game_info.where));
+			break;
+		    case CMD_TYPED:
+			if (handle_typing ()) {
+			    enter_room = 1;
+			}
+			break;
+		    case CMD_QUIT: return GAME_QUIT;
+		    default: break;
 		}
-		break;
-	    case CMD_QUIT: return GAME_QUIT;
-	    default: break;
-	}
 
-	/* If player wins the game, their room becomes NULL. */
-	if (NULL == game_info.where) {
-	    return GAME_WON;
-	}
+		/* If player wins the game, their room becomes NULL. */
+		if (NULL == game_info.where) {
+		    return GAME_WON;
+		}
+		if (enter_room) {
+		    enter_new_room ();
+		    enter_room = 0;
+		}
+		TRACE_END ("command", cmd_name[cev.cmd], cmd_trace);
+	    }
+	    PROF_END (PROF_COMMANDS, commands_start);
+	} while (CMD_NONE != cmd);
     } /* end of the main event loop */
 }
 
@@ -550,6 +756,22 @@ handle_typing ()
 	    case TC_INVENTORY:
 	        result = typed_cmd_inventory (&game_info.where, arg);
 		break;
+	    case TC_MAP:
+		/* 
+		 * Toggle the whole-room overview, which is drawn from (0,0);
+		 * leaving it returns the view window to where it was.
+		 */
+		game_info.overview = !game_info.overview;
+		if (game_info.overview) {
+		    game_info.back_x = game_info.map_x;
+		    game_info.back_y = game_info.map_y;
+		    game_info.map_x = game_info.map_y = 0;
+		} else {
+		    game_info.map_x = game_info.back_x;
+		    game_info.map_y = game_info.back_y;
+		}
+	        result = TC_REDRAW_ROOM;
+		break;
 	    case TC_SIGH:
 	        result = typed_cmd_sigh (&game_info.where, arg);
 		break;
@@ -612,13 +834,17 @@ init_game ()
  *   INPUTS: none
  *   OUTPUTS: none
  *   RETURN VALUE: none
- *   SIDE EFFECTS: shifts view window
+ *   SIDE EFFECTS: shifts view
  */
 static void
 move_photo_down ()
 {
     int32_t delta; /* Number of pixels by which to move. */
-    int32_t idx;   /* Index over rows to redraw.         */
+
+    /* The overview shows the whole room; there is nothing to scroll. */
+    if (game_info.overview) {
+        return;
+    }
 
     /* Calculate the number of pixels by which to move. */
     delta = (game_info.y_speed > game_info.map_y ?
@@ -626,12 +852,6 @@ move_photo_down ()
 
     /* Shift the logical view upward. */
     game_info.map_y -= delta;
-    set_view_window (game_info.map_x, game_info.map_y);
-
-    /* Draw the newly exposed lines. */
-    for (idx = 0; delta > idx; idx++) {
-	(void)draw_horiz_line (idx);
-    }
 }
 
 
@@ -643,13 +863,17 @@ move_photo_down ()
  *   INPUTS: none
  *   OUTPUTS: none
  *   RETURN VALUE: none
- *   SIDE EFFECTS: shifts view window
+ *   SIDE EFFECTS: shifts view
  */
 static void
 move_photo_left ()
 {
     int32_t delta; /* Number of pixels by which to move. */
-    int32_t idx;   /* Index over columns to redraw.      */
+
+    /* The overview shows the whole room; there is nothing to scroll. */
+    if (game_info.overview) {
+        return;
+    }
 
     /* Calculate the number of pixels by which to move. */
     delta = room_photo_width (game_info.where) - SCROLL_X_DIM -
@@ -658,12 +882,6 @@ move_photo_left ()
 
     /* Shift the logical view to the right. */
     game_info.map_x += delta;
-    set_view_window (game_info.map_x, game_info.map_y);
-
-    /* Draw the newly exposed lines. */
-    for (idx = 1; delta >= idx; idx++) {
-	(void)draw_vert_line (SCROLL_X_DIM - idx);
-    }
 }
 
 
@@ -675,13 +893,17 @@ move_photo_left ()
  *   INPUTS: none
  *   OUTPUTS: none
  *   RETURN VALUE: none
- *   SIDE EFFECTS: shifts view window
+ *   SIDE EFFECTS: shifts view
  */
 static void
 move_photo_right ()
 {
     int32_t delta; /* Number of pixels by which to move. */
-    int32_t idx;   /* Index over columns to redraw.      */
+
+    /* The overview shows the whole room; there is nothing to scroll. */
+    if (game_info.overview) {
+        return;
+    }
 
     /* Calculate the number of pixels by which to move. */
     delta = (game_info.x_speed > game_info.map_x ?
@@ -689,12 +911,6 @@ move_photo_right ()
 
     /* Shift the logical view to the left. */
     game_info.map_x -= delta;
-    set_view_window (game_info.map_x, game_info.map_y);
-
-    /* Draw the newly exposed lines. */
-    for (idx = 0; delta > idx; idx++) {
-	(void)draw_vert_line (idx);
-    }
 }
 
 
@@ -706,13 +922,17 @@ move_photo_right ()
  *   INPUTS: none
  *   OUTPUTS: none
  *   RETURN VALUE: none
- *   SIDE EFFECTS: shifts view window
+ *   SIDE EFFECTS: shifts view
  */
 static void
 move_photo_up ()
 {
     int32_t delta; /* Number of pixels by which to move. */
-    int32_t idx;   /* Index over rows to redraw.         */
+
+    /* The overview shows the whole room; there is nothing to scroll. */
+    if (game_info.overview) {
+        return;
+    }
 
     /* Calculate the number of pixels by which to move. */
     delta = room_photo_height (game_info.where) - SCROLL_Y_DIM - 
@@ -721,96 +941,119 @@ move_photo_up ()
 
     /* Shift the logical view upward. */
     game_info.map_y += delta;
-    set_view_window (game_info.map_x, game_info.map_y);
+}
 
-    /* Draw the newly exposed lines. */
-    for (idx = 1; delta >= idx; idx++) {
-	(void)draw_horiz_line (SCROLL_Y_DIM - idx);
-    }
+
+/* 
+ * enter_new_room
+ *   DESCRIPTION: Show the player's current room from the upper left 
+ *                corner.  The render thread prepares the VGA palette and
+ *                photo-drawing routines for the room, and draws it.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: resets the view; discards any partially-typed command
+ */
+static void
+enter_new_room ()
+{
+    /* Reset the view to (0,0), without the overview. */
+    game_info.map_x = game_info.map_y = 0;
+    game_info.overview = 0;
+
+    /* Discard any partially-typed command. */
+    reset_typed_command ();
+
+    /* Draw the new room. */
+    TRACE_MARK ("enter room", room_name (game_info.where));
+    room_enter (game_info.where);
+    room_gen++;
+    (void)clock_gettime (CLOCK_MONOTONIC, &room_entered);
+    redraw_room ();
 }
 
 
 /* 
  * redraw_room
- *   DESCRIPTION: Draw all lines on the screen.
+ *   DESCRIPTION: Have the render thread draw all lines on the screen.
  *   INPUTS: none
  *   OUTPUTS: none
  *   RETURN VALUE: none
- *   SIDE EFFECTS: Draws the entire screen (but not the status bar).
+ *   SIDE EFFECTS: changes the view
  */
 static void
 redraw_room ()
 {
-    int32_t i; /* index over rows */
+    obj_gen++;
+}
 
-    /* Draw all lines in the scroll region. */
-    for (i = 0; i < SCROLL_Y_DIM; i++) {
-	(void)draw_horiz_line (i);
+
+/* 
+ * expire_status
+ *   DESCRIPTION: Timer function that expires a status message, unless a
+ *                newer message has been posted since the timer was set.
+ *   INPUTS: id -- number of the message to expire
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Expires status messages.
+ */
+static void
+expire_status (void* id)
+{
+    if ((uint32_t)(uintptr_t)id == 
+	__atomic_load_n (&msg_pub, __ATOMIC_ACQUIRE)) {
+	__atomic_store_n (&msg_expired, (uint32_t)(uintptr_t)id, 
+			  __ATOMIC_RELEASE);
     }
 }
 
-
 /* 
- * status_thread
- *   DESCRIPTION: Function executed by status message helper thread.
- *                Waits for a message to be displayed, then shows the
- *                message for 1.5 seconds before deleting it.  If a
- *                new message has appeared in the meantime, restarts the
- *                clock and tries again.
+ * tux_thread
+ *   DESCRIPTION: Function executed by tux helper thread.  Reads the Tux
+ *                controller's buttons once per tick and queues the
+ *                commands they give for the game loop.  Returns at once
+ *                if no controller is open.
  *   INPUTS: none (ignored)
  *   OUTPUTS: none
  *   RETURN VALUE: NULL
- *   SIDE EFFECTS: Changes the status message to an empty string.
+ *   SIDE EFFECTS: queues commands
  */
-static void*
-status_thread (void* ignore)
+static void* 
+tux_thread (void* ignore)
 {
-    struct timespec ts; /* absolute wake-up time */
-
+    struct timespec next;	/* time of next button read */
+    unsigned long buttons;	/* button state (active low) */
+    int key_fd, tux_fd;		/* input devices             */
+    cmd_t pushed;		/* command from the buttons  */
+
+    /* A replay takes the place of the buttons. */
+    get_input_fds (&key_fd, &tux_fd);
+    if (0 > tux_fd || replay_playing ()) {
+        return NULL;
+    }
+    trace_thread ("tux");
+    (void)clock_gettime (CLOCK_MONOTONIC, &next);
     while (1) {
-
-	/* 
-	 * Wait for a message to appear.  Note that we must check the
-	 * condition after acquiring the lock, and that pthread_cond_wait
-	 * yields the lock, then reacquires the lock before returning.
-	 */
-	(void)pthread_mutex_lock (&msg_lock);
-	while ('\0' == status_msg[0]) {
-	    pthread_cond_wait (&msg_cv, &msg_lock);
+	add_usec (&next, TICK_USEC);
+	while (EINTR == clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME,
+					 &next, NULL)) {
 	}
 
-	/* 
-	 * A message is present: if we stop before the timeout
-	 * passes, assume that a new one has been posted; if the
-	 * timeout passes, clear the message and wait for a new one.
-	 */
-	do {
-	    /* Get the current time. */
-	    clock_gettime (CLOCK_REALTIME, &ts);
-	    
-	    /* Add 1.5 seconds to it. */
-	    if (500000000 <= ts.tv_nsec) {
-		ts.tv_sec += 2;
-		ts.tv_nsec -= 500000000;
-	    } else {
-		ts.tv_sec += 1;
-		ts.tv_nsec += 500000000;
+	buttons = 0xFF;
+	PROF_BEGIN (buttons_start);
+	TRACE_BEGIN (buttons_trace);
+	get_button_status (&buttons);	/* ioctl(fd,TUX_BUTTONS,&buttons) */
+	TRACE_END ("buttons", NULL, buttons_trace);
+	PROF_END (PROF_BUTTONS, buttons_start);
+	if (0xFF != (buttons & 0xFF)) {	/* a button is pressed */
+	    pushed = GTC ();	/* get the tux command (because it belongs to TUX) */
+	    if (CMD_NONE != pushed) {
+		(void)cmdq_push (pushed);
+		TRACE_MARK ("tux command", cmd_name[pushed]);
 	    }
-
-	    /* 
-	     * And go to sleep.  If we wake up due to anything but a
-	     * timeout, we assume (possibly incorrectly) that a new
-	     * message has appeared and try to wait 1.5 seconds again.
-	     */
-	} while (ETIMEDOUT != 
-		 pthread_cond_timedwait (&msg_cv, &msg_lock, &ts));
-
-	/* 
-	 * Clear the message, then release the lock (remember that 
-	 * pthread_cond_timedwait reacquires the lock before returning).
-	 */
-	status_msg[0] = '\0';
-	(void)pthread_mutex_unlock (&msg_lock);
+	} else {
+	    setinputcmd ();	/* update the button in input.c */
+	}
     }
 
     /* This code never executes--the thread should always be cancelled. */
@@ -818,74 +1061,308 @@ status_thread (void* ignore)
 }
 
 /* 
- * tux_thread
- *   DESCRIPTION: Function executed by tux helper thread.
- *                Waits for a tux command to come in. If somewhere
- *				  tick in a tux command, and the thread is not being blocked
- * 				  I should execute it.
- *   INPUTS: none (ignored)
- *   OUTPUTS: none pointer
- *   RETURN VALUE: NULL*
- *   SIDE EFFECTS: Execute the command that TUX ticks in.
+ * add_usec
+ *   DESCRIPTION: Advance a time by a number of microseconds.
+ *   INPUTS: t -- the time
+ *           usec -- microseconds to add (not negative)
+ *   OUTPUTS: t -- the later time
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
  */
-void* 
-tux_thread(void * arg){
-	while(1){
-		pthread_mutex_lock(&tux_lock);
-		if((bt & 0xFF) == 0xFF){	/* If no button pressed, waiting! */
-			pthread_cond_wait(&tux_cv,&tux_lock);
-		}
-		cmd_t pushed = GTC();	/* get the tux command  (because it beliongs to TUX) */
-
-		switch (pushed) {
-	    	case CMD_UP:    move_photo_down ();  break;
-	    	case CMD_RIGHT: move_photo_left ();  break;
-	    	case CMD_DOWN:  move_photo_up ();    break;
-	    	case CMD_LEFT:  move_photo_right (); break;
-	    	case CMD_MOVE_LEFT:   
-			enter_room = (TC_CHANGE_ROOM == 
-				      try_to_move_left (&game_info.where));
-			break;
-	    	case CMD_ENTER:
-			enter_room = (TC_CHANGE_ROOM ==
-				      try_to_enter (&game_info.where));
-			break;
-	    	case CMD_MOVE_RIGHT:
-			enter_room = (TC_CHANGE_ROOM == 
-				      try_to_move_right (&game_info.where));
-	    	default: break;
-		}
-		bt = 0xFF;	/* reset the button to unpressed */
-		pthread_mutex_unlock(&tux_lock);	/* unlock it */
-	}
-	return NULL;
+static void
+add_usec (struct timespec* t, long usec)
+{
+    t->tv_sec += usec / 1000000;
+    if (1000000000 <= (t->tv_nsec += (usec % 1000000) * 1000)) {
+        t->tv_sec++;
+	t->tv_nsec -= 1000000000;
+    }
 }
 
+
 /* 
- * time_is_after 
- *   DESCRIPTION: Check whether one time is at or after a second time.
+ * usec_between
+ *   DESCRIPTION: Find the time from one time to a second time.
  *   INPUTS: t1 -- the first time
  *           t2 -- the second time
  *   OUTPUTS: none
- *   RETURN VALUE: 1 if t1 >= t2
- *                 0 if t1 < t2
+ *   RETURN VALUE: microseconds from t1 to t2 (negative if t2 is earlier)
  *   SIDE EFFECTS: none
  */
+static long
+usec_between (struct timespec* t1, struct timespec* t2)
+{
+    return (t2->tv_sec - t1->tv_sec) * 1000000L + 
+	   (t2->tv_nsec - t1->tv_nsec) / 1000;
+}
+
+
+/* 
+ * watch_loop_events
+ *   DESCRIPTION: Start a timer that expires at each tick, beginning at
+ *                the first tick, and an epoll set over the timer, the
+ *                command queue, and the keyboard, on which the game loop
+ *                can sleep.  A keyboard that epoll cannot watch (such as
+ *                a regular file on stdin) is still read at each tick.
+ *   INPUTS: first_tick -- time of the first tick (CLOCK_MONOTONIC)
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, or -1 on failure
+ *   SIDE EFFECTS: sets tick_fd and loop_fd
+ */
 static int
-time_is_after (struct timeval* t1, struct timeval* t2)
+watch_loop_events (struct timespec* first_tick)
 {
-    if (t1->tv_sec == t2->tv_sec)
-        return (t1->tv_usec >= t2->tv_usec);
-    if (t1->tv_sec > t2->tv_sec)
-        return 1;
+    struct itimerspec its;	/* timer period and first expiry */
+    struct epoll_event ev;	/* event to watch                */
+    int key_fd, tux_fd;		/* input devices                 */
+
+    tick_fd = timerfd_create (CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    loop_fd = epoll_create1 (EPOLL_CLOEXEC);
+    if (0 > tick_fd || 0 > loop_fd) {
+        return -1;
+    }
+    its.it_value = *first_tick;
+    its.it_interval.tv_sec = TICK_USEC / 1000000;
+    its.it_interval.tv_nsec = (TICK_USEC % 1000000) * 1000;
+    if (0 != timerfd_settime (tick_fd, TFD_TIMER_ABSTIME, &its, NULL)) {
+        return -1;
+    }
+    ev.events = EPOLLIN;
+    ev.data.fd = tick_fd;
+    if (0 != epoll_ctl (loop_fd, EPOLL_CTL_ADD, tick_fd, &ev)) {
+        return -1;
+    }
+
+    /* Commands queued by the Tux controller thread wake the loop. */
+    ev.data.fd = cmdq_fd ();
+    if (0 != epoll_ctl (loop_fd, EPOLL_CTL_ADD, ev.data.fd, &ev)) {
+        return -1;
+    }
+
+    /* 
+     * The Tux driver cannot be polled, so its descriptor is not watched;
+     * the Tux thread reads the buttons at each tick instead.
+     */
+    get_input_fds (&key_fd, &tux_fd);
+    ev.data.fd = key_fd;
+    (void)epoll_ctl (loop_fd, EPOLL_CTL_ADD, key_fd, &ev);
     return 0;
 }
 
 
+/* 
+ * simulate_tick
+ *   DESCRIPTION: Advance the game by one fixed tick: fire timed events
+ *                due, show the elapsed time on the Tux controller, and
+ *                count the tick.
+ *   INPUTS: tick -- number of the tick (from one at start of game)
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: may expire status messages and set the Tux LEDs
+ */
+static void
+simulate_tick (uint32_t tick)
+{
+    unsigned int what_time_is_it;  /* seconds since start of game */
+    uint32_t drawn, dropped;       /* frames drawn and dropped    */
+    struct timespec now;           /* time a second was closed    */
+
+    /* 
+     * Time the counted seconds from when the first tick is simulated, 
+     * which a fast replay does at once rather than a tick after start.
+     */
+    if (0 == seconds && 0 == tick_rate.cur) {
+	(void)clock_gettime (CLOCK_MONOTONIC, &count_start);
+    }
+
+    /* Fire timed events due by this tick. */
+    wheel_advance (tick);
+
+    /* get the time from the beginning of the game */
+    what_time_is_it = tick / TICKS_PER_SEC;
+    if(what_time_is_it != initial_time){
+	display_time_on_tux(what_time_is_it);	/* display the time on the TUX */
+	initial_time = what_time_is_it;	/* update the initial time */
+    }
+
+    /* Close the counts for each second as it ends. */
+    while (seconds < (tick - 1) / TICKS_PER_SEC) {
+	render_counts (&drawn, &dropped);
+	frame_rate.cur = drawn - frames_counted;
+	drop_rate.cur = dropped - drops_counted;
+	frames_counted = drawn;
+	drops_counted = dropped;
+	count_second (&tick_rate);
+	count_second (&frame_rate);
+	count_second (&drop_rate);
+	seconds++;
+	(void)clock_gettime (CLOCK_MONOTONIC, &now);
+	counted_secs = usec_between (&count_start, &now) / 1e6;
+    }
+    tick_rate.cur++;
+}
+
+
+/* 
+ * count_second
+ *   DESCRIPTION: Close the count of events for a second, and start a 
+ *                new one.
+ *   INPUTS: r -- the count
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void
+count_second (rate_t* r)
+{
+    if (0 == seconds || r->min > r->cur) {
+        r->min = r->cur;
+    }
+    if (r->max < r->cur) {
+        r->max = r->cur;
+    }
+    r->total += r->cur;
+    r->cur = 0;
+}
+
+
+/* 
+ * tick_report
+ *   DESCRIPTION: Print the mean, standard deviation, and maximum of the 
+ *                time spent in each tick or other wakeup and of how late
+ *                ticks woke up, and the numbers of ticks caught up and
+ *                missed, if any ticks ran.
+ *   INPUTS: f -- output stream
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void
+tick_report (FILE* f)
+{
+    double work_avg, late_avg; /* mean times            */
+    uint32_t wakes;            /* ticks and input wakes */
+
+    if (0 == tick_count) {
+        return;
+    }
+    wakes = tick_count + input_wakes;
+    work_avg = tick_work_sum / wakes;
+    late_avg = tick_late_sum / tick_count;
+    fprintf (f, "ticks: %u (and %u wakeups for input), work %.0f us "
+	     "(sd %.0f, max %.0f), woke %.0f us late (sd %.0f, max %.0f), "
+	     "%u caught up, %u missed\n", tick_count, input_wakes,
+	     work_avg, sqrt (fmax (0, tick_work_sq / wakes - 
+				   work_avg * work_avg)), tick_work_max,
+	     late_avg, sqrt (fmax (0, tick_late_sq / tick_count - 
+				   late_avg * late_avg)), tick_late_max,
+	     ticks_caught_up, ticks_missed);
+    fprintf (f, "status message reads: %.2f us (max %.1f), %u retries\n",
+	     msg_read_sum / wakes, msg_read_max, msg_retries);
+}
+
+
+/* 
+ * frame_report
+ *   DESCRIPTION: Print the simulated ticks, drawn frames, and dropped 
+ *                frames per second of elapsed time, and the fewest and 
+ *                most in a simulated second, if any seconds were counted.
+ *   INPUTS: f -- output stream
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void
+frame_report (FILE* f)
+{
+    if (0 == seconds || 0 >= counted_secs) {
+        return;
+    }
+    fprintf (f, "frames: per second %.1f ticks, %.1f drawn, %.1f dropped "
+	     "(over %.2f s)\n", tick_rate.total / counted_secs, 
+	     frame_rate.total / counted_secs, drop_rate.total / counted_secs,
+	     counted_secs);
+    fprintf (f, "frames: per simulated second %u to %u ticks, %u to %u "
+	     "drawn, at most %u dropped (over %u s)\n", tick_rate.min, 
+	     tick_rate.max, frame_rate.min, frame_rate.max, drop_rate.max,
+	     seconds);
+}
+
+
+/* 
+ * cpu_report
+ *   DESCRIPTION: Print the processor time used by all threads, and the
+ *                time elapsed, since the game started.
+ *   INPUTS: f -- output stream
+ *           start -- time at which the game started
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void
+cpu_report (FILE* f, const struct timespec* start)
+{
+    struct rusage use;		/* resources used     */
+    struct timespec now;	/* current time       */
+
+    if (0 != getrusage (RUSAGE_SELF, &use)) {
+        return;
+    }
+    (void)clock_gettime (CLOCK_MONOTONIC, &now);
+    fprintf (f, "cpu: %.3f s user, %.3f s system, %.3f s elapsed\n",
+	     use.ru_utime.tv_sec + use.ru_utime.tv_usec / 1e6,
+	     use.ru_stime.tv_sec + use.ru_stime.tv_usec / 1e6,
+	     (now.tv_sec - start->tv_sec) + 
+	     (now.tv_nsec - start->tv_nsec) / 1e9);
+}
+
+
+/* 
+ * write_port_log
+ *   DESCRIPTION: Write the log of VGA port writes (kept in record and
+ *                mock modes) to the file named by ADVENTURE_PORT_LOG,
+ *                one write per line, as "outb PORT VAL" or "outw PORT
+ *                VAL" in hexadecimal, so that the register traffic of
+ *                a replayed route can be diffed against a known log.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: writes the log file
+ */
+static void
+write_port_log ()
+{
+    const char* name;		/* log file name            */
+    const port_rec_t* rec;	/* logged writes            */
+    int32_t n;			/* number of logged writes  */
+    int32_t i;			/* index over logged writes */
+    FILE* f;			/* log file                 */
+
+    if (NULL == (name = getenv ("ADVENTURE_PORT_LOG"))) {
+        return;
+    }
+    if (NULL == (f = fopen (name, "w"))) {
+	perror (name);
+        return;
+    }
+    rec = port_log (&n);
+    for (i = 0; n > i; i++) {
+	if (1 == rec[i].width) {
+	    fprintf (f, "outb %04X %02X\n", rec[i].port, rec[i].val);
+	} else {
+	    fprintf (f, "outw %04X %04X\n", rec[i].port, rec[i].val);
+	}
+    }
+    if (0 != fclose (f)) {
+	perror (name);
+    }
+}
+
+
 /* 
  * show_status (interface function; declared in world.h)
  *   DESCRIPTION: Show a specific status message of up to STATUS_MSG_LEN
- *                characters.
+ *                characters.  Never waits for the game loop.
  *   INPUTS: s -- the string used for the status message
  *   OUTPUTS: none
  *   RETURN VALUE: none
@@ -894,21 +1371,82 @@ time_is_after (struct timeval* t1, struct timeval* t2)
 void
 show_status (const char* s)
 {
-    /* msg_lock critical section starts here. */
-    (void)pthread_mutex_lock (&msg_lock);
+    msg_slot_t* slot;	/* slot for the message       */
+    uint32_t id;	/* number of the message      */
+    uint32_t seq;	/* slot sequence when claimed */
+    uint32_t cur;	/* newest message published   */
+
+    /* Number the message, and claim its slot by making seq odd. */
+    id = __atomic_add_fetch (&msg_next, 1, __ATOMIC_RELAXED);
+    slot = &msg_slot[id % MSG_SLOTS];
+    do {
+        seq = __atomic_load_n (&slot->seq, __ATOMIC_RELAXED) & ~1;
+    } while (!__atomic_compare_exchange_n (&slot->seq, &seq, seq + 1, 0,
+					   __ATOMIC_ACQUIRE, 
+					   __ATOMIC_RELAXED));
+    __atomic_thread_fence (__ATOMIC_RELEASE);
+
+    /* Fill the slot, then make seq even again. */
+    slot->id = id;
+    (void)clock_gettime (CLOCK_MONOTONIC, &slot->posted);
+    strncpy (slot->text, s, STATUS_MSG_LEN);
+    slot->text[STATUS_MSG_LEN] = '\0';
+    __atomic_store_n (&slot->seq, seq + 2, __ATOMIC_RELEASE);
+
+    /* Publish the message unless a newer one already is. */
+    cur = __atomic_load_n (&msg_pub, __ATOMIC_RELAXED);
+    while (cur < id && 
+	   !__atomic_compare_exchange_n (&msg_pub, &cur, id, 0, 
+					 __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+    }
 
-    /* Copy the new message under the protection of msg_lock. */
-    strncpy (status_msg, s, STATUS_MSG_LEN);
-    status_msg[STATUS_MSG_LEN] = '\0';
+}
 
-    /* 
-     * Wake up the status message helper thread.  Note that we still hold
-     * the msg_lock, so the thread can't wake up until we release it.
-     */
-    (void)pthread_cond_signal (&msg_cv);
 
-    /* msg_lock critical section ends here. */
-    (void)pthread_mutex_unlock (&msg_lock);
+/* 
+ * read_status_msg
+ *   DESCRIPTION: Get a consistent copy of the current status message 
+ *                without a lock, yielding between tries once a few have
+ *                failed.
+ *   INPUTS: none
+ *   OUTPUTS: text -- the message, or an empty string if there is none
+ *            posted -- time the message was posted (if not NULL)
+ *   RETURN VALUE: the message number, or 0 if there is no message
+ *   SIDE EFFECTS: none
+ */
+static uint32_t
+read_status_msg (char* text, struct timespec* posted)
+{
+    const msg_slot_t* slot;  /* slot holding the message   */
+    uint32_t id;	     /* number of newest message   */
+    uint32_t seq;	     /* slot sequence before copy  */
+    uint32_t tries;	     /* reads tried so far         */
+
+    for (tries = 1; 1; tries++) {
+	id = __atomic_load_n (&msg_pub, __ATOMIC_ACQUIRE);
+	if (0 == id || id == __atomic_load_n (&msg_expired, __ATOMIC_ACQUIRE)) {
+	    text[0] = '\0';
+	    return 0;
+	}
+	slot = &msg_slot[id % MSG_SLOTS];
+	seq = __atomic_load_n (&slot->seq, __ATOMIC_ACQUIRE);
+	if (0 == (seq & 1) && id == slot->id) {
+	    (void)memcpy (text, slot->text, sizeof (slot->text));
+	    if (NULL != posted) {
+	        *posted = slot->posted;
+	    }
+	    __atomic_thread_fence (__ATOMIC_ACQUIRE);
+	    if (seq == __atomic_load_n (&slot->seq, __ATOMIC_RELAXED)) {
+		return id;
+	    }
+	}
+	(void)__atomic_add_fetch (&msg_retries, 1, __ATOMIC_RELAXED);
+
+	/* A writer may have been preempted mid-copy; let it finish. */
+	if (MSG_SPIN_READS <= tries) {
+	    (void)sched_yield ();
+	}
+    }
 }
 
 
@@ -922,15 +1460,35 @@ show_status (const char* s)
 int
 main ()
 {
-    game_condition_t game;  /* outcome of playing */
+    game_condition_t game;  /* outcome of playing   */
+    uint32_t seed;          /* seed for rand        */
+    struct timespec start;  /* time game started    */
 
-    /* Randomize for more fun (remove for deterministic layout). */
-    srand (time (NULL));
+    (void)clock_gettime (CLOCK_MONOTONIC, &start);
+
+    /* 
+     * Randomize for more fun (remove for deterministic layout).  The seed
+     * is recorded with the player's input, if recording; a replay uses
+     * the seed recorded.
+     */
+    seed = time (NULL);
+    if (0 != replay_init (&seed)) {
+        return 3;
+    }
+    srand (seed);
 
     /* Provide some protection against fatal errors. */
     clean_on_signals ();
 
+    /* Print the phase profile (if built in) on SIGUSR1. */
+    prof_init ();
+
+    /* Trace what each thread does if ADVENTURE_TRACE is set. */
+    trace_init ("game loop");
+
+    TRACE_BEGIN (build_start);
     if (!build_world ()) {PANIC ("can't build world");}
+    TRACE_END ("build_world", NULL, build_start);
     init_game ();
 
     /* Perform sanity checks. */
@@ -938,23 +1496,22 @@ main ()
 	PANIC ("failed sanity checks");
     }
 
-	/* Create status message thread. */
-    if (0 != pthread_create (&tux_thread_id, NULL, tux_thread, NULL)) {
-        PANIC ("failed to create tux thread");
+    /* Create the queue for player commands. */
+    if (0 != cmdq_init ()) {
+	PANIC ("failed to create command queue");
     }
-    push_cleanup (cancel_tux_thread, NULL); {
 
-    /* Create status message thread. */
-    if (0 != pthread_create (&status_thread_id, NULL, status_thread, NULL)) {
-        PANIC ("failed to create status thread");
+    /* Start mode X. */
+    if (0 != set_mode_X (fill_horiz_buffer, fill_vert_buffer)) {
+	PANIC ("cannot initialize mode X");
     }
-    push_cleanup (cancel_status_thread, NULL); {
+    push_cleanup ((cleanup_fn_t)clear_mode_X, NULL); {
 
-	/* Start mode X. */
-	if (0 != set_mode_X (fill_horiz_buffer, fill_vert_buffer)) {
-	    PANIC ("cannot initialize mode X");
+	/* Draw from now on only in the render thread. */
+	if (0 != render_start ()) {
+	    PANIC ("failed to create render thread");
 	}
-	push_cleanup ((cleanup_fn_t)clear_mode_X, NULL); {
+	push_cleanup ((cleanup_fn_t)render_stop, NULL); {
 
 	    /* Initialize the keyboard and/or Tux controller. */
 	    if (0 != init_input ()) {
@@ -962,7 +1519,16 @@ main ()
 	    }
 	    push_cleanup ((cleanup_fn_t)shutdown_input, NULL); {
 
-		game = game_loop ();
+		/* Create the Tux controller thread. */
+		if (0 != pthread_create (&tux_thread_id, NULL, tux_thread, 
+					 NULL)) {
+		    PANIC ("failed to create tux thread");
+		}
+		push_cleanup (cancel_tux_thread, NULL); {
+
+		    game = game_loop ();
+
+		} pop_cleanup (1);
 
 	    } pop_cleanup (1);
 
@@ -970,7 +1536,8 @@ main ()
 
     } pop_cleanup (1);
 
-	} pop_cleanup (1);
+    /* Finish the recording, if any. */
+    replay_close ();
 
     /* Print a message about the outcome. */
     switch (game) {
@@ -978,6 +1545,36 @@ main ()
 	case GAME_QUIT: printf ("Quitter!\n"); break;
     }
 
+    /* 
+     * Report tick timing, input recorded or replayed, rooms entered,
+     * frame rates, render times, queued commands, timed events, how well
+     * tiled photos were streamed, pyramid memory use, VGA port, video 
+     * memory, and terminal traffic, frame capture, retrace waits, (if 
+     * built in) the time spent in each phase, and processor time used.
+     */
+    tick_report (stdout);
+    replay_report (stdout);
+    world_report (stdout);
+    frame_report (stdout);
+    render_report (stdout);
+    cmdq_report (stdout);
+    wheel_report (stdout);
+    tile_report (stdout);
+    photo_report (stdout);
+    port_report (stdout);
+    vram_report (stdout);
+    vterm_report (stdout);
+    capture_report (stdout);
+    retrace_report (stdout);
+    prof_report (stdout);
+    cpu_report (stdout, &start);
+
+    /* Write the trace, if any. */
+    trace_flush ();
+
+    /* Write the VGA port log, if asked to. */
+    write_port_log ();
+
     /* Return success. */
     return 0;
 }
@@ -0,0 +1,416 @@
+/*									tab:8
+ *
+ * capture.c - asynchronous frame capture
+ *
+ * "Copyright (c) 2026 by Tianzuo Qin."
+ *
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation for any purpose, without fee, and without written agreement is
+ * hereby granted, provided that the above copyright notice and the following
+ * two paragraphs appear in all copies of this software.
+ *
+ * IN NO EVENT SHALL THE AUTHOR OR THE UNIVERSITY OF ILLINOIS BE LIABLE TO
+ * ANY PARTY FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL
+ * DAMAGES ARISING OUT  OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+ * EVEN IF THE AUTHOR AND/OR THE UNIVERSITY OF ILLINOIS HAS BEEN ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THE AUTHOR AND THE UNIVERSITY OF ILLINOIS SPECIFICALLY DISCLAIM ANY
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE
+ * PROVIDED HEREUNDER IS ON AN "AS IS" BASIS, AND NEITHER THE AUTHOR NOR
+ * THE UNIVERSITY OF ILLINOIS HAS ANY OBLIGATION TO PROVIDE MAINTENANCE,
+ * SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS."
+ *
+ * Author:	    Tianzuo Qin
+ * Version:	    1
+ * Creation Date:   Sun Oct 18 20:31:05 2026
+ * Filename:	    capture.c
+ * History:
+ *	TQ	1	Sun Oct 18 20:31:05 2026
+ *		First written.
+ */
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "capture.h"
+
+
+/*
+ * Frames pass from show_screen to the writer through a ring of slots.
+ * show_screen fills the slot at cap_head and then advances cap_head; the
+ * writer empties the slot at cap_tail and then advances cap_tail.  Each
+ * index is written by one thread only, so the ring needs no lock.
+ */
+#define CAPTURE_SLOTS       8
+#define CAPTURE_PLANE_SIZE  (SCROLL_X_WIDTH * SCROLL_Y_DIM)
+
+typedef struct capture_slot_t capture_slot_t;
+struct capture_slot_t {
+    uint32_t      seq;				/* frame number      */
+    uint32_t      flags;			/* CAPTURE_PAL_...   */
+    unsigned char pal[256][3];			/* 6-bit palette     */
+    unsigned char img[4][CAPTURE_PLANE_SIZE];	/* display planes    */
+    unsigned char status[4 * VIDEO_STATUS_SIZE];/* status bar planes */
+};
+
+/* capture destination formats */
+typedef enum {
+    CAPTURE_OFF,
+    CAPTURE_PPM,
+    CAPTURE_RAW
+} capture_fmt_t;
+
+
+/* local functions--see function headers for details */
+static void* capture_thread (void* arg);
+static void deplanarize (const capture_slot_t* s, unsigned char* pix);
+static int write_ppm (const capture_slot_t* s, const unsigned char* pix);
+static int write_raw (const capture_slot_t* s, const unsigned char* pix);
+
+
+static capture_fmt_t  cap_fmt;		/* format, or off          */
+static const char*    cap_name;		/* PPM prefix or raw file  */
+static FILE*          cap_file;		/* raw file                */
+static capture_slot_t* cap_slot;	/* ring of CAPTURE_SLOTS   */
+static uint32_t       cap_head;		/* slots filled (game)     */
+static uint32_t       cap_tail;		/* slots written (writer)  */
+static pthread_t      cap_thread_id;
+static sem_t          cap_sem;		/* posted once per slot    */
+static volatile int   cap_stop;		/* tells writer to finish  */
+
+/* state kept by the game thread between frames */
+static unsigned char  cap_pal[256][3];	/* palette as loaded       */
+static int            cap_pal_changed;	/* 1 if not yet queued     */
+static unsigned char  cap_status[4 * VIDEO_STATUS_SIZE];
+static uint32_t       cap_seq;		/* frames offered          */
+static uint32_t       cap_dropped;	/* frames dropped          */
+static uint32_t       cap_written;	/* frames written (writer) */
+static uint32_t       cap_failed;	/* write errors (writer)   */
+
+
+/*
+ * capture_start
+ *   DESCRIPTION: Start the capture named by ADVENTURE_CAPTURE, if any,
+ *                including the writer thread.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success (or if no capture is requested), -1 on
+ *                 failure
+ *   SIDE EFFECTS: reads ADVENTURE_CAPTURE; may create a file; prints an
+ *                 error message to stderr on failure
+ */
+int
+capture_start ()
+{
+    const char* name;  /* value of ADVENTURE_CAPTURE */
+
+    cap_fmt = CAPTURE_OFF;
+    if (NULL == (name = getenv ("ADVENTURE_CAPTURE"))) {
+        return 0;
+    }
+    if (0 == strncmp (name, "ppm:", 4)) {
+        cap_fmt = CAPTURE_PPM;
+    } else if (0 == strncmp (name, "raw:", 4)) {
+        cap_fmt = CAPTURE_RAW;
+    } else {
+        fprintf (stderr, "unknown capture %s\n", name);
+	return -1;
+    }
+    cap_name = name + 4;
+
+    if (CAPTURE_RAW == cap_fmt && NULL == (cap_file = fopen (cap_name, "wb"))) {
+	perror (cap_name);
+	cap_fmt = CAPTURE_OFF;
+	return -1;
+    }
+    if (NULL == (cap_slot = malloc (CAPTURE_SLOTS * sizeof (*cap_slot)))) {
+        goto fail;
+    }
+    cap_head = cap_tail = 0;
+    cap_seq = cap_dropped = cap_written = cap_failed = 0;
+    cap_pal_changed = 1;
+    cap_stop = 0;
+    if (0 != sem_init (&cap_sem, 0, 0)) {
+        goto fail;
+    }
+    if (0 != pthread_create (&cap_thread_id, NULL, capture_thread, NULL)) {
+	(void)sem_destroy (&cap_sem);
+        goto fail;
+    }
+    return 0;
+
+fail:
+    fprintf (stderr, "cannot start capture\n");
+    free (cap_slot);
+    cap_slot = NULL;
+    if (NULL != cap_file) {
+	(void)fclose (cap_file);
+	cap_file = NULL;
+    }
+    cap_fmt = CAPTURE_OFF;
+    return -1;
+}
+
+
+/*
+ * capture_stop
+ *   DESCRIPTION: Let the writer thread write the frames still queued,
+ *                then end it and close the capture.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: waits for the writer thread
+ */
+void
+capture_stop ()
+{
+    if (CAPTURE_OFF == cap_fmt) {
+        return;
+    }
+    cap_stop = 1;
+    (void)sem_post (&cap_sem);
+    (void)pthread_join (cap_thread_id, NULL);
+    (void)sem_destroy (&cap_sem);
+    if (NULL != cap_file && 0 != fclose (cap_file)) {
+        cap_failed++;
+    }
+    cap_file = NULL;
+    free (cap_slot);
+    cap_slot = NULL;
+    cap_fmt = CAPTURE_OFF;
+}
+
+
+/*
+ * capture_palette
+ *   DESCRIPTION: Record colors loaded into the palette; the next frame
+ *                queued carries the new palette.
+ *   INPUTS: first -- first color loaded
+ *           rgb -- 6-bit RGB values, three bytes per color
+ *           count -- number of colors loaded
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void
+capture_palette (int first, const unsigned char* rgb, int count)
+{
+    if (CAPTURE_OFF == cap_fmt ||
+	0 == memcmp (cap_pal[first], rgb, count * 3)) {
+        return;
+    }
+    (void)memcpy (cap_pal[first], rgb, count * 3);
+    cap_pal_changed = 1;
+}
+
+
+/*
+ * capture_status
+ *   DESCRIPTION: Record a new status bar image for the frames that follow.
+ *   INPUTS: img -- status bar image, four planes of VIDEO_STATUS_SIZE
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void
+capture_status (const unsigned char* img)
+{
+    if (CAPTURE_OFF != cap_fmt) {
+	(void)memcpy (cap_status, img, sizeof (cap_status));
+    }
+}
+
+
+/*
+ * capture_frame
+ *   DESCRIPTION: Queue a frame for the writer thread, or drop it if the
+ *                writer has fallen behind.  Never waits.
+ *   INPUTS: plane -- display planes 0-3 of the view
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void
+capture_frame (const unsigned char* const plane[4])
+{
+    capture_slot_t* s;  /* slot to fill                */
+    int i;		/* loop index over video planes */
+
+    if (CAPTURE_OFF == cap_fmt) {
+        return;
+    }
+    cap_seq++;
+    if (CAPTURE_SLOTS == 
+	cap_head - __atomic_load_n (&cap_tail, __ATOMIC_ACQUIRE)) {
+        cap_dropped++;
+	return;
+    }
+    s = &cap_slot[cap_head % CAPTURE_SLOTS];
+    s->seq = cap_seq;
+    s->flags = (cap_pal_changed ? CAPTURE_PAL_CHANGED : 0);
+    cap_pal_changed = 0;
+    (void)memcpy (s->pal, cap_pal, sizeof (s->pal));
+    for (i = 0; i < 4; i++) {
+	(void)memcpy (s->img[i], plane[i], CAPTURE_PLANE_SIZE);
+    }
+    (void)memcpy (s->status, cap_status, sizeof (s->status));
+    __atomic_store_n (&cap_head, cap_head + 1, __ATOMIC_RELEASE);
+    (void)sem_post (&cap_sem);
+}
+
+
+/*
+ * capture_report
+ *   DESCRIPTION: Print the numbers of frames captured and dropped.
+ *   INPUTS: f -- stream for the report
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void
+capture_report (FILE* f)
+{
+    if (0 == cap_seq) {
+        return;
+    }
+    fprintf (f, "capture: %u of %u frames written, %u dropped, "
+	     "%u write errors\n", cap_written, cap_seq, cap_dropped, 
+	     cap_failed);
+}
+
+
+/*
+ * capture_thread
+ *   DESCRIPTION: Write queued frames until told to stop and the queue is
+ *                empty.
+ *   INPUTS: arg -- ignored
+ *   OUTPUTS: none
+ *   RETURN VALUE: NULL
+ *   SIDE EFFECTS: writes files
+ */
+static void*
+capture_thread (void* arg)
+{
+    static unsigned char pix[CAPTURE_X_DIM * CAPTURE_Y_DIM];
+    const capture_slot_t* s;	/* slot being written */
+    int rval;			/* result of write    */
+
+    while (1) {
+	(void)sem_wait (&cap_sem);
+	while (cap_tail != __atomic_load_n (&cap_head, __ATOMIC_ACQUIRE)) {
+	    s = &cap_slot[cap_tail % CAPTURE_SLOTS];
+	    deplanarize (s, pix);
+	    rval = (CAPTURE_PPM == cap_fmt ? write_ppm (s, pix) : 
+		    write_raw (s, pix));
+	    if (0 == rval) {
+	        cap_written++;
+	    } else {
+	        cap_failed++;
+	    }
+	    __atomic_store_n (&cap_tail, cap_tail + 1, __ATOMIC_RELEASE);
+	}
+	if (cap_stop) {
+	    return NULL;
+	}
+    }
+}
+
+
+/*
+ * deplanarize
+ *   DESCRIPTION: Convert a queued frame into one color index per pixel,
+ *                the view above the status bar.
+ *   INPUTS: s -- the queued frame
+ *   OUTPUTS: pix -- CAPTURE_X_DIM * CAPTURE_Y_DIM color indices
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void
+deplanarize (const capture_slot_t* s, unsigned char* pix)
+{
+    int x, y;  /* pixel coordinates */
+
+    for (y = 0; IMAGE_Y_DIM > y; y++) {
+	for (x = 0; CAPTURE_X_DIM > x; x++) {
+	    *pix++ = s->img[x & 3][y * SCROLL_X_WIDTH + (x >> 2)];
+	}
+    }
+    for (y = 0; VIDEO_STATUS_ROWS > y; y++) {
+	for (x = 0; CAPTURE_X_DIM > x; x++) {
+	    *pix++ = s->status[(x & 3) * VIDEO_STATUS_SIZE + 
+			       y * VIDEO_ROW_BYTES + (x >> 2)];
+	}
+    }
+}
+
+
+/*
+ * write_ppm
+ *   DESCRIPTION: Write a frame as a PPM image named for its frame number.
+ *   INPUTS: s -- the queued frame
+ *           pix -- its color indices
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on failure
+ *   SIDE EFFECTS: creates a file
+ */
+static int
+write_ppm (const capture_slot_t* s, const unsigned char* pix)
+{
+    char fname[FILENAME_MAX];	/* file for this frame     */
+    unsigned char row[CAPTURE_X_DIM * 3]; /* 8-bit RGB row */
+    const unsigned char* rgb;	/* palette color of pixel  */
+    FILE* out;			/* the file                */
+    int x, y;			/* pixel coordinates       */
+
+    (void)snprintf (fname, sizeof (fname), "%s%06u.ppm", cap_name, s->seq);
+    if (NULL == (out = fopen (fname, "wb"))) {
+        return -1;
+    }
+    fprintf (out, "P6\n%d %d\n255\n", CAPTURE_X_DIM, CAPTURE_Y_DIM);
+    for (y = 0; CAPTURE_Y_DIM > y; y++) {
+	for (x = 0; CAPTURE_X_DIM > x; x++) {
+	    rgb = s->pal[*pix++];
+
+	    /* Scale 6-bit color to 8 bits. */
+	    row[3 * x] = (rgb[0] << 2) | (rgb[0] >> 4);
+	    row[3 * x + 1] = (rgb[1] << 2) | (rgb[1] >> 4);
+	    row[3 * x + 2] = (rgb[2] << 2) | (rgb[2] >> 4);
+	}
+	if (1 != fwrite (row, sizeof (row), 1, out)) {
+	    (void)fclose (out);
+	    return -1;
+	}
+    }
+    return (0 == fclose (out) ? 0 : -1);
+}
+
+
+/*
+ * write_raw
+ *   DESCRIPTION: Append a frame record to the raw capture file.
+ *   INPUTS: s -- the queued frame
+ *           pix -- its color indices
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on failure
+ *   SIDE EFFECTS: writes to the capture file
+ */
+static int
+write_raw (const capture_slot_t* s, const unsigned char* pix)
+{
+    uint32_t hdr[2];  /* frame number and flags */
+
+    hdr[0] = s->seq;
+    hdr[1] = s->flags;
+    if (1 != fwrite (hdr, sizeof (hdr), 1, cap_file) ||
+	(0 != (s->flags & CAPTURE_PAL_CHANGED) &&
+	 1 != fwrite (s->pal, sizeof (s->pal), 1, cap_file)) ||
+	1 != fwrite (pix, CAPTURE_X_DIM * CAPTURE_Y_DIM, 1, cap_file)) {
+        return -1;
+    }
+    return 0;
+}
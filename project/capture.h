@@ -0,0 +1,91 @@
+/*									tab:8
+ *
+ * capture.h - header file for frame capture
+ *
+ * "Copyright (c) 2026 by Tianzuo Qin."
+ *
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation for any purpose, without fee, and without written agreement is
+ * hereby granted, provided that the above copyright notice and the following
+ * two paragraphs appear in all copies of this software.
+ *
+ * IN NO EVENT SHALL THE AUTHOR OR THE UNIVERSITY OF ILLINOIS BE LIABLE TO
+ * ANY PARTY FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL
+ * DAMAGES ARISING OUT  OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+ * EVEN IF THE AUTHOR AND/OR THE UNIVERSITY OF ILLINOIS HAS BEEN ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THE AUTHOR AND THE UNIVERSITY OF ILLINOIS SPECIFICALLY DISCLAIM ANY
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE
+ * PROVIDED HEREUNDER IS ON AN "AS IS" BASIS, AND NEITHER THE AUTHOR NOR
+ * THE UNIVERSITY OF ILLINOIS HAS ANY OBLIGATION TO PROVIDE MAINTENANCE,
+ * SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS."
+ *
+ * Author:	    Tianzuo Qin
+ * Version:	    1
+ * Creation Date:   Sun Oct 18 20:31:05 2026
+ * Filename:	    capture.h
+ * History:
+ *	TQ	1	Sun Oct 18 20:31:05 2026
+ *		First written.
+ */
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+
+#include <stdio.h>
+
+#include "modex.h"
+#include "video.h"
+
+
+/*
+ * Frame capture records every frame handed to show_screen, from any 
+ * video backend, without slowing the game.  show_screen copies the four
+ * display planes of the view into a free slot and posts it to a writer
+ * thread, which converts the planar image (and the status bar below it)
+ * into pixels and appends it to the capture.  If no slot is free because
+ * the writer has fallen behind, the frame is dropped and counted; the
+ * game never waits.
+ *
+ * The ADVENTURE_CAPTURE environment variable selects the capture when
+ * mode X is set:
+ *
+ *   ppm:<prefix> -- one PPM image per frame, named by appending a 
+ *                   six-digit frame number and ".ppm" to the prefix
+ *   raw:<file>   -- one file of frame records: a frame header (frame
+ *                   number and flags, two 32-bit native-endian words),
+ *                   the 256-color 6-bit palette if flag bit 0 is set 
+ *                   (the palette changed since the last record), and
+ *                   CAPTURE_X_DIM * CAPTURE_Y_DIM color indices
+ *
+ * Frame numbers count calls to show_screen, so dropped frames show up
+ * as gaps.
+ */
+#define CAPTURE_X_DIM  IMAGE_X_DIM
+#define CAPTURE_Y_DIM  (IMAGE_Y_DIM + VIDEO_STATUS_ROWS)
+#define CAPTURE_PAL_CHANGED 1	/* raw frame flag: palette follows */
+
+/* Start the capture named by ADVENTURE_CAPTURE, if any. */
+extern int capture_start (void);
+
+/* Write the frames still queued and stop capturing. */
+extern void capture_stop (void);
+
+/* Record colors loaded into the palette (6-bit RGB, three per color). */
+extern void capture_palette (int first, const unsigned char* rgb, int count);
+
+/* Record a new status bar image (four planes of VIDEO_STATUS_SIZE). */
+extern void capture_status (const unsigned char* img);
+
+/* 
+ * Queue a frame: plane[i] holds display plane i of the view, rows of
+ * SCROLL_X_WIDTH bytes.
+ */
+extern void capture_frame (const unsigned char* const plane[4]);
+
+/* Print frames captured and dropped (if capturing). */
+extern void capture_report (FILE* f);
+
+#endif /* CAPTURE_H */
@@ -0,0 +1,217 @@
+/*									tab:8
+ *
+ * cmdq.c - lock-free queue of player commands from input sources
+ *
+ * "Copyright (c) 2026 by Tianzuo Qin."
+ *
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation for any purpose, without fee, and without written agreement is
+ * hereby granted, provided that the above copyright notice and the following
+ * two paragraphs appear in all copies of this software.
+ *
+ * IN NO EVENT SHALL THE AUTHOR OR THE UNIVERSITY OF ILLINOIS BE LIABLE TO
+ * ANY PARTY FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL
+ * DAMAGES ARISING OUT  OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+ * EVEN IF THE AUTHOR AND/OR THE UNIVERSITY OF ILLINOIS HAS BEEN ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THE AUTHOR AND THE UNIVERSITY OF ILLINOIS SPECIFICALLY DISCLAIM ANY
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE
+ * PROVIDED HEREUNDER IS ON AN "AS IS" BASIS, AND NEITHER THE AUTHOR NOR
+ * THE UNIVERSITY OF ILLINOIS HAS ANY OBLIGATION TO PROVIDE MAINTENANCE,
+ * SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS."
+ *
+ * Author:	    Tianzuo Qin
+ * Version:	    1
+ * Creation Date:   Sun Oct 18 21:26:50 2026
+ * Filename:	    cmdq.c
+ * History:
+ *	TQ	1	Sun Oct 18 21:26:50 2026
+ *		First written.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cmdq.h"
+
+
+/* commands the queue can hold (a power of two) */
+#define CMDQ_SIZE 64
+#define CMDQ_MASK (CMDQ_SIZE - 1)
+
+
+/*
+ * The queue is a ring of cells, each with a sequence number that says
+ * whose turn it is: a cell at position pos (counting pushes since the
+ * start) is free for the push at pos when its seq is pos, holds that
+ * push's command when its seq is pos + 1, and is free for the push a 
+ * lap later when the command has been taken and its seq set to 
+ * pos + CMDQ_SIZE.  Producers claim positions by advancing tail with a
+ * compare-and-swap; the single consumer advances head alone.
+ */
+typedef struct cmdq_cell_t cmdq_cell_t;
+struct cmdq_cell_t {
+    uint32_t    seq;
+    cmd_event_t ev;
+};
+
+
+/* file-scope variables */
+
+static cmdq_cell_t cell[CMDQ_SIZE];
+static uint32_t tail;		/* next position to push    */
+static uint32_t head;		/* next position to take    */
+static int      wake_fd = -1;	/* eventfd to wake consumer */
+
+/* statistics for cmdq_report (times in microseconds) */
+static uint32_t num_pushed, num_dropped, num_popped;
+static double   queued_sum, queued_max;
+
+
+/*
+ * cmdq_init
+ *   DESCRIPTION: Empty the queue and create its eventfd.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, or -1 on failure
+ *   SIDE EFFECTS: creates an eventfd
+ */
+int
+cmdq_init ()
+{
+    uint32_t i;		/* index over cells */
+
+    for (i = 0; CMDQ_SIZE > i; i++) {
+        cell[i].seq = i;
+    }
+    head = tail = 0;
+    wake_fd = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+    return (0 > wake_fd ? -1 : 0);
+}
+
+
+/*
+ * cmdq_push
+ *   DESCRIPTION: Add a command to the queue, stamped with the current
+ *                time, and wake the consumer.  Safe to call from any
+ *                number of threads at once; never waits.
+ *   INPUTS: cmd -- the command
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, or -1 if the queue was full and the 
+ *                 command was dropped
+ *   SIDE EFFECTS: writes to the eventfd
+ */
+int
+cmdq_push (cmd_t cmd)
+{
+    cmdq_cell_t* c;	/* cell claimed         */
+    uint32_t pos;	/* position claimed     */
+    uint32_t seq;	/* cell sequence number */
+    uint64_t one = 1;	/* eventfd increment    */
+
+    pos = __atomic_load_n (&tail, __ATOMIC_RELAXED);
+    while (1) {
+	c = &cell[pos & CMDQ_MASK];
+	seq = __atomic_load_n (&c->seq, __ATOMIC_ACQUIRE);
+	if (seq == pos) {
+	    /* The cell is free; claim it (or retry with the new tail). */
+	    if (__atomic_compare_exchange_n (&tail, &pos, pos + 1, 1,
+					     __ATOMIC_RELAXED, 
+					     __ATOMIC_RELAXED)) {
+		break;
+	    }
+	} else if ((int32_t)(seq - pos) < 0) {
+	    /* The cell still holds a command from a lap ago: full. */
+	    (void)__atomic_add_fetch (&num_dropped, 1, __ATOMIC_RELAXED);
+	    return -1;
+	} else {
+	    /* Another producer claimed the cell; try the next. */
+	    pos = __atomic_load_n (&tail, __ATOMIC_RELAXED);
+	}
+    }
+
+    /* Fill the cell, then hand it to the consumer. */
+    c->ev.cmd = cmd;
+    (void)clock_gettime (CLOCK_MONOTONIC, &c->ev.when);
+    __atomic_store_n (&c->seq, pos + 1, __ATOMIC_RELEASE);
+    (void)__atomic_add_fetch (&num_pushed, 1, __ATOMIC_RELAXED);
+    (void)write (wake_fd, &one, sizeof (one));
+    return 0;
+}
+
+
+/*
+ * cmdq_pop
+ *   DESCRIPTION: Take the oldest command from the queue.  Only one
+ *                thread (the game loop) may take commands.
+ *   INPUTS: none
+ *   OUTPUTS: ev -- the command and when it was pushed
+ *   RETURN VALUE: 1 if a command was taken, or 0 if the queue is empty
+ *   SIDE EFFECTS: frees the command's cell for producers
+ */
+int
+cmdq_pop (cmd_event_t* ev)
+{
+    cmdq_cell_t* c;		/* oldest cell             */
+    struct timespec now;	/* time taken              */
+    double usec;		/* time spent in the queue */
+
+    c = &cell[head & CMDQ_MASK];
+    if (__atomic_load_n (&c->seq, __ATOMIC_ACQUIRE) != head + 1) {
+        return 0;
+    }
+    *ev = c->ev;
+    __atomic_store_n (&c->seq, head + CMDQ_SIZE, __ATOMIC_RELEASE);
+    head++;
+
+    (void)clock_gettime (CLOCK_MONOTONIC, &now);
+    usec = (now.tv_sec - ev->when.tv_sec) * 1e6 + 
+	   (now.tv_nsec - ev->when.tv_nsec) / 1e3;
+    queued_sum += usec;
+    if (queued_max < usec) {
+        queued_max = usec;
+    }
+    num_popped++;
+    return 1;
+}
+
+
+/*
+ * cmdq_fd
+ *   DESCRIPTION: Get the eventfd that becomes readable when commands are
+ *                pushed.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: the eventfd, or -1 before cmdq_init
+ *   SIDE EFFECTS: none
+ */
+int
+cmdq_fd ()
+{
+    return wake_fd;
+}
+
+
+/*
+ * cmdq_report
+ *   DESCRIPTION: Print the numbers of commands queued, taken, and 
+ *                dropped, and the mean and maximum time that commands
+ *                waited in the queue.
+ *   INPUTS: f -- output stream
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: prints to f
+ */
+void
+cmdq_report (FILE* f)
+{
+    fprintf (f, "command queue: %u queued, %u taken, %u dropped; "
+	     "waited %.0f us (max %.0f)\n", num_pushed, num_popped, 
+	     num_dropped, (0 == num_popped ? 0 : queued_sum / num_popped),
+	     queued_max);
+}
@@ -0,0 +1,76 @@
+/*									tab:8
+ *
+ * cmdq.h - header file for the player command queue
+ *
+ * "Copyright (c) 2026 by Tianzuo Qin."
+ *
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation for any purpose, without fee, and without written agreement is
+ * hereby granted, provided that the above copyright notice and the following
+ * two paragraphs appear in all copies of this software.
+ *
+ * IN NO EVENT SHALL THE AUTHOR OR THE UNIVERSITY OF ILLINOIS BE LIABLE TO
+ * ANY PARTY FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL
+ * DAMAGES ARISING OUT  OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+ * EVEN IF THE AUTHOR AND/OR THE UNIVERSITY OF ILLINOIS HAS BEEN ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THE AUTHOR AND THE UNIVERSITY OF ILLINOIS SPECIFICALLY DISCLAIM ANY
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE
+ * PROVIDED HEREUNDER IS ON AN "AS IS" BASIS, AND NEITHER THE AUTHOR NOR
+ * THE UNIVERSITY OF ILLINOIS HAS ANY OBLIGATION TO PROVIDE MAINTENANCE,
+ * SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS."
+ *
+ * Author:	    Tianzuo Qin
+ * Version:	    1
+ * Creation Date:   Sun Oct 18 21:26:50 2026
+ * Filename:	    cmdq.h
+ * History:
+ *	TQ	1	Sun Oct 18 21:26:50 2026
+ *		First written.
+ */
+#ifndef CMDQ_H
+#define CMDQ_H
+
+
+#include <stdio.h>
+#include <time.h>
+
+#include "input.h"
+
+
+/*
+ * All input sources--the keyboard, read by the game loop, and the Tux
+ * controller, read by its own thread--push the commands they receive
+ * into a bounded queue, and the game loop, which alone owns the game
+ * state and the screen, takes them off in order.  Pushing and taking
+ * never lock or wait.  Each push also makes an eventfd readable, so 
+ * that the game loop can sleep until a command arrives; the game loop
+ * should read the eventfd to clear it before taking commands.  When the
+ * queue is full, new commands are dropped and counted.
+ */
+
+/* a command and when it was received */
+typedef struct cmd_event_t cmd_event_t;
+struct cmd_event_t {
+    cmd_t           cmd;
+    struct timespec when;	/* CLOCK_MONOTONIC */
+};
+
+/* Create the queue; returns 0 on success, or -1 on failure. */
+extern int cmdq_init (void);
+
+/* Add a command (from any thread); returns 0, or -1 if it was dropped. */
+extern int cmdq_push (cmd_t cmd);
+
+/* Take the oldest command (game loop only); returns 1, or 0 if none. */
+extern int cmdq_pop (cmd_event_t* ev);
+
+/* Get the eventfd that becomes readable when commands are pushed. */
+extern int cmdq_fd (void);
+
+/* Print counts of commands queued and dropped, and time spent queued. */
+extern void cmdq_report (FILE* f);
+
+#endif /* CMDQ_H */
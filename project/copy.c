@@ -0,0 +1,385 @@
+/*									tab:8
+ *
+ * copy.c - memory copy kernels
+ *
+ * "Copyright (c) 2026 by Tianzuo Qin."
+ *
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation for any purpose, without fee, and without written agreement is
+ * hereby granted, provided that the above copyright notice and the following
+ * two paragraphs appear in all copies of this software.
+ *
+ * IN NO EVENT SHALL THE AUTHOR OR THE UNIVERSITY OF ILLINOIS BE LIABLE TO
+ * ANY PARTY FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL
+ * DAMAGES ARISING OUT  OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+ * EVEN IF THE AUTHOR AND/OR THE UNIVERSITY OF ILLINOIS HAS BEEN ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THE AUTHOR AND THE UNIVERSITY OF ILLINOIS SPECIFICALLY DISCLAIM ANY
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE
+ * PROVIDED HEREUNDER IS ON AN "AS IS" BASIS, AND NEITHER THE AUTHOR NOR
+ * THE UNIVERSITY OF ILLINOIS HAS ANY OBLIGATION TO PROVIDE MAINTENANCE,
+ * SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS."
+ *
+ * Author:	    Tianzuo Qin
+ * Version:	    1
+ * Creation Date:   Sun Oct 18 19:12:44 2026
+ * Filename:	    copy.c
+ * History:
+ *	TQ	1	Sun Oct 18 19:12:44 2026
+ *		First written.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "copy.h"
+
+
+/* 
+ * timing of each kernel: best of COPY_TRIALS runs, each of enough copies
+ * (up to COPY_MAX_REPS) to take COPY_MIN_USEC, well above clock noise
+ */
+#define COPY_TRIALS   3
+#define COPY_MIN_USEC 200
+#define COPY_MAX_REPS 65536
+
+
+/* local functions--see function headers for details */
+static void copy_movsb (void* dst, const void* src, size_t len);
+static int always (void);
+#if defined(__i386__) || defined(__x86_64__)
+static void copy_sse2 (void* dst, const void* src, size_t len);
+static void copy_avx (void* dst, const void* src, size_t len);
+static void copy_nt (void* dst, const void* src, size_t len);
+static int have_sse2 (void);
+static int have_avx (void);
+#endif
+static double time_kernel (const copy_kernel_t* k, void* dst, 
+			   const void* src, size_t len);
+static double time_copies (const copy_kernel_t* k, void* dst, 
+			   const void* src, size_t len, int reps);
+
+
+/* the kernels, in order of preference when timings tie */
+static const copy_kernel_t kernels[] = {
+    {"movsb", copy_movsb, always},
+#if defined(__i386__) || defined(__x86_64__)
+    {"sse2",  copy_sse2,  have_sse2},
+    {"avx",   copy_avx,   have_avx},
+    {"nt",    copy_nt,    have_sse2},
+#endif
+};
+#define NUM_KERNELS ((int)(sizeof (kernels) / sizeof (kernels[0])))
+
+const copy_kernel_t* copy_kernel = &kernels[0];
+static int selected;	/* 1 once copy_select has chosen */
+
+
+/*
+ * copy_select
+ *   DESCRIPTION: Choose the copy kernel for a destination: the kernel 
+ *                named by ADVENTURE_COPY_KERNEL if the CPU supports it,
+ *                or else the kernel with the fastest copies of len bytes
+ *                to scratch.  Only the first call chooses.
+ *   INPUTS: scratch -- destination memory that may be overwritten
+ *           len -- bytes per timed copy (at least one)
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: overwrites scratch; reads ADVENTURE_COPY_KERNEL; sets
+ *                 copy_kernel; prints the choice to stderr
+ */
+void
+copy_select (void* scratch, size_t len)
+{
+    const char* name;		/* kernel named in environment    */
+    unsigned char* src;		/* data to copy                   */
+    double usec[NUM_KERNELS];	/* best time per kernel, or -1    */
+    int best = 0;		/* fastest kernel                 */
+    int i;			/* loop index over kernels        */
+
+    if (selected) {
+        return;
+    }
+    selected = 1;
+
+    /* Use the kernel named in the environment if it can run. */
+    name = getenv ("ADVENTURE_COPY_KERNEL");
+    if (NULL != name) {
+	for (i = 0; NUM_KERNELS > i; i++) {
+	    if (0 == strcmp (name, kernels[i].name) && 
+		kernels[i].supported ()) {
+		copy_kernel = &kernels[i];
+		fprintf (stderr, "copy kernel: %s (from environment)\n", name);
+		return;
+	    }
+	}
+	fprintf (stderr, "copy kernel %s is not available\n", name);
+    }
+
+    /* Time the kernels on the destination. */
+    if (NULL == (src = malloc (len))) {
+        return;
+    }
+    for (i = 0; len > (size_t)i; i++) {
+        src[i] = i * 7;
+    }
+    for (i = 0; NUM_KERNELS > i; i++) {
+	usec[i] = (kernels[i].supported () ? 
+		   time_kernel (&kernels[i], scratch, src, len) : -1);
+	if (0 <= usec[i] && usec[i] < usec[best]) {
+	    best = i;
+	}
+    }
+    free (src);
+    copy_kernel = &kernels[best];
+
+    fprintf (stderr, "copy kernel: %s (", copy_kernel->name);
+    for (i = 0; NUM_KERNELS > i; i++) {
+	if (0 <= usec[i]) {
+	    fprintf (stderr, "%s%s %.0f MB/s", (0 == i ? "" : ", "), 
+		     kernels[i].name, len / (0 < usec[i] ? usec[i] : 1));
+	}
+    }
+    fprintf (stderr, ")\n");
+}
+
+
+/*
+ * time_kernel
+ *   DESCRIPTION: Time copies with a kernel.  The number of copies per
+ *                trial is doubled until a trial takes COPY_MIN_USEC.
+ *   INPUTS: k -- the kernel
+ *           dst -- destination
+ *           src -- source
+ *           len -- bytes per copy
+ *   OUTPUTS: none
+ *   RETURN VALUE: best time in microseconds per copy
+ *   SIDE EFFECTS: overwrites dst
+ */
+static double
+time_kernel (const copy_kernel_t* k, void* dst, const void* src, size_t len)
+{
+    double usec, best = -1;	/* trial time, best time    */
+    int reps;			/* copies per trial         */
+    int i;			/* loop index over trials   */
+
+    k->copy (dst, src, len);	/* warm up */
+    for (reps = 1; COPY_MAX_REPS > reps; reps *= 2) {
+	if (COPY_MIN_USEC <= time_copies (k, dst, src, len, reps)) {
+	    break;
+	}
+    }
+    for (i = 0; COPY_TRIALS > i; i++) {
+	usec = time_copies (k, dst, src, len, reps) / reps;
+	if (0 > best || usec < best) {
+	    best = usec;
+	}
+    }
+    return best;
+}
+
+
+/*
+ * time_copies
+ *   DESCRIPTION: Time a number of copies with a kernel.
+ *   INPUTS: k -- the kernel
+ *           dst -- destination
+ *           src -- source
+ *           len -- bytes per copy
+ *           reps -- number of copies
+ *   OUTPUTS: none
+ *   RETURN VALUE: time in microseconds for the copies
+ *   SIDE EFFECTS: overwrites dst
+ */
+static double
+time_copies (const copy_kernel_t* k, void* dst, const void* src, size_t len,
+	     int reps)
+{
+    struct timespec t0, t1;	/* start and end of copies */
+    int i;			/* loop index over copies  */
+
+    (void)clock_gettime (CLOCK_MONOTONIC, &t0);
+    for (i = 0; reps > i; i++) {
+	k->copy (dst, src, len);
+    }
+    (void)clock_gettime (CLOCK_MONOTONIC, &t1);
+    return (t1.tv_sec - t0.tv_sec) * 1e6 + (t1.tv_nsec - t0.tv_nsec) / 1e3;
+}
+
+
+/*
+ * always
+ *   DESCRIPTION: Report that a kernel runs on any CPU.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1
+ *   SIDE EFFECTS: none
+ */
+static int
+always ()
+{
+    return 1;
+}
+
+
+/*
+ * copy_movsb
+ *   DESCRIPTION: Copy memory with a single x86 string move.  Under
+ *                emulation, this is often vastly faster than anything
+ *                else for video memory.
+ *   INPUTS: dst -- destination
+ *           src -- source
+ *           len -- number of bytes to copy
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void
+copy_movsb (void* dst, const void* src, size_t len)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    asm volatile (
+        "cld                                                 ;"
+       	"rep movsb    # copy ECX bytes from M[ESI] to M[EDI]  "
+      : "+S" (src), "+D" (dst), "+c" (len)
+      : 
+      : "memory"
+    );
+#else
+    (void)memcpy (dst, src, len);
+#endif
+}
+
+#if defined(__i386__) || defined(__x86_64__)
+
+/*
+ * have_sse2
+ *   DESCRIPTION: Check whether the CPU supports SSE2.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if so, 0 if not
+ *   SIDE EFFECTS: none
+ */
+static int
+have_sse2 ()
+{
+    return (0 != __builtin_cpu_supports ("sse2"));
+}
+
+
+/*
+ * have_avx
+ *   DESCRIPTION: Check whether the CPU supports AVX.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if so, 0 if not
+ *   SIDE EFFECTS: none
+ */
+static int
+have_avx ()
+{
+    return (0 != __builtin_cpu_supports ("avx"));
+}
+
+
+/*
+ * copy_sse2
+ *   DESCRIPTION: Copy memory with 16-byte SSE2 stores, aligned on the
+ *                destination.
+ *   INPUTS: dst -- destination
+ *           src -- source
+ *           len -- number of bytes to copy
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+__attribute__ ((target ("sse2")))
+static void
+copy_sse2 (void* dst, const void* src, size_t len)
+{
+    unsigned char* d = dst;		/* next byte to write */
+    const unsigned char* s = src;	/* next byte to read  */
+
+    for (; 0 < len && 0 != ((uintptr_t)d & 15); len--) {
+        *d++ = *s++;
+    }
+    for (; 16 <= len; len -= 16, d += 16, s += 16) {
+	_mm_store_si128 ((__m128i*)d, _mm_loadu_si128 ((const __m128i*)s));
+    }
+    for (; 0 < len; len--) {
+        *d++ = *s++;
+    }
+}
+
+
+/*
+ * copy_avx
+ *   DESCRIPTION: Copy memory with 32-byte AVX stores, aligned on the
+ *                destination.
+ *   INPUTS: dst -- destination
+ *           src -- source
+ *           len -- number of bytes to copy
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+__attribute__ ((target ("avx")))
+static void
+copy_avx (void* dst, const void* src, size_t len)
+{
+    unsigned char* d = dst;		/* next byte to write */
+    const unsigned char* s = src;	/* next byte to read  */
+
+    for (; 0 < len && 0 != ((uintptr_t)d & 31); len--) {
+        *d++ = *s++;
+    }
+    for (; 32 <= len; len -= 32, d += 32, s += 32) {
+	_mm256_store_si256 ((__m256i*)d, 
+			    _mm256_loadu_si256 ((const __m256i*)s));
+    }
+    for (; 0 < len; len--) {
+        *d++ = *s++;
+    }
+}
+
+
+/*
+ * copy_nt
+ *   DESCRIPTION: Copy memory with 16-byte non-temporal stores, which 
+ *                bypass the cache, aligned on the destination.
+ *   INPUTS: dst -- destination
+ *           src -- source
+ *           len -- number of bytes to copy
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+__attribute__ ((target ("sse2")))
+static void
+copy_nt (void* dst, const void* src, size_t len)
+{
+    unsigned char* d = dst;		/* next byte to write */
+    const unsigned char* s = src;	/* next byte to read  */
+
+    for (; 0 < len && 0 != ((uintptr_t)d & 15); len--) {
+        *d++ = *s++;
+    }
+    for (; 16 <= len; len -= 16, d += 16, s += 16) {
+	_mm_stream_si128 ((__m128i*)d, _mm_loadu_si128 ((const __m128i*)s));
+    }
+    _mm_sfence ();	/* Make the stores visible before returning. */
+    for (; 0 < len; len--) {
+        *d++ = *s++;
+    }
+}
+
+#endif /* x86 */
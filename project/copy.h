@@ -0,0 +1,73 @@
+/*									tab:8
+ *
+ * copy.h - header file for memory copy kernels
+ *
+ * "Copyright (c) 2026 by Tianzuo Qin."
+ *
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation for any purpose, without fee, and without written agreement is
+ * hereby granted, provided that the above copyright notice and the following
+ * two paragraphs appear in all copies of this software.
+ *
+ * IN NO EVENT SHALL THE AUTHOR OR THE UNIVERSITY OF ILLINOIS BE LIABLE TO
+ * ANY PARTY FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL
+ * DAMAGES ARISING OUT  OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+ * EVEN IF THE AUTHOR AND/OR THE UNIVERSITY OF ILLINOIS HAS BEEN ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THE AUTHOR AND THE UNIVERSITY OF ILLINOIS SPECIFICALLY DISCLAIM ANY
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE
+ * PROVIDED HEREUNDER IS ON AN "AS IS" BASIS, AND NEITHER THE AUTHOR NOR
+ * THE UNIVERSITY OF ILLINOIS HAS ANY OBLIGATION TO PROVIDE MAINTENANCE,
+ * SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS."
+ *
+ * Author:	    Tianzuo Qin
+ * Version:	    1
+ * Creation Date:   Sun Oct 18 19:12:44 2026
+ * Filename:	    copy.h
+ * History:
+ *	TQ	1	Sun Oct 18 19:12:44 2026
+ *		First written.
+ */
+#ifndef COPY_H
+#define COPY_H
+
+
+#include <stddef.h>
+
+
+/*
+ * Screen images reach video memory through one of several copy kernels:
+ * REP MOVSB, 16-byte SSE2 stores, 32-byte AVX stores, and 16-byte 
+ * non-temporal (cache-bypassing) stores.  Which is fastest depends on 
+ * the destination--uncached VGA memory behind a virtual machine behaves
+ * nothing like an ordinary framebuffer in the cache--so the backend
+ * times each kernel the CPU supports on its own memory when mode X is
+ * set, and uses the fastest.  The ADVENTURE_COPY_KERNEL environment 
+ * variable names a kernel to use instead.  The choice is printed to
+ * stderr.
+ */
+
+/* a copy kernel */
+typedef struct copy_kernel_t copy_kernel_t;
+struct copy_kernel_t {
+    const char* name;
+
+    /* Copy len bytes from src to dst (which do not overlap). */
+    void (*copy) (void* dst, const void* src, size_t len);
+
+    /* Return 1 if the CPU can run the kernel. */
+    int (*supported) (void);
+};
+
+/* the kernel in use (REP MOVSB until copy_select is called) */
+extern const copy_kernel_t* copy_kernel;
+
+/* 
+ * Choose the kernel for a destination by timing copies of len bytes to
+ * scratch, which is overwritten.  Only the first call chooses. 
+ */
+extern void copy_select (void* scratch, size_t len);
+
+#endif /* COPY_H */
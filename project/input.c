@@ -56,6 +56,7 @@
 
 #include "assert.h"
 #include "input.h"
+#include "replay.h"
 
 #include "./module/tuxctl-ioctl.h"
 #include "./module/mtcp.h"
@@ -122,6 +123,14 @@ init_input ()
 	return -1;
     }
 
+    /*
+     * A replay needs no keyboard, so stdin need not be a terminal (as
+     * when a route is run as a benchmark).
+     */
+    if (replay_playing () && !isatty (fileno (stdin))) {
+	return 0;
+    }
+
     /*
      * Save current terminal attributes for stdin.
      */
@@ -192,6 +201,9 @@ typed_a_char (char c)
  *                to this routine.
  *   INPUTS: cur_dir -- current direction of motion
  *   OUTPUTS: none
+ *                When a recording is replayed, its commands and typing
+ *                are returned instead, and keys other than the quit key
+ *                are ignored.
  *   RETURN VALUE: command issued by the input controller
  *   SIDE EFFECTS: drains any keyboard input
  */
@@ -206,6 +218,16 @@ get_command ()
     int ch;
 //	unsigned long button_stat;
 /*	unsigned long button_stat;*/
+
+    /* Replay a recording (see replay.h), still allowing a quit. */
+    if (replay_playing ()) {
+	while ((ch = getc (stdin)) != EOF) {
+	    if (ch == '`')
+		return CMD_QUIT;
+	}
+	return replay_next (typing);
+    }
+
     /* Read all characters from stdin. */
     while ((ch = getc (stdin)) != EOF) {
 
@@ -509,7 +531,25 @@ main ()
 }
 #endif
 
-void get_button_status(uint8_t* ptr){
+void get_button_status(unsigned long* ptr){
 	ioctl(fd,TUX_BUTTONS,ptr);
 	return ;
 }
+
+/* 
+ * get_input_fds
+ *   DESCRIPTION: Get the file descriptors on which input arrives, so 
+ *                that the game loop can sleep until there is some.
+ *   INPUTS: none
+ *   OUTPUTS: key_fd -- descriptor for typed keys (stdin)
+ *            tux_fd -- descriptor for the Tux controller, or -1 if the
+ *                      serial port is not open
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void
+get_input_fds (int* key_fd, int* tux_fd)
+{
+    *key_fd = fileno (stdin);
+    *tux_fd = fd;
+}
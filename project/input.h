@@ -71,7 +71,13 @@ extern void shutdown_input ();
 extern void display_time_on_tux (int num_seconds);
 
 /* Get the button status.*/
-extern void get_button_status(uint8_t* ptr);
+extern void get_button_status(unsigned long* ptr);
+
+/* 
+ * Get the descriptors to watch for input: stdin, which becomes readable
+ * when keys are typed, and the Tux controller (-1 if it is not open).
+ */
+extern void get_input_fds (int* key_fd, int* tux_fd);
 
 /* Get the command by outside function. */
 extern cmd_t GTC();
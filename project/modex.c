@@ -41,14 +41,23 @@
  */
 
 #include <fcntl.h>
+#include <pthread.h>
+#include <semaphore.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/io.h>
 #include <sys/mman.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "capture.h"
+#include "copy.h"
 #include "modex.h"
+#include "port.h"
 #include "text.h"
+#include "trace.h"
+#include "video.h"
 
 
 /* 
@@ -82,9 +91,6 @@
 #define NUM_GRAPHICS_REGS       9
 #define NUM_ATTR_REGS          22
 
-/* one plane size in VGA (my own constant)*/
-const int oneplane1440 = 1440;
-
 /* VGA register settings for mode X */
 static unsigned short mode_X_seq[NUM_SEQUENCER_REGS] = {
     0x0100, 0x2101, 0x0F02, 0x0003, 0x0604
@@ -144,8 +150,44 @@ static void fill_palette_mode_x ();
 static void fill_palette_text ();
 static void write_font_data ();
 static void set_text_mode_3 (int clear_scr);
-static void copy_image (unsigned char* img, unsigned short scr_addr);
-static void copy_status_bar (unsigned char* img, unsigned short scr_addr);
+static void copy_image (const unsigned char* img, unsigned short scr_addr,
+			int len);
+static void mark_rows_dirty (int first, int n);
+static void shift_dirty (int dx, int dy);
+static int latch_prepare_page (int page, const unsigned char* addr, 
+			       int p_off);
+static void upload_dirty_cols (int page, const unsigned char* addr,
+			       int p_off);
+static uint64_t view_hash (const unsigned char* addr, int p_off);
+static void vram_alloc_init (int lo, int hi);
+static int vram_alloc (int len);
+static void vram_free (int addr);
+static void latch_reset (void);
+static void vram_frame_done (void);
+static void load_palette (int first, const unsigned char* rgb, int count);
+static void publish_frame (void);
+static void* present_thread (void* arg);
+static void stop_present_thread (void);
+static void hw_place_window (void);
+static void hw_upload_rows (int first, int n);
+#if !defined(TEXT_RESTORE_PROGRAM)
+static void hw_upload_col (int x);
+#endif
+static int vga_open (void);
+static void vga_close (void);
+static void vga_set_mode (video_mode_t mode);
+static void vga_clear (void);
+static void vga_write_plane (int plane, uint16_t addr,
+			     const unsigned char* src, int len);
+static void vga_present (uint16_t start, int pan);
+static void vga_set_row_bytes (int row_bytes);
+static void vga_set_attr (int index, int val);
+static void vga_wait_retrace (void);
+static void vga_copy_vram (uint16_t dst, uint16_t src, int width, int height,
+			   int stride);
+static void vga_load_palette (int first, const unsigned char* rgb, int count);
+static void vga_write_status_bar (const unsigned char* img, int x, 
+				  int width);
 
 
 /* 
@@ -189,6 +231,212 @@ static int show_x, show_y;          /* logical view coordinates     */
 static unsigned char* mem_image;    /* pointer to start of video memory */
 static unsigned short target_img;   /* offset of displayed screen image */
 
+/*
+ * Rows of the logical view window that have changed since each of the
+ * two video pages was last written.  A row is marked for both pages when
+ * it is drawn (or when the view moves, which changes every row), and
+ * show_screen copies only the rows marked for the page it fills.  Page 0
+ * is at 0x05A0, page 1 at 0x45A0.
+ */
+static unsigned char row_dirty[2][SCROLL_Y_DIM];
+
+/*
+ * Latch copies (ADVENTURE_LATCH=1; two-page mode only).  In mode X the
+ * VGA can copy video memory to video memory four pixels (one per plane)
+ * per byte accessed, by reading into the graphics controller latches and
+ * writing them back in write mode 1.  Two uses are made of this:
+ *
+ * When the view has moved by a multiple of four pixels across and any
+ * number of rows down since a page was last written, the part of the 
+ * page that is still on screen is moved within the page, and only the 
+ * newly exposed rows and columns are copied from the build buffer.  For
+ * this, pages remember the view they hold (page_x, page_y), and changes
+ * are tracked per column (col_dirty) as well as per row, moving with the
+ * view when it moves.  With two pages and two-pixel motion, each page is
+ * two moves behind, i.e., four pixels.
+ *
+ * When a page must be rewritten in full, the view is looked up by a hash
+ * of its contents in a cache of whole screens kept in the video memory
+ * beyond the two pages, and copied from there on a hit (re-entering a
+ * room, leaving the overview map).  Screens written in full are added to
+ * the cache, replacing the least recently used.  The space beyond the 
+ * pages is handed out by a first-fit allocator.
+ */
+#define VRAM_BLOCKS        16	/* most allocator blocks                  */
+#define SCREEN_CACHE_SLOTS 4	/* most cached screens (space permitting) */
+typedef struct vram_block_t vram_block_t;
+struct vram_block_t {
+    int addr;			/* first address of block                 */
+    int len;			/* bytes per plane                        */
+    int used;			/* 1 if allocated                         */
+};
+typedef struct screen_slot_t screen_slot_t;
+struct screen_slot_t {
+    int      addr;		/* video memory address, or -1 if unused  */
+    uint64_t hash;		/* hash of screen contents                */
+    uint32_t last_use;		/* frame of last use, for replacement     */
+};
+static int latch_copy;		/* 1 if latch copies are used             */
+static int page_x[2], page_y[2];	/* view held by each page                 */
+static unsigned char page_valid[2];	/* 1 if page holds that view       */
+static unsigned char col_dirty[2][SCROLL_X_DIM];
+static vram_block_t vram_block[VRAM_BLOCKS];
+static int vram_nblocks;
+static screen_slot_t screen_slot[SCREEN_CACHE_SLOTS];
+static uint32_t latch_shifts;	/* pages updated by moving contents       */
+static uint32_t cache_hits;	/* full screens copied from the cache     */
+static uint32_t cache_misses;	/* full screens not in the cache          */
+static uint32_t latch_bytes;	/* byte accesses made by latch copies     */
+
+/*
+ * Hardware scrolling (ADVENTURE_SCROLL=hw).  Instead of two pages of
+ * 80-byte rows, video memory above the status bar holds one virtual 
+ * screen with HW_ROW_BYTES-byte rows, and each map pixel (x,y) lives at
+ * hw_base + y * HW_ROW_BYTES + (x >> 2) in plane (x & 3).  Moving the 
+ * view only moves the CRTC start address (by rows and groups of four
+ * pixels) and the pixel panning register (by the remaining 0-3 pixels).
+ * Since a row of the screen needs at most 81 of the HW_ROW_BYTES bytes,
+ * columns never collide with the columns of neighboring rows, so the map
+ * can scroll sideways indefinitely; only lines newly drawn into the build
+ * buffer are copied to video memory, as they are drawn.  When the screen
+ * would run off either end of video memory, hw_base is moved to center
+ * it again and the whole screen is copied once (a rebase).
+ */
+#define HW_ROW_BYTES   88
+#define HW_STATUS_SIZE (HW_ROW_BYTES * VIDEO_STATUS_ROWS)
+#define HW_SCREEN_SPAN ((SCROLL_Y_DIM - 1) * HW_ROW_BYTES + SCROLL_X_WIDTH + 1)
+static int hw_scroll;		/* 1 if hardware scrolling is in use      */
+static int hw_base;		/* address of map pixel (0,0); may be out */
+				/*     of range                           */
+static int hw_full;		/* 1 if whole screen must be copied       */
+static uint32_t hw_rebases;	/* number of rebases                      */
+
+/*
+ * Threaded presentation (ADVENTURE_PRESENT=thread; not used with hardware
+ * scrolling).  show_screen copies the rows of the view that changed into
+ * a frame snapshot in ordinary memory and passes it to the present thread,
+ * which copies changed rows into one of three pages of video memory and
+ * flips to that page while the game loop goes on with the next tick.  The
+ * status bar and room palette travel with the frame, so only the present
+ * thread uses the video backend.
+ *
+ * The three snapshots form a lock-free triple buffer: show_screen fills
+ * frames[back_frame], the present thread reads frames[front_frame], and
+ * the single-slot mailbox holds the index of the third, plus FRAME_FRESH
+ * if that frame has not been taken yet.  Each side swaps its frame with
+ * the mailbox in one atomic exchange.  A frame replaced in the mailbox
+ * before the present thread took it is dropped.
+ *
+ * Changes are tracked by frame number instead of dirty flags: row_seq
+ * records the frame in which each row last changed, and a snapshot or a
+ * page needs a row only if that is newer than the frame it holds, which
+ * stays correct when frames are dropped.
+ */
+#define NUM_FRAMES    3
+#define NUM_PAGES     3
+#define FRAME_FRESH   4
+#define PAGE_ADDR(p)  (0x05A0 + (p) * SCROLL_SIZE)
+#define PALETTE_SIZE  (192 * 3)
+
+typedef struct frame_t frame_t;
+struct frame_t {
+    uint32_t      seq;			/* frame number of contents   */
+    uint32_t      row_seq[SCROLL_Y_DIM];	/* frame of last row change   */
+    uint32_t      status_seq;		/* frame of last status bar   */
+    uint32_t      pal_seq;		/* frame of last palette      */
+    unsigned char img[4][SCROLL_SIZE];	/* display planes 0-3         */
+    unsigned char status[4 * VIDEO_STATUS_SIZE];
+    unsigned char pal[PALETTE_SIZE];	/* colors 64-255              */
+};
+static frame_t   frames[NUM_FRAMES];
+static int       present_threaded;	/* 1 if present thread runs   */
+static pthread_t present_thread_id;
+static sem_t     present_sem;		/* posted once per frame      */
+static volatile int present_stop;	/* tells present thread to end */
+static int       mailbox = 1;		/* middle frame + FRAME_FRESH */
+static int       back_frame = 0;	/* frame filled by show_screen */
+static int       front_frame = 2;	/* frame read by present thread */
+static uint32_t  cur_seq = 1;		/* number of frame being built */
+static uint32_t  row_seq[SCROLL_Y_DIM];
+static uint32_t  status_seq;
+static uint32_t  pal_seq;
+static unsigned char status_img[4 * VIDEO_STATUS_SIZE];
+static unsigned char pal_img[PALETTE_SIZE];
+static uint32_t  frames_presented;	/* counted by present thread  */
+static uint32_t  frames_dropped;	/* counted by show_screen     */
+
+/*
+ * The palette as last loaded, so that only colors that changed need to be
+ * loaded again: each run of changed colors costs one write of the DAC
+ * write index (0x3C8) and three data writes (0x3C9) per color.  Setting
+ * mode X empties the cache.
+ */
+static unsigned char pal_cache[256][3];
+static unsigned char pal_cached[256];	/* 1 if pal_cache entry is valid */
+static uint32_t pal_loads;		/* palette loads requested        */
+static uint32_t pal_runs;		/* runs of colors written         */
+static uint32_t pal_bytes;		/* color bytes written            */
+static uint32_t pal_bytes_asked;	/* color bytes requested          */
+
+/*
+ * The status bar text last drawn into status_img (and video memory), so
+ * that only cells whose characters change are drawn again.  A cell is
+ * FONT_WIDTH pixels wide, or STATUS_CELL_BYTES bytes in each plane of 
+ * each row.  Setting mode X or clearing the screens forgets the text.
+ */
+#define STATUS_CELL_BYTES (FONT_WIDTH / 4)
+static unsigned char status_text[STATUS_BAR_CELLS];
+static int      status_text_valid;	/* 1 if status_text was drawn */
+static uint32_t status_shows;		/* calls to show_status_bar   */
+static uint32_t status_cells;		/* cells drawn                */
+
+/* bytes written to video memory, per frame (show_screen to show_screen) */
+static uint32_t vram_frame;	/* bytes in current frame         */
+static uint32_t vram_last;	/* bytes in last complete frame   */
+static uint32_t vram_max;	/* most bytes in one frame        */
+static uint32_t vram_frames;	/* complete frames                */
+static uint64_t vram_total;	/* bytes in all complete frames   */
+
+/* the video backend in use (chosen by set_mode_X) */
+static const video_ops_t* video = &vga_video;
+
+/* the VGA backend */
+const video_ops_t vga_video = {
+    "vga", vga_open, vga_close, vga_set_mode, vga_clear, vga_write_plane,
+    vga_present, vga_set_row_bytes, vga_copy_vram, vga_load_palette,
+    vga_write_status_bar
+};
+
+/* VGA display row spacing and pixel panning, as last programmed */
+static int vga_row_bytes = VIDEO_ROW_BYTES;
+static int vga_pan;
+
+/*
+ * Retrace-aligned flips (ADVENTURE_VSYNC=1, VGA backend).  The CRTC
+ * latches a new start address at the start of vertical sync, so after
+ * writing it vga_present polls the input status register for the next
+ * rising edge of the sync bit.  Once seen, the new page is on screen and
+ * the old one is free to be drawn again; pixel panning, which takes
+ * effect at once, is then written during the retrace.  The wait gives up
+ * after VSYNC_MAX_WAIT_USEC (more than a frame at 70 Hz), counting the
+ * retrace as missed.  The present thread skips the wait when a newer
+ * frame is already waiting, since it is behind anyway.
+ *
+ * Wait times are kept in a histogram of 1 ms buckets; the last bucket
+ * holds longer waits.  Short waits mean little slack before the retrace.
+ */
+#define VSYNC_MAX_WAIT_USEC 20000
+#define VSYNC_HIST_BUCKETS  16
+static int      vsync;			/* 1 if flips wait for retrace  */
+static uint32_t vsync_hist[VSYNC_HIST_BUCKETS];
+static uint32_t vsync_waits;		/* retraces waited for          */
+static uint32_t vsync_missed;		/* waits that timed out         */
+static uint32_t vsync_skipped;		/* waits skipped when behind    */
+static double   vsync_wait_total;	/* microseconds spent waiting   */
+static double   vsync_wait_max;		/* longest wait (microseconds)  */
+static struct timespec vsync_first;	/* time of first flip           */
+static struct timespec vsync_last;	/* time of latest flip          */
+
 
 /* 
  * functions provided by the caller to set_mode_X() and used to obtain  
@@ -199,71 +447,33 @@ static void (*horiz_line_fn) (int, int, unsigned char[SCROLL_X_DIM]);
 static void (*vert_line_fn) (int, int, unsigned char[SCROLL_Y_DIM]);
 	
 
+/* 
+ * macros used to write to VGA ports; all port I/O goes through port.c,
+ * which counts writes and drops redundant ones
+ */
+
 /* 
  * macro used to target a specific video plane or planes when writing
  * to video memory in mode X; bits 8-11 in the mask_hi_bits enable writes
  * to planes 0-3, respectively
  */
-#define SET_WRITE_MASK(mask_hi_bits)                                    \
-do {                                                                    \
-    asm volatile ("                                                     \
-	movw $0x03C4,%%dx    	/* set write mask                    */;\
-	movb $0x02,%b0                                                 ;\
-	outw %w0,(%%dx)                                                 \
-    " : : "a" ((mask_hi_bits)) : "edx", "memory");                      \
-} while (0)
+#define SET_WRITE_MASK(mask_hi_bits) port_outw (0x03C4, (mask_hi_bits) | 0x02)
 
 /* macro used to write a byte to a port */
-#define OUTB(port,val)                                                  \
-do {                                                                    \
-    asm volatile ("                                                     \
-        outb %b1,(%w0)                                                  \
-    " : /* no outputs */                                                \
-      : "d" ((port)), "a" ((val))                                       \
-      : "memory", "cc");                                                \
-} while (0)
+#define OUTB(port,val) port_outb ((port), (val))
 
 /* macro used to write two bytes to two consecutive ports */
-#define OUTW(port,val)                                                  \
-do {                                                                    \
-    asm volatile ("                                                     \
-        outw %w1,(%w0)                                                  \
-    " : /* no outputs */                                                \
-      : "d" ((port)), "a" ((val))                                       \
-      : "memory", "cc");                                                \
-} while (0)
+#define OUTW(port,val) port_outw ((port), (val))
 
 /* 
  * macro used to write an array of two-byte values to two consecutive ports 
  */
-#define REP_OUTSW(port,source,count)                                    \
-do {                                                                    \
-    asm volatile ("                                                     \
-     1: movw 0(%1),%%ax                                                ;\
-	outw %%ax,(%w2)                                                ;\
-	addl $2,%1                                                     ;\
-	decl %0                                                        ;\
-	jne 1b                                                          \
-    " : /* no outputs */                                                \
-      : "c" ((count)), "S" ((source)), "d" ((port))                     \
-      : "eax", "memory", "cc");                                         \
-} while (0)
+#define REP_OUTSW(port,source,count) port_outsw ((port), (source), (count))
 
 /* 
  * macro used to write an array of one-byte values to two consecutive ports 
  */
-#define REP_OUTSB(port,source,count)                                    \
-do {                                                                    \
-    asm volatile ("                                                     \
-     1: movb 0(%1),%%al                                                ;\
-	outb %%al,(%w2)                                                ;\
-	incl %1                                                        ;\
-	decl %0                                                        ;\
-	jne 1b                                                          \
-    " : /* no outputs */                                                \
-      : "c" ((count)), "S" ((source)), "d" ((port))                     \
-      : "eax", "memory", "cc");                                         \
-} while (0)
+#define REP_OUTSB(port,source,count) port_outsb ((port), (source), (count))
 
 
 /*
@@ -279,14 +489,20 @@ do {                                                                    \
  *   			     drawing to the build buffer
  *   OUTPUTS: none
  *   RETURN VALUE: 0 on success, -1 on failure
- *   SIDE EFFECTS: initializes the logical view window; maps video memory
- *                 and obtains permission for VGA ports; clears video memory
+ *   SIDE EFFECTS: initializes the logical view window; opens the video
+ *                 backend named by ADVENTURE_VIDEO (VGA by default), which
+ *                 for VGA maps video memory and obtains permission for
+ *                 VGA ports; clears video memory; uses hardware scrolling
+ *                 if ADVENTURE_SCROLL is "hw", or else starts the present
+ *                 thread if ADVENTURE_PRESENT is "thread"; waits for
+ *                 retrace on VGA page flips if ADVENTURE_VSYNC is "1"
  */   
 int
 set_mode_X (void (*horiz_fill_fn) (int, int, unsigned char[SCROLL_X_DIM]),
             void (*vert_fill_fn) (int, int, unsigned char[SCROLL_Y_DIM]))
 {
     int i; /* loop index for filling memory fence with magic numbers */
+    const char* name; /* name of video backend to use */
 
     /* 
      * Record callback functions for obtaining horizontal and vertical 
@@ -309,32 +525,69 @@ set_mode_X (void (*horiz_fill_fn) (int, int, unsigned char[SCROLL_X_DIM]),
     }
 
     /* One display page goes at the start of video memory. */
-    target_img = 1440; 
+    target_img = VIDEO_STATUS_SIZE;
+
+    /* Pick and open the video backend. */
+    name = getenv ("ADVENTURE_VIDEO");
+    if (NULL == name || 0 == strcmp (name, vga_video.name)) {
+        video = &vga_video;
+    } else if (0 == strcmp (name, vmem_video.name)) {
+        video = &vmem_video;
+    } else if (0 == strcmp (name, vterm_video.name)) {
+        video = &vterm_video;
+    } else {
+        fprintf (stderr, "unknown video backend %s\n", name);
+	return -1;
+    }
+    if (video->open () == -1)
+        return -1;
 
-    /* Map video memory and obtain permission for VGA port access. */
-    if (open_memory_and_ports () == -1)
+    /* Start capturing frames if requested. */
+    if (capture_start () == -1) {
+        video->close ();
         return -1;
+    }
 
-    /* 
-     * The code below was produced by recording a call to set mode 0013h
-     * with display memory clearing and a windowed frame buffer, then
-     * modifying the code to set mode X instead.  The code was then
-     * generalized into functions...
-     *
-     * modifications from mode 13h to mode X include...
-     *   Sequencer Memory Mode Register: 0x0E to 0x06 (0x3C4/0x04)
-     *   Underline Location Register   : 0x40 to 0x00 (0x3D4/0x14)
-     *   CRTC Mode Control Register    : 0xA3 to 0xE3 (0x3D4/0x17)
-     */
+    /* Set mode X (which clears video memory) and the fixed colors. */
+    video->set_mode (VIDEO_MODE_X);
+    status_text_valid = 0;
+    (void)memset (pal_cached, 0, sizeof (pal_cached));
+    fill_palette_mode_x ();
+
+    /* Widen the display rows for hardware scrolling if requested. */
+    name = getenv ("ADVENTURE_SCROLL");
+    hw_scroll = (NULL != name && 0 == strcmp (name, "hw"));
+    if (hw_scroll) {
+        video->set_row_bytes (HW_ROW_BYTES);
+	hw_full = 1;
+	hw_place_window ();
+    }
 
-    VGA_blank (1);                               /* blank the screen      */
-    set_seq_regs_and_reset (mode_X_seq, 0x63);   /* sequencer registers   */
-    set_CRTC_registers (mode_X_CRTC);            /* CRT control registers */
-    set_attr_registers (mode_X_attr);            /* attribute registers   */
-    set_graphics_registers (mode_X_graphics);    /* graphics registers    */
-    fill_palette_mode_x ();			 /* palette colors        */
-    clear_screens ();				 /* zero video memory     */
-    VGA_blank (0);			         /* unblank the screen    */
+    /* Wait for vertical retrace when flipping pages if requested. */
+    name = getenv ("ADVENTURE_VSYNC");
+    vsync = (NULL != name && 0 == strcmp (name, "1"));
+
+    /* Use latch copies in two-page mode if requested. */
+    name = getenv ("ADVENTURE_LATCH");
+    latch_copy = (!hw_scroll && NULL != name && 0 == strcmp (name, "1"));
+    latch_reset ();
+    vram_alloc_init (0x45A0 + SCROLL_SIZE, MODE_X_MEM_SIZE);
+
+    /* Start the present thread if requested. */
+    name = getenv ("ADVENTURE_PRESENT");
+    if (!hw_scroll && NULL != name && 0 == strcmp (name, "thread")) {
+	mark_rows_dirty (0, SCROLL_Y_DIM);
+	present_stop = 0;
+	if (0 == sem_init (&present_sem, 0, 0)) {
+	    if (0 == pthread_create (&present_thread_id, NULL, 
+				     present_thread, NULL)) {
+		present_threaded = 1;
+		latch_copy = 0;
+	    } else {
+		(void)sem_destroy (&present_sem);
+	    }
+	}
+    }
 
     /* Return success. */
     return 0;
@@ -355,11 +608,17 @@ clear_mode_X ()
 {
     int i;   /* loop index for checking memory fence */
     
+    /* Finish with the present thread, which owns the display. */
+    stop_present_thread ();
+
+    /* Write any frames still queued for capture. */
+    capture_stop ();
+
     /* Put VGA into text mode, restore font data, and clear screens. */
-    set_text_mode_3 (1);
+    video->set_mode (VIDEO_MODE_TEXT);
 
-    /* Unmap video memory. */
-    (void)munmap (mem_image, VID_MEM_SIZE);
+    /* Release the display (unmaps video memory for VGA). */
+    video->close ();
 
     /* Check validity of build buffer memory fence.  Report breakage. */
     for (i = 0; i < MEM_FENCE_WIDTH; i++) {
@@ -409,10 +668,27 @@ set_view_window (int scr_x, int scr_y)
     old_x = show_x;
     old_y = show_y;
 
+    /* 
+     * Moving the window changes every row on the screen, unless pages
+     * can be moved with latch copies, in which case changes move too.
+     */
+    if (scr_x != old_x || scr_y != old_y) {
+	if (latch_copy) {
+	    shift_dirty (scr_x - old_x, scr_y - old_y);
+	} else {
+	    mark_rows_dirty (0, SCROLL_Y_DIM);
+	}
+    }
+
     /* Keep track of the new view window. */
     show_x = scr_x;
     show_y = scr_y;
 
+    /* With hardware scrolling, the screen must stay within video memory. */
+    if (hw_scroll) {
+        hw_place_window ();
+    }
+
     /*
      * If the new view window fits within the boundaries of the build 
      * buffer, we need move nothing around.
@@ -492,87 +768,951 @@ set_view_window (int scr_x, int scr_y)
 
 
 /*
- * show_screen
- *   DESCRIPTION: Show the logical view window on the video display.
- *   INPUTS: none
+ * show_screen
+ *   DESCRIPTION: Show the logical view window on the video display.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: copies from the build buffer to video memory (or to a
+ *                 frame snapshot for the present thread); shifts the VGA
+ *                 display source to point to the new image
+ */   
+void
+show_screen ()
+{
+    unsigned char* addr;  /* source address for copy             */
+    int p_off;            /* plane offset of first display plane */
+    int i;		  /* loop index over video planes        */
+    int page;		  /* index of target page                */
+    int y;		  /* start of run of dirty rows          */
+    int n;		  /* length of run of dirty rows         */
+    int off;		  /* offset of run within a plane        */
+    int store = -1;	  /* screen cache address to fill        */
+    const unsigned char* plane[4]; /* display planes in build buffer */
+
+    /* 
+     * Calculate offset of build buffer plane to be mapped into plane 0 
+     * of display, and the source address.
+     */
+    p_off = (3 - (show_x & 3));
+    addr = img3 + (show_x >> 2) + show_y * SCROLL_X_WIDTH;
+
+    /* Queue the frame for capture, if capturing. */
+    for (i = 0; i < 4; i++) {
+        plane[i] = addr + ((p_off - i + 4) & 3) * SCROLL_SIZE + (p_off < i);
+    }
+    capture_frame (plane);
+
+    /* Hand the frame to the present thread if there is one. */
+    if (present_threaded) {
+        publish_frame ();
+	return;
+    }
+
+    /* 
+     * With hardware scrolling, new lines are already in video memory
+     * unless the screen was just rebased; point the display at the view.
+     */
+    if (hw_scroll) {
+        if (hw_full) {
+	    hw_upload_rows (0, SCROLL_Y_DIM);
+	    hw_full = 0;
+	}
+	video->present (hw_base + show_y * HW_ROW_BYTES + (show_x >> 2),
+			show_x & 3);
+	vram_frame_done ();
+	return;
+    }
+
+    /* Switch to the other target screen in video memory. */
+    target_img ^= 0x4000;
+    page = (target_img >> 14) & 1;
+
+    /* 
+     * With latch copies, bring the page up to date from video memory as
+     * far as possible, then copy the columns that remain.
+     */
+    if (latch_copy) {
+        store = latch_prepare_page (page, addr, p_off);
+	upload_dirty_cols (page, addr, p_off);
+    }
+
+    /* 
+     * Draw each run of rows changed since this page was last written
+     * to each plane in the video memory.
+     */
+    for (y = 0; SCROLL_Y_DIM > y; y += n) {
+	for (n = 0; SCROLL_Y_DIM > y + n && row_dirty[page][y + n]; n++) {
+	    row_dirty[page][y + n] = 0;
+	}
+	if (0 == n) {
+	    n = 1;
+	    continue;
+	}
+	off = y * SCROLL_X_WIDTH;
+	for (i = 0; i < 4; i++) {
+	    video->write_plane (i, target_img + off, plane[i] + off,
+				n * SCROLL_X_WIDTH);
+	}
+	vram_frame += 4 * n * SCROLL_X_WIDTH;
+    }
+
+    /* Keep a page written in full in the screen cache. */
+    if (-1 != store) {
+        video->copy_vram (store, target_img, SCROLL_X_WIDTH, SCROLL_Y_DIM,
+			  SCROLL_X_WIDTH);
+	latch_bytes += SCROLL_SIZE;
+    }
+
+    /* 
+     * Point the top left of the screen to the video memory that we 
+     * just filled.
+     */
+    video->present (target_img, 0);
+    vram_frame_done ();
+}
+
+
+/*
+ * publish_frame
+ *   DESCRIPTION: Copy the rows of the logical view window that changed
+ *                since the back frame snapshot was last filled, along 
+ *                with any new status bar and palette, and hand the frame
+ *                to the present thread.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: swaps the back frame with the mailbox; wakes the present
+ *                 thread
+ */
+static void
+publish_frame ()
+{
+    frame_t* f;           /* frame to fill                       */
+    unsigned char* addr;  /* source address for copy             */
+    int p_off;            /* plane offset of first display plane */
+    int i;		  /* loop index over video planes        */
+    int y;		  /* start of run of changed rows        */
+    int n;		  /* length of run of changed rows       */
+    int off;		  /* offset of run within a plane        */
+    int old;		  /* previous mailbox contents           */
+
+    f = &frames[back_frame];
+    p_off = (3 - (show_x & 3));
+    addr = img3 + (show_x >> 2) + show_y * SCROLL_X_WIDTH;
+
+    /* Copy each run of rows that changed after the frame was filled. */
+    for (y = 0; SCROLL_Y_DIM > y; y += n) {
+	n = 0;
+	while (SCROLL_Y_DIM > y + n && row_seq[y + n] > f->seq) {
+	    n++;
+	}
+	if (0 == n) {
+	    n = 1;
+	    continue;
+	}
+	off = y * SCROLL_X_WIDTH;
+	for (i = 0; i < 4; i++) {
+	    (void)memcpy (f->img[i] + off, addr + off + 
+			  ((p_off - i + 4) & 3) * SCROLL_SIZE + (p_off < i),
+			  n * SCROLL_X_WIDTH);
+	}
+    }
+    (void)memcpy (f->row_seq, row_seq, sizeof (row_seq));
+    if (status_seq > f->seq) {
+	(void)memcpy (f->status, status_img, sizeof (status_img));
+    }
+    if (pal_seq > f->seq) {
+	(void)memcpy (f->pal, pal_img, sizeof (pal_img));
+    }
+    f->status_seq = status_seq;
+    f->pal_seq = pal_seq;
+    f->seq = cur_seq++;
+
+    /* Publish the frame and take back whichever frame was in the mailbox. */
+    old = __atomic_exchange_n (&mailbox, back_frame | FRAME_FRESH,
+			       __ATOMIC_ACQ_REL);
+    back_frame = old & ~FRAME_FRESH;
+    if (old & FRAME_FRESH) {
+	frames_dropped++;
+    }
+    (void)sem_post (&present_sem);
+}
+
+
+/*
+ * present_thread
+ *   DESCRIPTION: Thread that copies published frames into video memory.
+ *                Each frame goes to the page after the one displayed, and
+ *                only rows changed since that page was last written are
+ *                copied; then the display flips to the page.  When 
+ *                stopped, presents the newest frame (if not yet taken),
+ *                then returns.
+ *   INPUTS: arg -- ignored
+ *   OUTPUTS: none
+ *   RETURN VALUE: NULL
+ *   SIDE EFFECTS: writes to video memory and VGA registers
+ */
+static void*
+present_thread (void* arg)
+{
+    uint32_t page_seq[NUM_PAGES] = {0}; /* frame held by each page    */
+    uint32_t status_done = 0;	/* frame of status bar shown      */
+    uint32_t pal_done = 0;	/* frame of palette loaded        */
+    int page = 0;		/* page most recently written     */
+    frame_t* f;			/* frame being presented          */
+    int i;			/* loop index over video planes   */
+    int y;			/* start of run of changed rows   */
+    int n;			/* length of run of changed rows  */
+    int off;			/* offset of run within a plane   */
+    int stop;			/* 1 if asked to stop             */
+
+    trace_thread ("present");
+    while (1) {
+	(void)sem_wait (&present_sem);
+	stop = __atomic_load_n (&present_stop, __ATOMIC_ACQUIRE);
+
+	/* Several posts may cover one frame; skip those already taken. */
+	if (0 == (__atomic_load_n (&mailbox, __ATOMIC_ACQUIRE) & 
+		  FRAME_FRESH)) {
+	    if (stop) {
+		break;
+	    }
+	    continue;
+	}
+	front_frame = __atomic_exchange_n (&mailbox, front_frame, 
+					   __ATOMIC_ACQ_REL) & ~FRAME_FRESH;
+	f = &frames[front_frame];
+	TRACE_BEGIN (present_start);
+
+	/* The new colors must be in place before the new image shows. */
+	if (f->pal_seq > pal_done) {
+	    load_palette (0x40, f->pal, PALETTE_SIZE / 3);
+	    pal_done = f->pal_seq;
+	}
+	if (f->status_seq > status_done) {
+	    video->write_status_bar (f->status, 0, VIDEO_ROW_BYTES);
+	    vram_frame += 4 * VIDEO_STATUS_SIZE;
+	    status_done = f->status_seq;
+	}
+
+	if (NUM_PAGES == ++page) {
+	    page = 0;
+	}
+	for (y = 0; SCROLL_Y_DIM > y; y += n) {
+	    n = 0;
+	    while (SCROLL_Y_DIM > y + n && f->row_seq[y + n] > page_seq[page]) {
+		n++;
+	    }
+	    if (0 == n) {
+		n = 1;
+		continue;
+	    }
+	    off = y * SCROLL_X_WIDTH;
+	    for (i = 0; i < 4; i++) {
+		video->write_plane (i, PAGE_ADDR (page) + off, f->img[i] + off,
+				    n * SCROLL_X_WIDTH);
+	    }
+	    vram_frame += 4 * n * SCROLL_X_WIDTH;
+	}
+	page_seq[page] = f->seq;
+
+	video->present (PAGE_ADDR (page), 0);
+	vram_frame_done ();
+	frames_presented++;
+	TRACE_END ("present", NULL, present_start);
+	if (stop) {
+	    break;
+	}
+    }
+    return NULL;
+}
+
+
+/*
+ * stop_present_thread
+ *   DESCRIPTION: Stop the present thread, if it is running, and wait for
+ *                it to finish.  The thread first presents the newest 
+ *                frame, if not yet presented.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void
+stop_present_thread ()
+{
+    if (!present_threaded) {
+        return;
+    }
+    __atomic_store_n (&present_stop, 1, __ATOMIC_RELEASE);
+    (void)sem_post (&present_sem);
+    (void)pthread_join (present_thread_id, NULL);
+    (void)sem_destroy (&present_sem);
+    present_threaded = 0;
+}
+
+/*
+ * show_status_bar
+ *   DESCRIPTION: Show the status bar on the video display.  Only the
+ *                cells whose characters changed since the last call are
+ *                drawn and copied to video memory.
+ *   INPUTS: status_bar_input -- STATUS_BAR_CELLS characters
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: draws changed cells into status_img and video memory
+ */  
+
+void
+show_status_bar (const unsigned char* status_bar_input)
+{
+    int k;  /* start of run of changed cells */
+    int n;  /* length of run                 */
+
+    status_shows++;
+    for (k = 0; STATUS_BAR_CELLS > k; k += n) {
+	for (n = 0; STATUS_BAR_CELLS > k + n && (!status_text_valid ||
+	     status_text[k + n] != status_bar_input[k + n]); n++) {
+	}
+	if (0 == n) {
+	    n = 1;
+	    continue;
+	}
+	text2graphic (status_bar_input, status_img, k, n);
+	(void)memcpy (status_text + k, status_bar_input + k, n);
+	status_seq = cur_seq;
+	status_cells += n;
+
+	/* The present thread picks the image up with the next frame. */
+	if (!present_threaded) {
+	    video->write_status_bar (status_img, k * STATUS_CELL_BYTES, 
+				     n * STATUS_CELL_BYTES);
+	    vram_frame += 4 * VIDEO_STATUS_ROWS * n * STATUS_CELL_BYTES;
+	}
+    }
+    status_text_valid = 1;
+    if (status_seq == cur_seq) {
+	capture_status (status_img);
+    }
+}
+
+/*
+ * set_status_colors
+ *   DESCRIPTION: Change the status bar colors; if they change, the whole
+ *                bar is redrawn by the next call to show_status_bar.
+ *   INPUTS: fg -- font color
+ *           bg -- background color
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */  
+void
+set_status_colors (unsigned char fg, unsigned char bg)
+{
+    if (set_text_colors (fg, bg)) {
+	status_text_valid = 0;
+    }
+}
+
+/*
+ * clear_screens
+ *   DESCRIPTION: Fills the video memory with zeroes. 
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: fills all 256kB of VGA video memory with zeroes
+ */   
+void 
+clear_screens ()
+{
+    /* The present thread owns video memory; rewriting all rows will do. */
+    if (!present_threaded) {
+        video->clear ();
+    }
+
+    /* Both pages (or the hardware scrolling screen) must be rewritten. */
+    mark_rows_dirty (0, SCROLL_Y_DIM);
+    status_text_valid = 0;
+    hw_full = 1;
+    latch_reset ();
+}
+
+
+/*
+ * mark_rows_dirty
+ *   DESCRIPTION: Record that rows of the logical view window have changed
+ *                and must be copied to both video pages (or, with the 
+ *                present thread, changed in the frame being built).
+ *   INPUTS: first -- first row changed (0-based, within the window)
+ *           n -- number of rows changed
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void
+mark_rows_dirty (int first, int n)
+{
+    int i;  /* loop index over rows */
+
+    (void)memset (&row_dirty[0][first], 1, n);
+    (void)memset (&row_dirty[1][first], 1, n);
+    for (i = first; first + n > i; i++) {
+        row_seq[i] = cur_seq;
+    }
+}
+
+
+/*
+ * load_palette
+ *   DESCRIPTION: Load colors into the palette, writing only the runs of
+ *                colors that differ from those last loaded.
+ *   INPUTS: first -- first color to load
+ *           rgb -- 6-bit RGB values, three bytes per color
+ *           count -- number of colors to load
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: changes palette colors; updates the palette cache
+ */
+static void
+load_palette (int first, const unsigned char* rgb, int count)
+{
+    int i;  /* loop index over colors    */
+    int n;  /* length of run of changes  */
+
+    pal_loads++;
+    pal_bytes_asked += 3 * count;
+    for (i = 0; count > i; i += n) {
+	n = 0;
+	while (count > i + n && (!pal_cached[first + i + n] || 
+	       0 != memcmp (pal_cache[first + i + n], rgb + 3 * (i + n), 3))) {
+	    pal_cached[first + i + n] = 1;
+	    (void)memcpy (pal_cache[first + i + n], rgb + 3 * (i + n), 3);
+	    n++;
+	}
+	if (0 == n) {
+	    n = 1;
+	    continue;
+	}
+	video->load_palette (first + i, rgb + 3 * i, n);
+	pal_runs++;
+	pal_bytes += 3 * n;
+    }
+}
+
+
+/*
+ * shift_dirty
+ *   DESCRIPTION: Move the record of changed rows and columns with the 
+ *                logical view window (for latch copies).  Rows and columns
+ *                that come into view are marked as changed.
+ *   INPUTS: (dx,dy) -- distance moved by the view window
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void
+shift_dirty (int dx, int dy)
+{
+    int p;  /* loop index over pages          */
+    int i;  /* loop index over rows, columns */
+
+    for (p = 0; p < 2; p++) {
+	if (0 < dy) {
+	    for (i = 0; SCROLL_Y_DIM > i; i++) {
+		row_dirty[p][i] = (SCROLL_Y_DIM > i + dy ? 
+				   row_dirty[p][i + dy] : 1);
+	    }
+	} else if (0 > dy) {
+	    for (i = SCROLL_Y_DIM; i-- > 0; ) {
+		row_dirty[p][i] = (0 <= i + dy ? row_dirty[p][i + dy] : 1);
+	    }
+	}
+	if (0 < dx) {
+	    for (i = 0; SCROLL_X_DIM > i; i++) {
+		col_dirty[p][i] = (SCROLL_X_DIM > i + dx ? 
+				   col_dirty[p][i + dx] : 1);
+	    }
+	} else if (0 > dx) {
+	    for (i = SCROLL_X_DIM; i-- > 0; ) {
+		col_dirty[p][i] = (0 <= i + dx ? col_dirty[p][i + dx] : 1);
+	    }
+	}
+    }
+}
+
+
+/*
+ * latch_prepare_page
+ *   DESCRIPTION: Bring a page as close to the logical view window as 
+ *                latch copies allow before show_screen copies changed
+ *                rows and columns into it: move the part of the old view
+ *                that is still visible, or copy the whole view from the
+ *                screen cache.  Marks what remains to be copied.
+ *   INPUTS: page -- the page (0 or 1) to be written
+ *           addr -- address of the view in the build buffer
+ *           p_off -- build buffer plane of display plane 0
+ *   OUTPUTS: none
+ *   RETURN VALUE: address at which to cache the page once it has been
+ *                 written in full, or -1 if it need not be cached
+ *   SIDE EFFECTS: writes to video memory
+ */
+static int
+latch_prepare_page (int page, const unsigned char* addr, int p_off)
+{
+    int dx, dy;		/* view movement since page was written */
+    int bx;		/* horizontal movement in bytes          */
+    int x0, x1;		/* overlapping bytes in new view         */
+    int y0, y1;		/* overlapping rows in new view          */
+    int i;		/* loop index                            */
+    uint64_t hash;	/* hash of view contents                 */
+    int slot;		/* screen cache slot                     */
+    int addr_out = -1;	/* screen cache address to fill          */
+
+    dx = show_x - page_x[page];
+    dy = show_y - page_y[page];
+    if (page_valid[page] && 0 == dx && 0 == dy) {
+        return -1;
+    }
+    page_x[page] = show_x;
+    page_y[page] = show_y;
+
+    /* Move what is still visible, and mark what is newly exposed. */
+    if (page_valid[page] && 0 == (dx & 3) && SCROLL_X_DIM > abs (dx) &&
+	SCROLL_Y_DIM > abs (dy)) {
+	bx = dx / 4;
+	x0 = (0 > bx ? -bx : 0);
+	x1 = (0 < bx ? SCROLL_X_WIDTH - bx : SCROLL_X_WIDTH);
+	y0 = (0 > dy ? -dy : 0);
+	y1 = (0 < dy ? SCROLL_Y_DIM - dy : SCROLL_Y_DIM);
+	video->copy_vram (target_img + y0 * SCROLL_X_WIDTH + x0,
+			  target_img + (y0 + dy) * SCROLL_X_WIDTH + x0 + bx,
+			  x1 - x0, y1 - y0, SCROLL_X_WIDTH);
+	latch_bytes += (x1 - x0) * (y1 - y0);
+	latch_shifts++;
+	for (i = 0; SCROLL_Y_DIM > i; i++) {
+	    if (y0 > i || y1 <= i) {
+		row_dirty[page][i] = 1;
+	    }
+	}
+	for (i = 0; SCROLL_X_DIM > i; i++) {
+	    if (x0 > (i >> 2) || x1 <= (i >> 2)) {
+		col_dirty[page][i] = 1;
+	    }
+	}
+	return -1;
+    }
+
+    /* The page must be rewritten in full: try the screen cache. */
+    page_valid[page] = 1;
+    (void)memset (col_dirty[page], 0, SCROLL_X_DIM);
+    hash = view_hash (addr, p_off);
+    for (slot = 0; SCREEN_CACHE_SLOTS > slot; slot++) {
+	if (-1 != screen_slot[slot].addr && hash == screen_slot[slot].hash) {
+	    video->copy_vram (target_img, screen_slot[slot].addr, 
+			      SCROLL_X_WIDTH, SCROLL_Y_DIM, SCROLL_X_WIDTH);
+	    latch_bytes += SCROLL_SIZE;
+	    screen_slot[slot].last_use = vram_frames;
+	    (void)memset (row_dirty[page], 0, SCROLL_Y_DIM);
+	    cache_hits++;
+	    return -1;
+	}
+    }
+    cache_misses++;
+    (void)memset (row_dirty[page], 1, SCROLL_Y_DIM);
+
+    /* Find space for the screen, replacing the least recently used. */
+    for (slot = 0; SCREEN_CACHE_SLOTS > slot; slot++) {
+	if (-1 == screen_slot[slot].addr) {
+	    if (-1 == (screen_slot[slot].addr = vram_alloc (SCROLL_SIZE))) {
+	        continue;
+	    }
+	    break;
+	}
+    }
+    if (SCREEN_CACHE_SLOTS == slot) {
+	for (slot = -1, i = 0; SCREEN_CACHE_SLOTS > i; i++) {
+	    if (-1 != screen_slot[i].addr && (-1 == slot || 
+		screen_slot[slot].last_use > screen_slot[i].last_use)) {
+		slot = i;
+	    }
+	}
+    }
+    if (-1 != slot) {
+	screen_slot[slot].hash = hash;
+	screen_slot[slot].last_use = vram_frames;
+	addr_out = screen_slot[slot].addr;
+    }
+    return addr_out;
+}
+
+
+/*
+ * upload_dirty_cols
+ *   DESCRIPTION: Copy the changed columns of the logical view window into
+ *                a page, in rows that are not about to be copied whole.
+ *                Columns are copied in groups of four pixels (one byte in
+ *                each plane).
+ *   INPUTS: page -- the page (0 or 1) being written
+ *           addr -- address of the view in the build buffer
+ *           p_off -- build buffer plane of display plane 0
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: writes to video memory; clears the column marks
+ */
+static void
+upload_dirty_cols (int page, const unsigned char* addr, int p_off)
+{
+    unsigned char need[SCROLL_X_WIDTH]; /* 1 if byte column changed */
+    int b;	/* start of run of changed byte columns */
+    int n;	/* length of run                        */
+    int i;	/* loop index over video planes         */
+    int y;	/* loop index over rows                 */
+    int off;	/* offset of run within a plane         */
+
+    for (b = 0; SCROLL_X_WIDTH > b; b++) {
+	need[b] = (col_dirty[page][4 * b] | col_dirty[page][4 * b + 1] |
+		   col_dirty[page][4 * b + 2] | col_dirty[page][4 * b + 3]);
+    }
+    (void)memset (col_dirty[page], 0, SCROLL_X_DIM);
+    for (b = 0; SCROLL_X_WIDTH > b; b += n) {
+	for (n = 0; SCROLL_X_WIDTH > b + n && need[b + n]; n++) {
+	}
+	if (0 == n) {
+	    n = 1;
+	    continue;
+	}
+	for (i = 0; i < 4; i++) {
+	    for (y = 0; SCROLL_Y_DIM > y; y++) {
+		if (row_dirty[page][y]) {
+		    continue;
+		}
+		off = y * SCROLL_X_WIDTH + b;
+		video->write_plane (i, target_img + off, addr + off + 
+				    ((p_off - i + 4) & 3) * SCROLL_SIZE + 
+				    (p_off < i), n);
+		vram_frame += n;
+	    }
+	}
+    }
+}
+
+
+/*
+ * view_hash
+ *   DESCRIPTION: Hash the contents of the logical view window (64-bit
+ *                FNV-1a over the four display planes).
+ *   INPUTS: addr -- address of the view in the build buffer
+ *           p_off -- build buffer plane of display plane 0
+ *   OUTPUTS: none
+ *   RETURN VALUE: the hash
+ *   SIDE EFFECTS: none
+ */
+static uint64_t
+view_hash (const unsigned char* addr, int p_off)
+{
+    uint64_t hash = 0xCBF29CE484222325ULL; /* FNV offset basis */
+    const unsigned char* src;	/* plane image in build buffer */
+    int i;			/* loop index over planes      */
+    int j;			/* loop index over bytes       */
+
+    for (i = 0; i < 4; i++) {
+	src = addr + ((p_off - i + 4) & 3) * SCROLL_SIZE + (p_off < i);
+	for (j = 0; SCROLL_SIZE > j; j++) {
+	    hash = (hash ^ src[j]) * 0x100000001B3ULL;
+	}
+    }
+    return hash;
+}
+
+
+/*
+ * latch_reset
+ *   DESCRIPTION: Forget the views held by the pages and the screen cache,
+ *                e.g., after video memory is cleared.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: frees the screen cache's video memory
+ */
+static void
+latch_reset ()
+{
+    int i;  /* loop index over cache slots */
+
+    page_valid[0] = page_valid[1] = 0;
+    for (i = 0; SCREEN_CACHE_SLOTS > i; i++) {
+	vram_free (screen_slot[i].addr);
+        screen_slot[i].addr = -1;
+    }
+}
+
+
+/*
+ * vram_alloc_init
+ *   DESCRIPTION: Make a range of video memory addresses available to
+ *                vram_alloc, forgetting all earlier allocations.
+ *   INPUTS: lo -- first address available
+ *           hi -- one past the last address available
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void
+vram_alloc_init (int lo, int hi)
+{
+    vram_block[0].addr = lo;
+    vram_block[0].len = hi - lo;
+    vram_block[0].used = 0;
+    vram_nblocks = 1;
+}
+
+
+/*
+ * vram_alloc
+ *   DESCRIPTION: Allocate a block of offscreen video memory (the same
+ *                addresses in all four planes), first fit.
+ *   INPUTS: len -- bytes needed in each plane
+ *   OUTPUTS: none
+ *   RETURN VALUE: address of the block, or -1 if there is no room
+ *   SIDE EFFECTS: none
+ */
+static int
+vram_alloc (int len)
+{
+    int i;  /* loop index over blocks */
+
+    for (i = 0; vram_nblocks > i; i++) {
+	if (vram_block[i].used || len > vram_block[i].len) {
+	    continue;
+	}
+
+	/* Split off the rest of the block if there is room to record it. */
+	if (len < vram_block[i].len && VRAM_BLOCKS > vram_nblocks) {
+	    (void)memmove (&vram_block[i + 1], &vram_block[i],
+			   (vram_nblocks - i) * sizeof (vram_block[0]));
+	    vram_nblocks++;
+	    vram_block[i + 1].addr += len;
+	    vram_block[i + 1].len -= len;
+	    vram_block[i].len = len;
+	}
+	vram_block[i].used = 1;
+	return vram_block[i].addr;
+    }
+    return -1;
+}
+
+
+/*
+ * vram_free
+ *   DESCRIPTION: Return a block allocated by vram_alloc, merging it with
+ *                free neighbors.
+ *   INPUTS: addr -- address of the block
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void
+vram_free (int addr)
+{
+    int i;  /* loop index over blocks */
+
+    for (i = 0; vram_nblocks > i && addr != vram_block[i].addr; i++) {
+    }
+    if (vram_nblocks == i) {
+        return;
+    }
+    vram_block[i].used = 0;
+    if (vram_nblocks > i + 1 && !vram_block[i + 1].used) {
+	vram_block[i].len += vram_block[i + 1].len;
+	(void)memmove (&vram_block[i + 1], &vram_block[i + 2],
+		       (vram_nblocks - i - 2) * sizeof (vram_block[0]));
+	vram_nblocks--;
+    }
+    if (0 < i && !vram_block[i - 1].used) {
+	vram_block[i - 1].len += vram_block[i].len;
+	(void)memmove (&vram_block[i], &vram_block[i + 1],
+		       (vram_nblocks - i - 1) * sizeof (vram_block[0]));
+	vram_nblocks--;
+    }
+}
+
+
+/*
+ * vram_frame_done
+ *   DESCRIPTION: Close out the count of bytes written to video memory for
+ *                a frame that has just been presented.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void
+vram_frame_done ()
+{
+    if (vram_max < vram_frame) {
+        vram_max = vram_frame;
+    }
+    vram_total += vram_frame;
+    vram_last = vram_frame;
+    vram_frames++;
+    vram_frame = 0;
+}
+
+
+/*
+ * hw_place_window
+ *   DESCRIPTION: For hardware scrolling, check that the logical view window
+ *                lies between the status bar and the end of video memory;
+ *                if not, move the map so that the view is centered in that
+ *                space and the whole screen is copied by show_screen.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: may change hw_base and set hw_full
+ */
+static void
+hw_place_window ()
+{
+    int start;	/* address of upper left pixel of view */
+
+    start = hw_base + show_y * HW_ROW_BYTES + (show_x >> 2);
+    if (!hw_full && HW_STATUS_SIZE <= start && 
+        MODE_X_MEM_SIZE >= start + HW_SCREEN_SPAN) {
+        return;
+    }
+    if (!hw_full) {
+        hw_rebases++;
+    }
+    start = HW_STATUS_SIZE + 
+	    (MODE_X_MEM_SIZE - HW_STATUS_SIZE - HW_SCREEN_SPAN) / 2;
+    hw_base = start - show_y * HW_ROW_BYTES - (show_x >> 2);
+    hw_full = 1;
+}
+
+
+/*
+ * hw_upload_rows
+ *   DESCRIPTION: For hardware scrolling, copy rows of the logical view 
+ *                window from the build buffer to video memory.
+ *   INPUTS: first -- first row to copy (0-based, within the window)
+ *           n -- number of rows to copy
  *   OUTPUTS: none
  *   RETURN VALUE: none
- *   SIDE EFFECTS: copies from the build buffer to video memory;
- *                 shifts the VGA display source to point to the new image
- */   
-void
-show_screen ()
+ *   SIDE EFFECTS: writes to video memory
+ */
+static void
+hw_upload_rows (int first, int n)
 {
-    unsigned char* addr;  /* source address for copy             */
-    int p_off;            /* plane offset of first display plane */
-    int i;		  /* loop index over video planes        */
+    int q;	/* map plane (x & 3) of the pixels copied         */
+    int bx;	/* map x >> 2 of the first pixel in plane q       */
+    int y;	/* loop index over map rows                       */
 
     /* 
-     * Calculate offset of build buffer plane to be mapped into plane 0 
-     * of display.
+     * The build buffer keeps map plane q in its plane 3 - q; go one plane
+     * at a time so that the write mask changes only four times.
      */
-    p_off = (3 - (show_x & 3));
-
-    /* Switch to the other target screen in video memory. */
-    target_img ^= 0x4000;
+    for (q = 0; q < 4; q++) {
+	bx = (show_x + ((q - show_x) & 3)) >> 2;
+	for (y = show_y + first; show_y + first + n > y; y++) {
+	    video->write_plane (q, hw_base + y * HW_ROW_BYTES + bx,
+				img3 + (3 - q) * SCROLL_SIZE + 
+				y * SCROLL_X_WIDTH + bx, SCROLL_X_WIDTH);
+	}
+    }
+    vram_frame += 4 * n * SCROLL_X_WIDTH;
+}
 
-    /* Calculate the source address. */
-    addr = img3 + (show_x >> 2) + show_y * SCROLL_X_WIDTH;
 
-    /* Draw to each plane in the video memory. */
-    for (i = 0; i < 4; i++) {
-	SET_WRITE_MASK (1 << (i + 8));
-	copy_image (addr + ((p_off - i + 4) & 3) * SCROLL_SIZE + (p_off < i), 
-	            target_img);
+/*
+ * vram_report
+ *   DESCRIPTION: Print the number of bytes written to video memory per 
+ *                frame, if any frames were shown, and the number of 
+ *                palette bytes written.
+ *   INPUTS: f -- output stream
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void
+vram_report (FILE* f)
+{
+    if (0 == vram_frames) {
+        return;
+    }
+    fprintf (f, "video memory: %u frames, %.0f bytes/frame (max %u)\n",
+	     vram_frames, (double)vram_total / vram_frames, vram_max);
+    if (hw_scroll) {
+        fprintf (f, "hardware scrolling: %u rebases\n", hw_rebases);
+    }
+    if (latch_copy) {
+        fprintf (f, "latch copies: %u shifts, %u of %u screens cached, "
+		 "%u bytes copied\n", latch_shifts, cache_hits, 
+		 cache_hits + cache_misses, latch_bytes);
+    }
+    if (0 < status_shows) {
+        fprintf (f, "status bar: %.1f of %d cells drawn per update\n",
+		 (double)status_cells / status_shows, STATUS_BAR_CELLS);
+    }
+    if (0 < pal_loads) {
+        fprintf (f, "palette: %u loads, %u of %u bytes written in %u runs\n",
+		 pal_loads, pal_bytes, pal_bytes_asked, pal_runs);
+    }
+    if (frames_presented > 0) {
+        fprintf (f, "present thread: %u frames presented, %u dropped\n",
+		 frames_presented, frames_dropped);
     }
-
-    /* 
-     * Change the VGA registers to point the top left of the screen
-     * to the video memory that we just filled.
-     */
-    OUTW (0x03D4, (target_img & 0xFF00) | 0x0C);
-    OUTW (0x03D4, ((target_img & 0x00FF) << 8) | 0x0D);
 }
 
+
 /*
- * show_status_bar
- *   DESCRIPTION: Show the status bar on the video display.
- *   INPUTS: char* status_bar_input
+ * retrace_report
+ *   DESCRIPTION: Print statistics on waiting for vertical retrace before 
+ *                page flips, if any waits were made: the mean and maximum
+ *                wait, retraces missed (in total and per second), waits
+ *                skipped, and a histogram of wait times in milliseconds.
+ *   INPUTS: f -- output stream
  *   OUTPUTS: none
  *   RETURN VALUE: none
- *   SIDE EFFECTS: copies from the status_bar_buf to video memory;
- */  
-
+ *   SIDE EFFECTS: none
+ */
 void
-show_status_bar (unsigned char* status_bar_input, unsigned char* status_bar_buf)
+retrace_report (FILE* f)
 {
-    int i = 0;		  /* loop index over video planes        */
-    text2graphic(status_bar_input, status_bar_buf);
-    /* Draw to each plane in the video memory. */
-    for (i = 0; i < 4; i++) {
-	SET_WRITE_MASK (1 << (i + 8));
-	copy_status_bar (status_bar_buf + i * oneplane1440, 
-	            0x0000);
-    }
+    double secs;  /* time from first to last flip */
+    int i;	  /* loop index over histogram    */
 
+    if (0 == vsync_waits + vsync_missed) {
+        return;
+    }
+    secs = (vsync_last.tv_sec - vsync_first.tv_sec) + 
+	   (vsync_last.tv_nsec - vsync_first.tv_nsec) / 1e9;
+    fprintf (f, "retrace: %u waits, %.0f us/wait (max %.0f), %u missed "
+	     "(%.2f/s), %u skipped\n", vsync_waits, 
+	     (0 == vsync_waits ? 0 : vsync_wait_total / vsync_waits),
+	     vsync_wait_max, vsync_missed, 
+	     (0 < secs ? vsync_missed / secs : 0), vsync_skipped);
+    fprintf (f, "retrace wait ms:");
+    for (i = 0; VSYNC_HIST_BUCKETS > i; i++) {
+	fprintf (f, " %d%s:%u", i, (VSYNC_HIST_BUCKETS - 1 == i ? "+" : ""),
+		 vsync_hist[i]);
+    }
+    fputc ('\n', f);
 }
 
+
 /*
- * clear_screens
- *   DESCRIPTION: Fills the video memory with zeroes. 
+ * vram_bytes_last_frame
+ *   DESCRIPTION: Get the number of bytes written to video memory in the
+ *                last complete frame (screen and status bar).
  *   INPUTS: none
  *   OUTPUTS: none
- *   RETURN VALUE: none
- *   SIDE EFFECTS: fills all 256kB of VGA video memory with zeroes
- */   
-void 
-clear_screens ()
+ *   RETURN VALUE: bytes written
+ *   SIDE EFFECTS: none
+ */
+uint32_t
+vram_bytes_last_frame ()
 {
-    /* Write to all four planes at once. */ 
-    SET_WRITE_MASK (0x0F00);
-
-    /* Set 64kB to zero (times four planes = 256kB). */
-    memset (mem_image, 0, MODE_X_MEM_SIZE);
+    return vram_last;
 }
 
 
@@ -614,6 +1754,13 @@ draw_vert_line (int x)
         return -1;
     } 
 
+    /* A column crosses every row, unless columns are tracked. */
+    if (latch_copy) {
+        col_dirty[0][x] = col_dirty[1][x] = 1;
+    } else {
+	mark_rows_dirty (0, SCROLL_Y_DIM);
+    }
+
     /* adjust x to the show plane mode */
     x = x + show_x;
 
@@ -635,6 +1782,12 @@ draw_vert_line (int x)
         /* Go to the address of the second line */
         addr += IMAGE_X_WIDTH;
     }
+
+    /* With hardware scrolling, copy the column as soon as it is drawn. */
+    if (hw_scroll && !hw_full) {
+        hw_upload_col (x);
+    }
+
     /* Return success. */
     return 0;
 }
@@ -666,6 +1819,9 @@ draw_horiz_line (int y)
     if (y < 0 || y >= SCROLL_Y_DIM)
 	return -1;
 
+    /* Record the change for both video pages. */
+    mark_rows_dirty (y, 1);
+
     /* Adjust y to the logical row value. */
     y += show_y;
 
@@ -687,10 +1843,39 @@ draw_horiz_line (int y)
 	}
     }
 
+    /* With hardware scrolling, copy the row as soon as it is drawn. */
+    if (hw_scroll && !hw_full) {
+        hw_upload_rows (y - show_y, 1);
+    }
+
     /* Return success. */
     return 0;
 }
 
+
+/*
+ * hw_upload_col
+ *   DESCRIPTION: For hardware scrolling, copy a column of the logical view
+ *                window from the build buffer to video memory.
+ *   INPUTS: x -- map x coordinate of the column
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: writes to video memory
+ */
+static void
+hw_upload_col (int x)
+{
+    unsigned char* addr;  /* address of column pixel in build buffer */
+    int y;		  /* loop index over map rows                */
+
+    addr = img3 + (3 - (x & 3)) * SCROLL_SIZE + (x >> 2);
+    for (y = show_y; show_y + SCROLL_Y_DIM > y; y++) {
+	video->write_plane (x & 3, hw_base + y * HW_ROW_BYTES + (x >> 2),
+			    addr + y * SCROLL_X_WIDTH, 1);
+    }
+    vram_frame += SCROLL_Y_DIM;
+}
+
 #endif /* !defined(TEXT_RESTORE_PROGRAM) */
 
 
@@ -750,21 +1935,10 @@ VGA_blank (int blank_bit)
      */
     blank_bit = ((blank_bit & 1) << 5);
 
-    asm volatile (
-	"movb $0x01,%%al         /* Set sequencer index to 1. */       ;"
-	"movw $0x03C4,%%dx                                             ;"
-	"outb %%al,(%%dx)                                              ;"
-	"incw %%dx                                                     ;"
-	"inb (%%dx),%%al         /* Read old value.           */       ;"
-	"andb $0xDF,%%al         /* Calculate new value.      */       ;"
-	"orl %0,%%eax                                                  ;"
-	"outb %%al,(%%dx)        /* Write new value.          */       ;"
-	"movw $0x03DA,%%dx       /* Enable display (0x20->P[0x3C0]) */ ;"
-	"inb (%%dx),%%al         /* Set attr reg state to index. */    ;"
-	"movw $0x03C0,%%dx       /* Write index 0x20 to enable. */     ;"
-	"movb $0x20,%%al                                               ;"
-	"outb %%al,(%%dx)                                               "
-      : : "g" (blank_bit) : "eax", "edx", "memory");
+    OUTB (0x03C4, 0x01);			/* Set sequencer index to 1. */
+    OUTB (0x03C5, (port_inb (0x03C5) & 0xDF) | blank_bit); /* new value */
+    (void)port_inb (0x03DA);			/* Set attr reg state to index. */
+    OUTB (0x03C0, 0x20);			/* Write index 0x20 to enable. */
 }
 
 
@@ -832,9 +2006,7 @@ static void
 set_attr_registers (unsigned char table[NUM_ATTR_REGS * 2])
 {
     /* Reset attribute register to write index next rather than data. */
-    asm volatile (
-	"inb (%%dx),%%al"
-      : : "d" (0x03DA) : "eax", "memory");
+    (void)port_inb (0x03DA);
     REP_OUTSB (0x03C0, table, NUM_ATTR_REGS * 2);
 }
 
@@ -903,11 +2075,9 @@ fill_palette_mode_x ()
 	{0x3F, 0x3F, 0x2A}, {0x3F, 0x3F, 0x3F}
     };
 
-    /* Start writing at color 0. */
-    OUTB (0x03C8, 0x00);
-
-    /* Write all 64 colors from array. */
-    REP_OUTSB (0x03C9, palette_RGB, 64 * 3);
+    /* Write all 64 colors from array, starting at color 0. */
+    load_palette (0x00, &palette_RGB[0][0], 64);
+    capture_palette (0x00, &palette_RGB[0][0], 64);
 }
 
 /*
@@ -921,11 +2091,17 @@ fill_palette_mode_x ()
  */  
 void
 fill_my_palette(const void* pale){
-    /* Starting writing at 64th color */
-    OUTB(0x03C8,0x40);
+    capture_palette (0x40, pale, 192);
 
-    /* Write all 192 colors from array */
-    REP_OUTSB (0x03C9,pale,192 * 3);
+    /* The present thread loads the colors along with the next frame. */
+    if (present_threaded) {
+	(void)memcpy (pal_img, pale, sizeof (pal_img));
+	pal_seq = cur_seq;
+	return;
+    }
+
+    /* Write all 192 colors from array, starting at 64th color */
+    load_palette (0x40, pale, 192);
 }
 
 
@@ -965,7 +2141,7 @@ fill_palette_text ()
     OUTB (0x03C8, 0x00);
 
     /* Write all 32 colors from array. */
-    REP_OUTSB (0x03C9, palette_RGB, 32 * 3);
+    REP_OUTSB (0x03C9, &palette_RGB[0][0], 32 * 3);
 }
 
 
@@ -1019,7 +2195,7 @@ write_font_data ()
 static void
 set_text_mode_3 (int clear_scr)
 {
-    unsigned long* txt_scr; /* pointer to text screens in video memory */
+    uint32_t* txt_scr;      /* pointer to text screens in video memory */
     int i;                  /* loop over text screen words             */
 
     VGA_blank (1);                               /* blank the screen        */
@@ -1034,7 +2210,7 @@ set_text_mode_3 (int clear_scr)
     set_graphics_registers (text_graphics);      /* graphics registers      */
     fill_palette_text ();			 /* palette colors          */
     if (clear_scr) {				 /* clear screens if needed */
-	txt_scr = (unsigned long*)(mem_image + 0x18000); 
+	txt_scr = (uint32_t*)(mem_image + 0x18000); 
 	for (i = 0; i < 8192; i++)
 	    *txt_scr++ = 0x07200720;
     }
@@ -1045,58 +2221,370 @@ set_text_mode_3 (int clear_scr)
 
 /*
  * copy_image
- *   DESCRIPTION: Copy one plane of a screen from the build buffer to the 
- *                video memory.
- *   INPUTS: img -- a pointer to a single screen plane in the build buffer
+ *   DESCRIPTION: Copy one plane of a screen (or of the status bar) from 
+ *                memory to the video memory with the selected copy kernel.
+ *   INPUTS: img -- a pointer to a single screen plane in memory
  *           scr_addr -- the destination offset in video memory
+ *           len -- number of bytes to copy
  *   OUTPUTS: none
  *   RETURN VALUE: none
- *   SIDE EFFECTS: copies a plane from the build buffer to video memory
+ *   SIDE EFFECTS: copies a plane from memory to video memory
  */   
 static void
-copy_image (unsigned char* img, unsigned short scr_addr)
+copy_image (const unsigned char* img, unsigned short scr_addr, int len)
+{
+    copy_kernel->copy (mem_image + scr_addr, img, len);
+}
+
+
+/*
+ * vga_open
+ *   DESCRIPTION: Open the VGA backend: map video memory and obtain 
+ *                permission to access VGA ports.  The port I/O mode is
+ *                taken from ADVENTURE_PORT.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on failure
+ *   SIDE EFFECTS: prints an error message to stdout on failure
+ */   
+static int
+vga_open ()
 {
     /* 
-     * memcpy is actually probably good enough here, and is usually
-     * implemented using ISA-specific features like those below,
-     * but the code here provides an example of x86 string moves
+     * With mock port I/O, nothing touches the hardware, so video memory
+     * is ordinary memory as well.
      */
-    asm volatile (
-        "cld                                                 ;"
-       	"movl $16000,%%ecx                                   ;"
-       	"rep movsb    # copy ECX bytes from M[ESI] to M[EDI]  "
-      : /* no outputs */
-      : "S" (img), "D" (mem_image + scr_addr) 
-      : "eax", "ecx", "memory"
-    );
+    port_init (port_mode_from_env ());
+    if (PORT_MOCK == port_mode ()) {
+        return (NULL == (mem_image = calloc (1, VID_MEM_SIZE)) ? -1 : 0);
+    }
+    return open_memory_and_ports ();
 }
 
+
 /*
- * copy_status_bar
- *   DESCRIPTION: Copy one plane of a screen from the status bar buffer to the 
- *                video memory.
- *   INPUTS: img -- a pointer to a single screen plane in the build buffer
- *           scr_addr -- the destination offset in video memory
+ * vga_close
+ *   DESCRIPTION: Close the VGA backend: unmap video memory.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: unmaps video memory
+ */   
+static void
+vga_close ()
+{
+    if (PORT_MOCK == port_mode ()) {
+	free (mem_image);
+    } else {
+	(void)munmap (mem_image, VID_MEM_SIZE);
+    }
+}
+
+
+/*
+ * vga_set_mode
+ *   DESCRIPTION: Put the VGA into mode X (clearing video memory) or into
+ *                text mode 3 (clearing the screens and restoring fonts).
+ *   INPUTS: mode -- the mode to set
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: reprograms the VGA
+ */   
+static void
+vga_set_mode (video_mode_t mode)
+{
+    /* The sequencer reset and new register tables end any shadowing. */
+    port_invalidate ();
+    vga_row_bytes = VIDEO_ROW_BYTES;
+    vga_pan = 0;
+
+    if (VIDEO_MODE_TEXT == mode) {
+	set_text_mode_3 (1);
+        return;
+    }
+
+    /* 
+     * The code below was produced by recording a call to set mode 0013h
+     * with display memory clearing and a windowed frame buffer, then
+     * modifying the code to set mode X instead.  The code was then
+     * generalized into functions...
+     *
+     * modifications from mode 13h to mode X include...
+     *   Sequencer Memory Mode Register: 0x0E to 0x06 (0x3C4/0x04)
+     *   Underline Location Register   : 0x40 to 0x00 (0x3D4/0x14)
+     *   CRTC Mode Control Register    : 0xA3 to 0xE3 (0x3D4/0x17)
+     */
+
+    VGA_blank (1);                               /* blank the screen      */
+    set_seq_regs_and_reset (mode_X_seq, 0x63);   /* sequencer registers   */
+    set_CRTC_registers (mode_X_CRTC);            /* CRT control registers */
+    set_attr_registers (mode_X_attr);            /* attribute registers   */
+    set_graphics_registers (mode_X_graphics);    /* graphics registers    */
+    copy_select (mem_image + VIDEO_STATUS_SIZE, SCROLL_SIZE); /* time copies */
+    vga_clear ();				 /* zero video memory     */
+    VGA_blank (0);			         /* unblank the screen    */
+}
+
+
+/*
+ * vga_clear
+ *   DESCRIPTION: Fills the video memory with zeroes. 
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: fills all 256kB of VGA video memory with zeroes
+ */   
+static void
+vga_clear ()
+{
+    /* Write to all four planes at once. */ 
+    SET_WRITE_MASK (0x0F00);
+
+    /* Set 64kB to zero (times four planes = 256kB). */
+    memset (mem_image, 0, MODE_X_MEM_SIZE);
+}
+
+
+/*
+ * vga_write_plane
+ *   DESCRIPTION: Copy data into one plane of video memory.
+ *   INPUTS: plane -- the plane (0-3) to write
+ *           addr -- the destination offset in video memory
+ *           src -- the data to copy
+ *           len -- number of bytes to copy
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: changes the VGA write mask
+ */   
+static void
+vga_write_plane (int plane, uint16_t addr, const unsigned char* src, int len)
+{
+    SET_WRITE_MASK (1 << (plane + 8));
+    copy_image (src, addr, len);
+}
+
+
+/*
+ * vga_present
+ *   DESCRIPTION: Change the VGA registers to point the top left of the 
+ *                screen to the given video memory address, shifted left
+ *                by the given number of pixels.
+ *   INPUTS: start -- video memory address of the screen image
+ *           pan -- pixels (0-3) to shift the image left
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: changes the displayed image; ends a frame for port
+ *                 write counting; may wait for vertical retrace
+ */   
+static void
+vga_present (uint16_t start, int pan)
+{
+    OUTW (0x03D4, (start & 0xFF00) | 0x0C);
+    OUTW (0x03D4, ((start & 0x00FF) << 8) | 0x0D);
+
+    /* Wait for the flip to happen, unless a newer frame is waiting. */
+    if (vsync) {
+	if (present_threaded && 
+	    (__atomic_load_n (&mailbox, __ATOMIC_ACQUIRE) & FRAME_FRESH)) {
+	    vsync_skipped++;
+	} else {
+	    vga_wait_retrace ();
+	}
+    }
+
+    /* 
+     * The pixel panning register counts half pixels in 256-color modes.
+     * The attribute port cannot be shadowed, so skip unchanged values here.
+     */
+    if (pan != vga_pan) {
+        vga_set_attr (0x13, pan * 2);
+	vga_pan = pan;
+    }
+    port_frame_end ();
+}
+
+
+/*
+ * vga_wait_retrace
+ *   DESCRIPTION: Wait for the start of the next vertical retrace (the 
+ *                rising edge of bit 3 of the input status register), for
+ *                at most VSYNC_MAX_WAIT_USEC, and record the wait.
+ *   INPUTS: none
  *   OUTPUTS: none
  *   RETURN VALUE: none
- *   SIDE EFFECTS: copies a plane from the status bar buffer to video memory
+ *   SIDE EFFECTS: reads the input status register, which also resets the
+ *                 attribute controller to expect an index
  */   
 static void
-copy_status_bar (unsigned char* img, unsigned short scr_addr)
+vga_wait_retrace ()
 {
+    struct timespec now;   /* current time                       */
+    double usec = 0;	   /* time waited so far                 */
+    int in_retrace = 1;	   /* 1 until a non-retrace state is seen */
+
+    (void)clock_gettime (CLOCK_MONOTONIC, &vsync_last);
+    if (0 == vsync_waits + vsync_missed) {
+        vsync_first = vsync_last;
+    }
+
+    /* A retrace already under way is too late; wait for the next one. */
+    while (VSYNC_MAX_WAIT_USEC > usec) {
+	if (port_inb (0x03DA) & 0x08) {
+	    if (!in_retrace) {
+		break;
+	    }
+	} else {
+	    in_retrace = 0;
+	}
+	(void)clock_gettime (CLOCK_MONOTONIC, &now);
+	usec = (now.tv_sec - vsync_last.tv_sec) * 1e6 + 
+	       (now.tv_nsec - vsync_last.tv_nsec) / 1e3;
+    }
+    if (VSYNC_MAX_WAIT_USEC <= usec) {
+	vsync_missed++;
+	return;
+    }
+    vsync_waits++;
+    vsync_wait_total += usec;
+    if (vsync_wait_max < usec) {
+        vsync_wait_max = usec;
+    }
+    vsync_hist[usec >= (VSYNC_HIST_BUCKETS - 1) * 1000 ? 
+	       VSYNC_HIST_BUCKETS - 1 : (int)(usec / 1000)]++;
+}
+
+
+/*
+ * vga_set_row_bytes
+ *   DESCRIPTION: Set the distance between display rows in video memory
+ *                (the CRTC offset register, in words).  Wider rows are
+ *                for hardware scrolling, so the part of the screen below
+ *                the line compare split (the status bar) is also set to
+ *                ignore pixel panning.
+ *   INPUTS: row_bytes -- bytes per row in each plane (even)
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: changes the VGA display layout
+ */   
+static void
+vga_set_row_bytes (int row_bytes)
+{
+    OUTW (0x03D4, ((row_bytes >> 1) << 8) | 0x13);
+    vga_set_attr (0x10, (VIDEO_ROW_BYTES == row_bytes ? 0x41 : 0x61));
+    vga_row_bytes = row_bytes;
+}
+
+
+/*
+ * vga_set_attr
+ *   DESCRIPTION: Write one VGA attribute register, leaving the display
+ *                enabled.
+ *   INPUTS: index -- attribute register index
+ *           val -- value to write
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */   
+static void
+vga_set_attr (int index, int val)
+{
+    (void)port_inb (0x03DA);		/* Set attr reg state to index. */
+    OUTB (0x03C0, index | 0x20);	/* 0x20 keeps the display on.   */
+    OUTB (0x03C0, val);
+}
+
+
+/*
+ * vga_copy_vram
+ *   DESCRIPTION: Copy a rectangle of video memory in all four planes at 
+ *                once using write mode 1, in which each read loads the
+ *                VGA latches and each write stores them.  Overlapping
+ *                rectangles are copied in the safe direction.
+ *   INPUTS: dst -- video memory address of destination rectangle
+ *           src -- video memory address of source rectangle
+ *           width -- bytes per row in each plane
+ *           height -- number of rows
+ *           stride -- distance between rows in bytes
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: changes the VGA write mask
+ */   
+static void
+vga_copy_vram (uint16_t dst, uint16_t src, int width, int height, int stride)
+{
+    volatile unsigned char* vmem = mem_image; /* reads must not be elided */
+    int x, y;	/* loop indices over rectangle */
+
+    SET_WRITE_MASK (0x0F00);
+    OUTW (0x03CE, 0x4105);
+    if (dst <= src) {
+	for (y = 0; height > y; y++) {
+	    for (x = 0; width > x; x++) {
+		vmem[dst + y * stride + x] = vmem[src + y * stride + x];
+	    }
+	}
+    } else {
+	for (y = height; y-- > 0; ) {
+	    for (x = width; x-- > 0; ) {
+		vmem[dst + y * stride + x] = vmem[src + y * stride + x];
+	    }
+	}
+    }
+    OUTW (0x03CE, 0x4005);
+}
+
+
+/*
+ * vga_load_palette
+ *   DESCRIPTION: Write colors into the VGA palette.
+ *   INPUTS: first -- first color to write
+ *           rgb -- 6-bit RGB values, three bytes per color
+ *           count -- number of colors to write
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: changes palette colors
+ */   
+static void
+vga_load_palette (int first, const unsigned char* rgb, int count)
+{
+    OUTB (0x03C8, first);
+    REP_OUTSB (0x03C9, rgb, count * 3);
+}
+
+
+/*
+ * vga_write_status_bar
+ *   DESCRIPTION: Copy columns of the four planes of the status bar image
+ *                to the start of video memory.
+ *   INPUTS: img -- status bar image, one plane after another
+ *           x -- first byte of each row to copy
+ *           width -- bytes of each row to copy
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: changes the VGA write mask
+ */   
+static void
+vga_write_status_bar (const unsigned char* img, int x, int width)
+{
+    int i;  /* loop index over video planes    */
+    int y;  /* loop index over status bar rows */
+
     /* 
-     * memcpy is actually probably good enough here, and is usually
-     * implemented using ISA-specific features like those below,
-     * but the code here provides an example of x86 string moves
+     * Go from plane 3 down to plane 0: show_screen leaves the write mask
+     * on plane 3 and starts with plane 0, so both mask changes merge.
      */
-    asm volatile (
-        "cld                                                 ;"
-       	"movl $1440,%%ecx                                   ;"
-       	"rep movsb    # copy ECX bytes from M[ESI] to M[EDI]  "
-      : /* no outputs */
-      : "S" (img), "D" (mem_image + scr_addr) 
-      : "eax", "ecx", "memory"
-    );
+    for (i = 4; i-- > 0; ) {
+	if (VIDEO_ROW_BYTES == vga_row_bytes && VIDEO_ROW_BYTES == width) {
+	    vga_write_plane (i, 0x0000, img + i * VIDEO_STATUS_SIZE, 
+			     VIDEO_STATUS_SIZE);
+	    continue;
+	}
+	for (y = 0; VIDEO_STATUS_ROWS > y; y++) {
+	    vga_write_plane (i, y * vga_row_bytes + x, img + 
+			     i * VIDEO_STATUS_SIZE + y * VIDEO_ROW_BYTES + x,
+			     width);
+	}
+    }
 }
 
 #if defined(TEXT_RESTORE_PROGRAM)
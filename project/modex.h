@@ -41,6 +41,9 @@
 #define MODEX_H
 
 
+#include <stdint.h>
+#include <stdio.h>
+
 #include "text.h"
 
 
@@ -59,6 +62,7 @@
 #define SCROLL_X_DIM	IMAGE_X_DIM                /* full image width      */
 #define SCROLL_Y_DIM    IMAGE_Y_DIM                /* full image width      */
 #define SCROLL_X_WIDTH  (IMAGE_X_DIM / 4)          /* addresses (bytes)     */
+#define STATUS_BAR_CELLS (IMAGE_X_DIM / FONT_WIDTH) /* characters           */
 
 
 /*
@@ -110,6 +114,17 @@
  * within a logical space defined by the program.  For example, if this
  * window shifts one pixel to the left, only the left border of the screen
  * is drawn.  Other data are left untouched in most cases.
+ *
+ * Setting ADVENTURE_SCROLL to "hw" replaces the two pages with a single
+ * screen of wider rows in video memory, which the VGA pans through by
+ * changing its start address and pixel panning registers.  Only the newly
+ * drawn borders are then copied to video memory.
+ *
+ * Setting ADVENTURE_LATCH to "1" keeps the two pages, but moves what is
+ * still visible within a page with VGA latch copies (four planes per byte
+ * access) and keeps recently shown whole screens in the unused video 
+ * memory beyond the pages, so that only newly exposed pixels are copied
+ * from the build buffer.
  */
 
 /* configure VGA for mode X; initializes logical view to (0,0) */
@@ -136,10 +151,22 @@ extern int draw_horiz_line (int y);
 /* draw a vertical line at horizontal pixel x within the logical view window */
 extern int draw_vert_line (int x);
 
-/* draw a status buffer in mode X on the screen*/
-extern void show_status_bar(unsigned char* status_bar_input, unsigned char* status_bar_buf);
+/* draw a line of STATUS_BAR_CELLS characters in the status bar */
+extern void show_status_bar (const unsigned char* status_bar_input);
+
+/* change the status bar font and background colors */
+extern void set_status_colors (unsigned char fg, unsigned char bg);
 
 /* fill my own palette when drawing */
 extern void fill_my_palette(const void* pale);
 
+/* print bytes written to video memory per frame */
+extern void vram_report (FILE* f);
+
+/* print statistics on waits for vertical retrace before page flips */
+extern void retrace_report (FILE* f);
+
+/* get bytes written to video memory in the last complete frame */
+extern uint32_t vram_bytes_last_frame ();
+
 #endif /* MODEX_H */
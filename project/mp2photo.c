@@ -45,6 +45,11 @@
  * The output file format is 5:6:5 RGB stored in the same order as in the
  * BMP, i.e., rows from bottom to top, and from right to left within each
  * row.  The header simply gives the dimensions of the image.
+ *
+ * When compiled with WRITE_TILED_PHOTO, the program instead writes the
+ * tiled photo format described in photo_headers.h, which the game streams
+ * from disk rather than holding in memory.  Tiled photos may be as large
+ * as the header fields allow.
  */
 
 
@@ -59,6 +64,15 @@
 #if !defined(WRITE_OBJECT_IMAGE)
 #define WRITE_OBJECT_IMAGE 0		/* output defaults to room photo */
 #endif
+#if !defined(WRITE_TILED_PHOTO)
+#define WRITE_TILED_PHOTO 0		/* output defaults to untiled photo */
+#endif
+
+#if (1 == WRITE_TILED_PHOTO)
+#define MAX_BMP_DIM 65535		/* limited by tiled header fields */
+#else
+#define MAX_BMP_DIM 4096
+#endif
 
 
 /* 
@@ -87,7 +101,8 @@ bmp_header_check (const char* fname, FILE* in, bmp_header_t* h)
         fprintf (stderr, "%s does not appear to be a BMP file.\n", fname);
 	return 0;
     }
-    if (4096 < h->img_width || 4096 < h->img_height || 1 != h->planes || 
+    if (MAX_BMP_DIM < h->img_width || MAX_BMP_DIM < h->img_height || 
+	1 != h->planes || 
     	24 != h->bits_per_pixel || 0 != h->compression_type) {
         fprintf (stderr, "%s must be 24-bit-color on one plane with no "
 		 "compression.\n", fname);
@@ -127,6 +142,63 @@ read_bmp_image_data (FILE* in, const bmp_header_t* h)
     return img_data;
 }
 
+#if (1 == WRITE_TILED_PHOTO)
+
+// Convert the BMP pixel at (x,y) into a 5:6:5 RGB word.  Note that BMP
+// rows run from bottom to top.
+static uint16_t
+bmp_pixel_565 (const bmp_header_t* h, const uint8_t* img, uint32_t x,
+	       uint32_t y)
+{
+    const uint8_t* bgr = &img[bmp_row_width (h) * y + 3 * x];
+
+    return ((bgr[2] >> 3) << 11) | ((bgr[1] >> 2) << 5) | (bgr[0] >> 3);
+}
+
+// Write header and data in the tiled photo format, one tile at a time,
+// to the output file.  Return 1 on success, 0 on failure.
+static int
+write_output_file (FILE* out, const bmp_header_t* h, const uint8_t* img)
+{
+    tiled_photo_header_t hdr;
+    uint16_t             tile[PHOTO_TILE_DIM * PHOTO_TILE_DIM];
+    uint32_t             tx, ty;	/* upper left pixel of tile */
+    uint32_t             x, y;		/* pixel within tile        */
+
+    // Write header to output file.
+    memcpy (hdr.magic, TILED_PHOTO_MAGIC, sizeof (hdr.magic));
+    hdr.width = h->img_width;
+    hdr.height = h->img_height;
+    hdr.tile_dim = PHOTO_TILE_DIM;
+    hdr.reserved = 0;
+    if (1 != fwrite (&hdr, sizeof (hdr), 1, out)) {
+        perror ("write header to output file");
+	return 0;
+    }
+
+    // Write tiles from top to bottom, left to right, padding with zeroes.
+    for (ty = 0; h->img_height > ty; ty += PHOTO_TILE_DIM) {
+	for (tx = 0; h->img_width > tx; tx += PHOTO_TILE_DIM) {
+	    for (y = 0; PHOTO_TILE_DIM > y; y++) {
+		for (x = 0; PHOTO_TILE_DIM > x; x++) {
+		    tile[PHOTO_TILE_DIM * y + x] = 
+			(h->img_width > tx + x && h->img_height > ty + y ?
+			 bmp_pixel_565 (h, img, tx + x, 
+			 		h->img_height - 1 - (ty + y)) : 0);
+		}
+	    }
+	    if (1 != fwrite (tile, sizeof (tile), 1, out)) {
+		perror ("write tile to output file");
+		return 0;
+	    }
+	}
+    }
+
+    return 1;
+}
+
+#else /* (1 != WRITE_TILED_PHOTO) */
+
 // Write header and data as either 5:6:5 RGB words (little endian) or
 // 2:2:2 RGB bytes, row by row, to the output file.  Return 1 on success, 
 // 0 on failure.
@@ -179,6 +251,8 @@ write_output_file (FILE* out, const bmp_header_t* h, const uint8_t* img)
     return 1;
 }
 
+#endif /* WRITE_TILED_PHOTO */
+
 int
 main (int argc, char* argv[])
 {
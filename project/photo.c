@@ -36,12 +36,19 @@
  */
 
 
+#include <pthread.h>
 #include <string.h>
+#include <unistd.h>
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <emmintrin.h>
+#endif
 
 #include "assert.h"
 #include "modex.h"
 #include "photo.h"
 #include "photo_headers.h"
+#include "tile.h"
 #include "world.h"
 
 /* bitmask to lower four bits */
@@ -85,7 +92,11 @@ const int bit5 = 0x1F;	/* 5 bits bitmask */
 struct photo_t {
     photo_header_t hdr;			/* defines height and width */
     uint8_t        palette[192][3];     /* optimized palette colors */
-    uint8_t*       img;                 /* pixel data               */
+    uint8_t        color_map[4096];     /* palette index by lv4 node */
+    uint8_t*       img;                 /* pixel data (NULL if tiled) */
+    tile_src_t*    tiles;               /* tile source (NULL if not) */
+    uint8_t*       level[PHOTO_LEVELS]; /* downscaled pixel data (level 0
+    					   is img; NULL if not built)   */
 };
 
 /* 
@@ -127,15 +138,43 @@ int8_t is128[LV4SIZE];	/* Identify which pixel is the first 128 bit */
 
 uint16_t pixel_array[PAS]; /* Document all of the pixel in the image */
 
+/* local functions--see function headers for details */
+static void box_filter (const uint8_t* in, int32_t in_w, uint8_t* out,
+			int32_t out_w, int32_t out_h);
+static void* pyramid_thread (void* arg);
+static void render_overview (const photo_t* p);
+
 /* file-scope variables */
 
 /* 
- * The room currently shown on the screen.  This value is not known to 
- * the mode X code, but is needed when filling buffers in callbacks from 
- * that code (fill_horiz_buffer/fill_vert_buffer).  The value is set 
- * by calling prep_room.
+ * The room photo currently shown on the screen, and the objects drawn
+ * over it.  These values are not known to the mode X code, but are 
+ * needed when filling buffers in callbacks from that code 
+ * (fill_horiz_buffer/fill_vert_buffer).  The photo is set by calling
+ * prep_room, and the objects by calling set_room_objects with copies
+ * made by get_room_objects, so that drawing never reads the world 
+ * while the game changes it.
  */
-static const room_t* cur_room = NULL; 
+static const photo_t* cur_photo = NULL; 
+static view_obj_t     cur_obj[PHOTO_MAX_OBJS];
+static int32_t        cur_n_objs = 0;
+
+/*
+ * Overview mode shows the whole room photo at screen size.  The screen
+ * image is rendered in one pass from the photo's pyramid into ov_buf
+ * when the photo shown changes, and the line fill callbacks then copy
+ * from ov_buf.  The view window stays at (0,0) in overview mode.
+ */
+static int32_t        overview = 0;
+static const photo_t* ov_photo = NULL;
+static unsigned char  ov_buf[SCROLL_Y_DIM][SCROLL_X_DIM];
+
+/* pyramid statistics, filled in by build_photo_pyramids */
+static int32_t  pyr_photos;	/* photos with pyramids            */
+static uint32_t pyr_bytes;	/* bytes used by downscaled levels */
+static uint32_t pyr_base_bytes;	/* bytes used by full-size images  */
+static int32_t  pyr_threads;	/* threads used to build pyramids  */
+static int32_t  pyr_simd;	/* 1 if SSE2 box filter was used   */
 
 
 /* 
@@ -157,7 +196,7 @@ void
 fill_horiz_buffer (int x, int y, unsigned char buf[SCROLL_X_DIM])
 {
     int            idx;   /* loop index over pixels in the line          */ 
-    object_t*      obj;   /* loop index over objects in the current room */
+    int32_t        obj;   /* loop index over objects in the current room */
     int            imgx;  /* loop index over pixels in object image      */ 
     int            yoff;  /* y offset into object image                  */ 
     uint8_t        pixel; /* pixel from object image                     */
@@ -167,20 +206,40 @@ fill_horiz_buffer (int x, int y, unsigned char buf[SCROLL_X_DIM])
     const image_t* img;   /* object image                                */
 
     /* Get pointer to current photo of current room. */
-    view = room_photo (cur_room);
+    view = cur_photo;
+
+    /* In overview mode, copy the line from the rendered overview. */
+    if (overview) {
+	if (ov_photo != view) {
+	    render_overview (view);
+	}
+	for (idx = 0; idx < SCROLL_X_DIM; idx++) {
+	    buf[idx] = (0 <= y && SCROLL_Y_DIM > y && 0 <= x + idx &&
+			SCROLL_X_DIM > x + idx ? ov_buf[y][x + idx] : 0);
+	}
+	return;
+    }
 
-    /* Loop over pixels in line. */
-    for (idx = 0; idx < SCROLL_X_DIM; idx++) {
-        buf[idx] = (0 <= x + idx && view->hdr.width > x + idx ?
-		    view->img[view->hdr.width * y + x + idx] : 0);
+    /* 
+     * Loop over pixels in line.  Tiled photos are streamed instead, and
+     * the tiles around the line are requested ahead of the scroll.
+     */
+    if (NULL != view->tiles) {
+	tile_fill_horiz (view->tiles, x, y, SCROLL_X_DIM, buf);
+	tile_prefetch (view->tiles, x - PHOTO_TILE_DIM, y - PHOTO_TILE_DIM,
+		       SCROLL_X_DIM + 2 * PHOTO_TILE_DIM, 2 * PHOTO_TILE_DIM);
+    } else {
+	for (idx = 0; idx < SCROLL_X_DIM; idx++) {
+	    buf[idx] = (0 <= x + idx && view->hdr.width > x + idx ?
+			view->img[view->hdr.width * y + x + idx] : 0);
+	}
     }
 
     /* Loop over objects in the current room. */
-    for (obj = room_contents_iterate (cur_room); NULL != obj;
-    	 obj = obj_next (obj)) {
-	obj_x = obj_get_x (obj);
-	obj_y = obj_get_y (obj);
-	img = obj_image (obj);
+    for (obj = 0; cur_n_objs > obj; obj++) {
+	obj_x = cur_obj[obj].x;
+	obj_y = cur_obj[obj].y;
+	img = cur_obj[obj].img;
 
         /* Is object outside of the line we're drawing? */
 	if (y < obj_y || y >= obj_y + img->hdr.height ||
@@ -235,7 +294,7 @@ void
 fill_vert_buffer (int x, int y, unsigned char buf[SCROLL_Y_DIM])
 {
     int            idx;   /* loop index over pixels in the line          */ 
-    object_t*      obj;   /* loop index over objects in the current room */
+    int32_t        obj;   /* loop index over objects in the current room */
     int            imgy;  /* loop index over pixels in object image      */ 
     int            xoff;  /* x offset into object image                  */ 
     uint8_t        pixel; /* pixel from object image                     */
@@ -245,20 +304,40 @@ fill_vert_buffer (int x, int y, unsigned char buf[SCROLL_Y_DIM])
     const image_t* img;   /* object image                                */
 
     /* Get pointer to current photo of current room. */
-    view = room_photo (cur_room);
+    view = cur_photo;
 
-    /* Loop over pixels in line. */
-    for (idx = 0; idx < SCROLL_Y_DIM; idx++) {
-        buf[idx] = (0 <= y + idx && view->hdr.height > y + idx ?
-		    view->img[view->hdr.width * (y + idx) + x] : 0);
+    /* In overview mode, copy the line from the rendered overview. */
+    if (overview) {
+	if (ov_photo != view) {
+	    render_overview (view);
+	}
+	for (idx = 0; idx < SCROLL_Y_DIM; idx++) {
+	    buf[idx] = (0 <= x && SCROLL_X_DIM > x && 0 <= y + idx &&
+			SCROLL_Y_DIM > y + idx ? ov_buf[y + idx][x] : 0);
+	}
+	return;
+    }
+
+    /* 
+     * Loop over pixels in line.  Tiled photos are streamed instead, and
+     * the tiles around the line are requested ahead of the scroll.
+     */
+    if (NULL != view->tiles) {
+	tile_fill_vert (view->tiles, x, y, SCROLL_Y_DIM, buf);
+	tile_prefetch (view->tiles, x - PHOTO_TILE_DIM, y - PHOTO_TILE_DIM,
+		       2 * PHOTO_TILE_DIM, SCROLL_Y_DIM + 2 * PHOTO_TILE_DIM);
+    } else {
+	for (idx = 0; idx < SCROLL_Y_DIM; idx++) {
+	    buf[idx] = (0 <= y + idx && view->hdr.height > y + idx ?
+			view->img[view->hdr.width * (y + idx) + x] : 0);
+	}
     }
 
     /* Loop over objects in the current room. */
-    for (obj = room_contents_iterate (cur_room); NULL != obj;
-    	 obj = obj_next (obj)) {
-	obj_x = obj_get_x (obj);
-	obj_y = obj_get_y (obj);
-	img = obj_image (obj);
+    for (obj = 0; cur_n_objs > obj; obj++) {
+	obj_x = cur_obj[obj].x;
+	obj_y = cur_obj[obj].y;
+	img = cur_obj[obj].img;
 
         /* Is object outside of the line we're drawing? */
 	if (x < obj_x || x >= obj_x + img->hdr.width ||
@@ -355,21 +434,69 @@ photo_width (const photo_t* p)
 
 /* 
  * prep_room
- *   DESCRIPTION: Prepare a new room for display.  You might want to set
- *                up the VGA palette registers according to the color
- *                palette that you chose for this room.
- *   INPUTS: r -- pointer to the new room
+ *   DESCRIPTION: Prepare a new room photo for display: set up the VGA 
+ *                palette registers according to the color palette that
+ *                was chosen for the photo, and start streaming it.
+ *   INPUTS: p -- the room photo
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: changes recorded cur_photo for this file
+ */
+void
+prep_room (const photo_t* p)
+{
+    /* Record the current photo. */
+    fill_my_palette(p->palette);
+    cur_photo = p;
+
+    /* Start reading the tiles of a streamed photo before it is drawn. */
+    if (NULL != p->tiles) {
+	tile_prefetch (p->tiles, 0, 0, SCROLL_X_DIM + PHOTO_TILE_DIM,
+		       SCROLL_Y_DIM + PHOTO_TILE_DIM);
+    }
+}
+
+
+/* 
+ * get_room_objects
+ *   DESCRIPTION: Copy the positions and images of the objects in a room,
+ *                for drawing later (perhaps by another thread).
+ *   INPUTS: r -- the room
+ *           max -- most objects to copy
+ *   OUTPUTS: objs -- the objects, in drawing order
+ *   RETURN VALUE: number of objects copied
+ *   SIDE EFFECTS: none
+ */
+int32_t
+get_room_objects (const room_t* r, view_obj_t* objs, int32_t max)
+{
+    const object_t* obj;  /* loop index over objects in the room */
+    int32_t n;            /* objects copied                      */
+
+    for (obj = room_contents_iterate (r), n = 0; NULL != obj && max > n;
+    	 obj = obj_next (obj), n++) {
+	objs[n].x = obj_get_x (obj);
+	objs[n].y = obj_get_y (obj);
+	objs[n].img = obj_image (obj);
+    }
+    return n;
+}
+
+
+/* 
+ * set_room_objects
+ *   DESCRIPTION: Set the objects drawn over the room photo.
+ *   INPUTS: objs -- the objects, as copied by get_room_objects
+ *           n -- number of objects (at most PHOTO_MAX_OBJS)
  *   OUTPUTS: none
  *   RETURN VALUE: none
- *   SIDE EFFECTS: changes recorded cur_room for this file
+ *   SIDE EFFECTS: changes recorded objects for this file
  */
 void
-prep_room (const room_t* r)
+set_room_objects (const view_obj_t* objs, int32_t n)
 {
-    /* Record the current room. */
-	photo_t *pptr = room_photo(r);
-	fill_my_palette(pptr->palette);
-    cur_room = r;
+    (void)memcpy (cur_obj, objs, n * sizeof (objs[0]));
+    cur_n_objs = n;
 }
 
 
@@ -447,7 +574,6 @@ read_obj_image (const char* fname)
     (void)fclose (in);
     return img;
 }
-
 /*
  * lv4octree_init
  *   DESCRIPTION: Initialization of the level 4 of the octree.
@@ -500,6 +626,212 @@ lv4octree_cmp(const void* a, const void* b){
 	return (ele1->num) < (ele2->num) ;
 }
 
+/*
+ * lv4octree_key
+ *   DESCRIPTION: Find the level 4 octree node of a 5:6:5 pixel, which is
+ *                the upper four bits of each of red, green, and blue.
+ *   INPUTS: pixel -- 5:6:5 RGB pixel
+ *   OUTPUTS: none
+ *   RETURN VALUE: 12-bit index of the node
+ *   SIDE EFFECTS: none
+ */
+static uint32_t
+lv4octree_key (uint16_t pixel)
+{
+	uint32_t pixel_r = ((pixel >> twl) & LOWER_FOURBITS);	/* Get higher 4 bit of the red */
+	uint32_t pixel_g = ((pixel >> svn) & LOWER_FOURBITS);	/* Get higher 4 bit of the green */
+	uint32_t pixel_b = ((pixel >> 1) & LOWER_FOURBITS);	/* Get higher 4 bit of the blue */
+
+	return ((pixel_r << 8) | (pixel_g << 4) | pixel_b);
+}
+
+/*
+ * lv4octree_add
+ *   DESCRIPTION: Add one pixel to its node of the level 4 octree.
+ *   INPUTS: pixel -- 5:6:5 RGB pixel
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: modify the value in lv4octree
+ */
+static void
+lv4octree_add (uint16_t pixel)
+{
+	uint32_t pixel_rgb = lv4octree_key (pixel); /* Offset of the rgb value */
+
+	/* Then add the color to the red green and blue component to the lv4octree */
+	lv4octree[pixel_rgb].avg_r += ((pixel >> elev) << 1); /* Because it has only five bits, we need to shift right */
+	lv4octree[pixel_rgb].avg_g += ((pixel >> fv) & bit6); /* Green component has six bits, and we should eliminate all higher bits */
+	lv4octree[pixel_rgb].avg_b += ((pixel & bit5) << 1); /* Blue component has only five bits, we should first eliminate all higher bits and shift left for 1 bits */
+	lv4octree[pixel_rgb].num += 1; /* Once one point is confined in this node, I add it to the node */ 
+}
+
+/*
+ * octree_finish
+ *   DESCRIPTION: Once every pixel of a photo has been added to the level 4
+ *                octree, pick the 128 most popular level 4 nodes, fold
+ *                the remaining nodes into the level 2 octree, and fill in
+ *                the photo's palette and its color map.
+ *
+ *                A pixel outside of the chosen level 4 nodes maps to the
+ *                level 2 node given by the upper two bits of each color,
+ *                which are also the upper two bits of each color in the
+ *                level 4 node.  The level 2 sums are thus the sums of the
+ *                unchosen level 4 nodes, and every pixel's palette index
+ *                depends only on its level 4 node.
+ *   INPUTS: p -- the photo
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: sorts lv4octree; fills lv2octree, p->palette, and
+ *                 p->color_map
+ */
+static void
+octree_finish (photo_t* p)
+{
+	int i;
+	uint32_t key;
+	uint32_t lv2;
+
+	/* After doing it, we have known that the octree, then we should sort it */
+	/* Use std qsort and define my own compare function */
+	qsort(lv4octree,lv4octree_size,sizeof(lv4octree[0]),lv4octree_cmp);
+
+	/* set the first 128 element in lv4 */
+	for(i = 0; i < lv4octree_chosen; i++){
+		is128[lv4octree[i].color_rgb] = orignal_offset + i; /* give the first 128 element the index in the FINAL buffer */
+	}
+	/* If there has point which belongs to the lv4node, calculate the average (only first 128 elements) */
+	for(i = 0; i < lv4octree_chosen; i++){
+		if(lv4octree[i].num != 0){
+			lv4octree[i].avg_r /= lv4octree[i].num;
+			lv4octree[i].avg_g /= lv4octree[i].num;
+			lv4octree[i].avg_b /= lv4octree[i].num;
+		}
+		/* Set the first 128 Palette */
+		p->palette[i][0] = (uint8_t) lv4octree[i].avg_r;
+		p->palette[i][1] = (uint8_t) lv4octree[i].avg_g;
+		p->palette[i][2] = (uint8_t) lv4octree[i].avg_b;
+	}
+
+	/* Fold the rest of the lv4 nodes into the lv2octree */
+	for(i = lv4octree_chosen; i < lv4octree_size; i++){
+		key = lv4octree[i].color_rgb;
+		lv2 = ((((key >> 10) & bit3) << 4) | (((key >> 6) & bit3) << 2) | ((key >> 2) & bit3));
+		lv2octree[lv2].avg_r += lv4octree[i].avg_r;
+		lv2octree[lv2].avg_g += lv4octree[i].avg_g;
+		lv2octree[lv2].avg_b += lv4octree[i].avg_b;
+		lv2octree[lv2].num += lv4octree[i].num;
+	}
+
+	/* Write the value into the palette */
+	for(i = lv4octree_chosen; i < palette_size; i++){
+		if(lv2octree[i - lv4octree_chosen].num == 0)	/* because we need to calculate the average, so I igonre the value of the palette */
+			continue;
+		p->palette[i][0] = (uint8_t)(lv2octree[i - lv4octree_chosen].avg_r / lv2octree[i - lv4octree_chosen].num);	/* tick it into palette */
+		p->palette[i][1] = (uint8_t)(lv2octree[i - lv4octree_chosen].avg_g / lv2octree[i - lv4octree_chosen].num);
+		p->palette[i][2] = (uint8_t)(lv2octree[i - lv4octree_chosen].avg_b / lv2octree[i - lv4octree_chosen].num);
+	}
+
+	/* Record the palette index of every lv4 node */
+	for(key = 0; key < lv4octree_size; key++){
+		if(is128[key] != 0){
+			p->color_map[key] = is128[key];
+		}else{
+			lv2 = ((((key >> 10) & bit3) << 4) | (((key >> 6) & bit3) << 2) | ((key >> 2) & bit3));
+			p->color_map[key] = orignal_offset + lv4octree_chosen + lv2;
+		}
+	}
+}
+
+/*
+ * photo_map_pixels
+ *   DESCRIPTION: Map 5:6:5 RGB pixels to palette indices of a photo.
+ *   INPUTS: p -- the photo
+ *           in -- 5:6:5 RGB pixels
+ *           n -- number of pixels
+ *   OUTPUTS: out -- palette indices
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void
+photo_map_pixels (const photo_t* p, const uint16_t* in, uint8_t* out, int n)
+{
+    int idx;	/* index over pixels */
+
+    for (idx = 0; n > idx; idx++) {
+        out[idx] = p->color_map[lv4octree_key (in[idx])];
+    }
+}
+
+/*
+ * read_tiled_photo
+ *   DESCRIPTION: Read the header of a tiled photo file, choose the photo's
+ *                palette from a pass over its tiles, and open the file for
+ *                streaming.  The pixels are not kept in memory.
+ *   INPUTS: fname -- file name for input
+ *           in -- input file, open on fname
+ *           p -- photo structure with img set to NULL
+ *   OUTPUTS: none
+ *   RETURN VALUE: p on success, or NULL on failure
+ *   SIDE EFFECTS: frees p and closes in on failure
+ */
+static photo_t*
+read_tiled_photo (const char* fname, FILE* in, photo_t* p)
+{
+    tiled_photo_header_t hdr;	/* tiled photo header         */
+    uint16_t tile[PHOTO_TILE_DIM * PHOTO_TILE_DIM]; /* one tile  */
+    int32_t  tiles_x;		/* number of tile columns     */
+    int32_t  tiles_y;		/* number of tile rows        */
+    int32_t  tx, ty;		/* index over tiles           */
+    int32_t  w, h;		/* valid pixels in tile       */
+    int32_t  x, y;		/* index over pixels in tile  */
+
+    if (0 != fseek (in, 0, SEEK_SET) ||
+	1 != fread (&hdr, sizeof (hdr), 1, in) ||
+	PHOTO_TILE_DIM != hdr.tile_dim ||
+	0 == hdr.width || 0 == hdr.height) {
+	free (p);
+	(void)fclose (in);
+	return NULL;
+    }
+    p->hdr.width = hdr.width;
+    p->hdr.height = hdr.height;
+
+    /* Choose the palette, ignoring the padding of edge tiles. */
+    lv4octree_init ();
+    tiles_x = (hdr.width + PHOTO_TILE_DIM - 1) / PHOTO_TILE_DIM;
+    tiles_y = (hdr.height + PHOTO_TILE_DIM - 1) / PHOTO_TILE_DIM;
+    for (ty = 0; tiles_y > ty; ty++) {
+	h = hdr.height - ty * PHOTO_TILE_DIM;
+	if (PHOTO_TILE_DIM < h) {
+	    h = PHOTO_TILE_DIM;
+	}
+	for (tx = 0; tiles_x > tx; tx++) {
+	    if (1 != fread (tile, sizeof (tile), 1, in)) {
+		free (p);
+		(void)fclose (in);
+		return NULL;
+	    }
+	    w = hdr.width - tx * PHOTO_TILE_DIM;
+	    if (PHOTO_TILE_DIM < w) {
+		w = PHOTO_TILE_DIM;
+	    }
+	    for (y = 0; h > y; y++) {
+		for (x = 0; w > x; x++) {
+		    lv4octree_add (tile[PHOTO_TILE_DIM * y + x]);
+		}
+	    }
+	}
+    }
+    octree_finish (p);
+    (void)fclose (in);
+
+    if (NULL == (p->tiles = tile_src_open (fname, sizeof (hdr), p))) {
+	free (p);
+        return NULL;
+    }
+    return p;
+}
+
 /* 
  * read_photo
  *   DESCRIPTION: Read size and pixel data in 5:6:5 RGB format from a
@@ -508,6 +840,9 @@ lv4octree_cmp(const void* a, const void* b){
  *                replace this code with palette color selection, and
  *                must map the image pixels into the palette colors that
  *                you have defined.
+ *
+ *                Tiled photos are not read into memory; their pixels
+ *                are streamed through the tile cache as they are drawn.
  *   INPUTS: fname -- file name for input
  *   OUTPUTS: none
  *   RETURN VALUE: pointer to newly allocated photo on success, or NULL
@@ -526,16 +861,20 @@ read_photo (const char* fname)
     /* 
      * Open the file, allocate the structure, read the header, do some
      * sanity checks on it, and allocate space to hold the photo pixels.
-     * If anything fails, clean up as necessary and return NULL.
+     * If anything fails, clean up as necessary and return NULL.  A
+     * tiled photo is recognized by its magic sequence and leaves img
+     * set to NULL.
      */
     if (NULL == (in = fopen (fname, "r+b")) ||
 	NULL == (p = malloc (sizeof (*p))) ||
 	NULL != (p->img = NULL) || /* false clause for initialization */
+	NULL != (p->tiles = NULL) || /* false clause for initialization */
 	1 != fread (&p->hdr, sizeof (p->hdr), 1, in) ||
-	MAX_PHOTO_WIDTH < p->hdr.width ||
-	MAX_PHOTO_HEIGHT < p->hdr.height ||
-	NULL == (p->img = malloc 
-		 (p->hdr.width * p->hdr.height * sizeof (p->img[0])))) {
+	(0 != memcmp (&p->hdr, TILED_PHOTO_MAGIC, sizeof (p->hdr)) &&
+	 (MAX_PHOTO_WIDTH < p->hdr.width ||
+	  MAX_PHOTO_HEIGHT < p->hdr.height ||
+	  NULL == (p->img = malloc 
+		   (p->hdr.width * p->hdr.height * sizeof (p->img[0])))))) {
 	if (NULL != p) {
 	    if (NULL != p->img) {
 	        free (p->img);
@@ -546,6 +885,11 @@ read_photo (const char* fname)
 	    (void)fclose (in);
 	}
 	return NULL;
+    }
+    (void)memset (p->level, 0, sizeof (p->level));
+    p->level[0] = p->img;
+    if (NULL == p->img) {
+        return read_tiled_photo (fname, in, p);
     }
 	/* CRITICAL SECTION ABOUT MY CODE ABOUT MP2 CHECKPOINT 2 */
 
@@ -594,141 +938,376 @@ read_photo (const char* fname)
 		/* Octree Section */
 		/* Actually, it is only the first iteration of the loop */
 		/* Therefore, the first iteration's mission is to build the octree of lv4 */
-		
-		/* First step, calculate the offset of the pixel of the octree */
-		uint32_t pixel_r = pixel;
-		uint32_t pixel_g = pixel;
-		uint32_t pixel_b = pixel;
 		/* the origin data is pixel (565 RGB) */
 		pixel_array[tot] = pixel;
 		tot += 1;
-		/* Obtain the higher 5 bit R component and convert it to 4 bits */
-		pixel_r >>= twl;	/* Get higher 4 bit of the pixel */
-		pixel_r &= LOWER_FOURBITS;
+		lv4octree_add (pixel);
+	}
+    }
 
-		/* Obtain the higher 4 bit G component and convert it to 4 bit */
-		pixel_g >>= svn;
-		pixel_g &= LOWER_FOURBITS;	/* eliminate all higher bits, only choose the lower 4 bits */
+	/* Choose the palette and map every lv4 node to a palette index */
+	octree_finish (p);
 
-		/* Obtain the higher 5 bit B component and convert it to 4 bits */
-		pixel_b >>= 1;
-		pixel_b &= LOWER_FOURBITS;
+	tot = 0;
+	/* Second Iteration: map each pixel through its lv4 node */
+    for (y = p->hdr.height; y-- > 0; ) {
+	photo_map_pixels (p, &pixel_array[tot],
+			  &p->img[p->hdr.width * y], p->hdr.width);
+	tot += p->hdr.width;
+    }
 
-		/* Then aggrate it into 12 bit */
-		uint32_t pixel_rgb = ( (pixel_r << 8) | (pixel_g << 4) | (pixel_b) ); /* Offset of the rgb value */
-		
-		/* Then add the color to the red green and blue component to the lv4octree */
-		lv4octree[pixel_rgb].avg_r += ((pixel >> 11) << 1); /* Because it has only five bits, we need to shift right */
-		lv4octree[pixel_rgb].avg_g += ((pixel >> 5) & bit6); /* Green component has six bits, and we should eliminate all higher bits */
-		lv4octree[pixel_rgb].avg_b += ((pixel & 0x1F) << 1); /* Blue component has only five bits, we should first eliminate all higher bits and shift left for 1 bits */
-		lv4octree[pixel_rgb].num += 1; /* Once one point is confined in this node, I add it to the node */ 
+	/* CRITICAL SECTION ABOUT MY CODE ABOUT MP2 CHECKPOINT 2 */
+ 
+    /* All done.  Return success. */
+    (void)fclose (in);
+    return p;
+}
+
+
+/*
+ * Arguments shared by the threads that build photo pyramids.  Each thread
+ * claims the next photo by incrementing next with an atomic add.
+ */
+typedef struct pyramid_work_t pyramid_work_t;
+struct pyramid_work_t {
+    photo_t** photos;	/* photos to process           */
+    int32_t   n;	/* number of photos            */
+    int32_t   next;	/* index of next photo to take */
+    int32_t   simd;	/* use the SSE2 box filter     */
+};
+
+
+/*
+ * box_filter
+ *   DESCRIPTION: Halve one color plane in each dimension by averaging
+ *                (with rounding) each 2x2 block of pixels.
+ *   INPUTS: in -- input plane, 2 * out_h rows of in_w bytes
+ *           in_w -- input row length in bytes
+ *           (out_w,out_h) -- output plane dimensions (out_w <= in_w / 2)
+ *   OUTPUTS: out -- output plane, out_h rows of out_w bytes
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ *
+ *   box_filter_sse2 computes the same result as box_filter (it is only
+ *   called on processors that support SSE2).
+ */
+#if defined(__i386__) || defined(__x86_64__)
+__attribute__ ((target ("sse2")))
+static void
+box_filter_sse2 (const uint8_t* in, int32_t in_w, uint8_t* out,
+		 int32_t out_w, int32_t out_h)
+{
+    const __m128i lo = _mm_set1_epi16 (0x00FF);	/* even byte mask */
+    const __m128i two = _mm_set1_epi16 (2);	/* for rounding   */
+    const uint8_t* r0;	/* upper input row     */
+    const uint8_t* r1;	/* lower input row     */
+    __m128i a, b, sum;	/* 16 pixels, 8 sums   */
+    int32_t x, y;	/* index over output   */
+
+    for (y = 0; out_h > y; y++) {
+	r0 = &in[2 * y * in_w];
+	r1 = r0 + in_w;
+	for (x = 0; out_w >= x + 8; x += 8) {
+	    a = _mm_loadu_si128 ((const __m128i*)&r0[2 * x]);
+	    b = _mm_loadu_si128 ((const __m128i*)&r1[2 * x]);
+	    sum = _mm_add_epi16 (_mm_and_si128 (a, lo), _mm_srli_epi16 (a, 8));
+	    sum = _mm_add_epi16 (sum, _mm_and_si128 (b, lo));
+	    sum = _mm_add_epi16 (sum, _mm_srli_epi16 (b, 8));
+	    sum = _mm_srli_epi16 (_mm_add_epi16 (sum, two), 2);
+	    _mm_storel_epi64 ((__m128i*)&out[y * out_w + x],
+			      _mm_packus_epi16 (sum, sum));
+	}
+	for (; out_w > x; x++) {
+	    out[y * out_w + x] = (r0[2 * x] + r0[2 * x + 1] +
+				  r1[2 * x] + r1[2 * x + 1] + 2) >> 2;
 	}
     }
+}
+#endif
 
-	/* After doing it, we have known that the octree, then we should sort it */
-	/* Use std qsort and define my own compare function */
-	qsort(lv4octree,lv4octree_size,sizeof(lv4octree[0]),lv4octree_cmp);
+static void
+box_filter (const uint8_t* in, int32_t in_w, uint8_t* out,
+	    int32_t out_w, int32_t out_h)
+{
+    const uint8_t* r0;	/* upper input row   */
+    const uint8_t* r1;	/* lower input row   */
+    int32_t        x, y; /* index over output */
+
+    for (y = 0; out_h > y; y++) {
+	r0 = &in[2 * y * in_w];
+	r1 = r0 + in_w;
+	for (x = 0; out_w > x; x++) {
+	    out[y * out_w + x] = (r0[2 * x] + r0[2 * x + 1] +
+				  r1[2 * x] + r1[2 * x + 1] + 2) >> 2;
+	}
+    }
+}
 
-	/* set the first 128 element in lv4 */
-	int i;
-	for(i = 0; i < lv4octree_chosen; i++){
-		is128[lv4octree[i].color_rgb] = orignal_offset + i; /* give the first 128 element the index in the FINAL buffer */
+
+/*
+ * pyramid_thread
+ *   DESCRIPTION: Function executed by each pyramid building thread.  For
+ *                each photo claimed, expands the full-size image into
+ *                6-bit red, green, and blue planes, box filters the planes
+ *                down to 1/2, 1/4, and 1/8 size, and maps each level back
+ *                to the photo's palette through its color map.  Tiled
+ *                photos are skipped.
+ *   INPUTS: arg -- pointer to the shared pyramid_work_t
+ *   OUTPUTS: none
+ *   RETURN VALUE: NULL
+ *   SIDE EFFECTS: dynamically allocates the levels of each photo; a level
+ *                 that cannot be allocated is left NULL (with any smaller
+ *                 levels)
+ */
+static void*
+pyramid_thread (void* arg)
+{
+    pyramid_work_t* work = arg;	/* shared work description        */
+    photo_t*        p;		/* photo being processed          */
+    uint8_t*        plane[2][3]; /* color planes, by parity of level */
+    const uint8_t*  rgb;	/* palette color of a pixel       */
+    uint8_t*        dst;	/* level being written            */
+    int32_t         idx;	/* index of photo                 */
+    uint32_t        i;		/* index over pixels              */
+    int32_t         lvl;	/* index over pyramid levels      */
+    int32_t         c;		/* index over color planes        */
+    int32_t         w, h;	/* dimensions of current level    */
+    uint32_t        n;		/* pixels in full-size image      */
+
+    while (work->n > (idx = __sync_fetch_and_add (&work->next, 1))) {
+	p = work->photos[idx];
+	if (NULL == p->img) {
+	    continue;
 	}
-	/* If there has point which belongs to the lv4node, calculate the average (only first 128 elements) */
-	for(i = 0; i < lv4octree_chosen; i++){
-		if(lv4octree[i].num != 0){
-			lv4octree[i].avg_r /= lv4octree[i].num;
-			lv4octree[i].avg_g /= lv4octree[i].num;
-			lv4octree[i].avg_b /= lv4octree[i].num;
+
+	/* Expand the full-size image into color planes. */
+	n = p->hdr.width * p->hdr.height;
+	if (NULL == (plane[0][0] = malloc (n * 3))) {
+	    continue;
+	}
+	plane[0][1] = plane[0][0] + n;
+	plane[0][2] = plane[0][1] + n;
+	for (i = 0; n > i; i++) {
+	    rgb = p->palette[p->img[i] - orignal_offset];
+	    plane[0][0][i] = rgb[0];
+	    plane[0][1][i] = rgb[1];
+	    plane[0][2][i] = rgb[2];
+	}
+	if (NULL == (plane[1][0] = malloc ((n / 4) * 3))) {
+	    free (plane[0][0]);
+	    continue;
+	}
+	plane[1][1] = plane[1][0] + n / 4;
+	plane[1][2] = plane[1][1] + n / 4;
+
+	w = p->hdr.width;
+	h = p->hdr.height;
+	for (lvl = 1; PHOTO_LEVELS > lvl && 2 <= w && 2 <= h; lvl++) {
+
+	    /* Filter the previous level's planes into the other set. */
+	    for (c = 0; 3 > c; c++) {
+#if defined(__i386__) || defined(__x86_64__)
+		if (work->simd) {
+		    box_filter_sse2 (plane[(lvl + 1) & 1][c], w,
+				     plane[lvl & 1][c], w / 2, h / 2);
+		    continue;
 		}
-		/* Set the first 128 Palette */
-		p->palette[i][0] = (uint8_t) lv4octree[i].avg_r;
-		p->palette[i][1] = (uint8_t) lv4octree[i].avg_g;
-		p->palette[i][2] = (uint8_t) lv4octree[i].avg_b;
+#endif
+		box_filter (plane[(lvl + 1) & 1][c], w, plane[lvl & 1][c],
+			    w / 2, h / 2);
+	    }
+	    w /= 2;
+	    h /= 2;
+
+	    /* Map the level back into the photo's palette. */
+	    if (NULL == (dst = malloc (w * h))) {
+	        break;
+	    }
+	    for (i = 0; w * h > i; i++) {
+		dst[i] = p->color_map[((plane[lvl & 1][0][i] >> 2) << 8) |
+				      ((plane[lvl & 1][1][i] >> 2) << 4) |
+				      (plane[lvl & 1][2][i] >> 2)];
+	    }
+	    p->level[lvl] = dst;
 	}
-	
-	tot = 0;
-	/* Second Iteration: find the node which belongs to the lv4 octree and set the rest of the node to the lv2octree */
-    for (y = p->hdr.height; y-- > 0; ) {
+	free (plane[0][0]);
+	free (plane[1][0]);
+    }
+    return NULL;
+}
 
-	/* Loop over columns from left to right. */
-	for (x = 0; p->hdr.width > x; x++) {
 
-	    /* 
-	     * Try to read one 16-bit pixel.  On failure, clean up and 
-	     * return NULL.
-	     */
-		/*
-	    if (1 != fread (&pixel, sizeof (pixel), 1, in)) {
-		free (p->img);
-		free (p);
-	        (void)fclose (in);
-		return NULL;
-	    }*/
+/*
+ * build_photo_pyramids
+ *   DESCRIPTION: Build the downscaled levels of a set of room photos, one
+ *                thread per processor (at most one per photo).
+ *   INPUTS: photos -- array of photos
+ *           n -- number of photos in array
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: dynamically allocates memory for each photo's levels;
+ *                 records statistics for photo_report
+ */
+void
+build_photo_pyramids (photo_t** photos, int32_t n)
+{
+    pthread_t      tid[PYRAMID_MAX_THREADS]; /* helper thread ids     */
+    pyramid_work_t work;		     /* shared work           */
+    int32_t        n_threads;		     /* threads to start      */
+    int32_t        i;			     /* index over threads    */
+    int32_t        lvl;			     /* index over levels     */
+
+    work.photos = photos;
+    work.n = n;
+    work.next = 0;
+#if defined(__i386__) || defined(__x86_64__)
+    work.simd = __builtin_cpu_supports ("sse2");
+#else
+    work.simd = 0;
+#endif
+
+    n_threads = sysconf (_SC_NPROCESSORS_ONLN);
+    if (PYRAMID_MAX_THREADS < n_threads) {
+        n_threads = PYRAMID_MAX_THREADS;
+    }
+    if (n < n_threads) {
+        n_threads = n;
+    }
 
-		/* Octree Section */
-		/* Actually, it is only the first iteration of the loop */
-		/* Therefore, the first iteration's mission is to build the octree of lv4 */
-		
-		/* First step, calculate the offset of the pixel of the octree */
-		uint32_t pixel_r = pixel_array[tot];
-		uint32_t pixel_g = pixel_array[tot];
-		uint32_t pixel_b = pixel_array[tot];
-		pixel = pixel_array[tot];
-		/* the origin data is pixel (565 RGB) */
-		tot += 1;
-		/* Obtain the higher 5 bit R component and convert it to 4 bits */
-		pixel_r >>= twl;	/* Get higher 4 bit of the pixel */
-		pixel_r &= LOWER_FOURBITS;
-
-		/* Obtain the higher 4 bit G component and convert it to 4 bit */
-		pixel_g >>= svn;
-		pixel_g &= LOWER_FOURBITS;	/* eliminate all higher bits, only choose the lower 4 bits */
-
-		/* Obtain the higher 5 bit B component and convert it to 4 bits */
-		pixel_b >>= 1;
-		pixel_b &= LOWER_FOURBITS;
-
-		/* Then aggrate it into 12 bit */
-		uint32_t pixel_rgb = ( (pixel_r << 8) | (pixel_g << 4) | (pixel_b) ); /* Offset of the rgb value */
-		/* if it belongs to the first 128 element */
-		if(is128[pixel_rgb] != 0){
-			/* It should be set to the pointer */
-			p->img[p->hdr.width * y + x] = is128[pixel_rgb];
-		}else{
-			/* It belongs to the lvl2octree */
-			uint32_t lv2octree_pixel_r = ((pixel >> ftn) & bit3); /* Get the higher two bits */
-			uint32_t lv2octree_pixel_g = ((pixel >> nin) & bit3); /* Get the higher two bits of the green */
-			uint32_t lv2octree_pixel_b = ((pixel >> thr) & bit3); /* Get the higher two bits of the blue */
-			uint32_t lv2octree_pixel_rgb = ((lv2octree_pixel_r << 4) | (lv2octree_pixel_g << 2) | (lv2octree_pixel_b));
-
-			/* Update the data in the lv2octree */
-			/* Then add the color to the red green and blue component to the lv4octree */
-			lv2octree[lv2octree_pixel_rgb].avg_r += ((pixel >> elev) << 1); /* Because it has only five bits, we need to shift right */
-			lv2octree[lv2octree_pixel_rgb].avg_g += ((pixel >> fv) & bit6); /* Green component has six bits, and we should eliminate all higher bits */
-			lv2octree[lv2octree_pixel_rgb].avg_b += ((pixel & bit5) << 1); /* Blue component has only five bits, we should first eliminate all higher bits and shift left for 1 bits */
-			lv2octree[lv2octree_pixel_rgb].num += 1; /* Once one point is confined in this node, I add it to the node */  
-
-			/* Finally, set the pointer to the real offset */
-			p->img[p->hdr.width * y + x] = orignal_offset + lv4octree_chosen + lv2octree_pixel_rgb;
-		}
+    /* Start the helpers, and build pyramids in this thread as well. */
+    for (i = 1; n_threads > i; i++) {
+	if (0 != pthread_create (&tid[i], NULL, pyramid_thread, &work)) {
+	    break;
 	}
+    }
+    n_threads = i;
+    (void)pyramid_thread (&work);
+    for (i = 1; n_threads > i; i++) {
+	(void)pthread_join (tid[i], NULL);
+    }
+
+    /* Record the memory overhead. */
+    pyr_threads = n_threads;
+    pyr_simd = work.simd;
+    for (i = 0; n > i; i++) {
+	if (NULL == photos[i]->level[1]) {
+	    continue;
 	}
-	/* Write the value into the palette */
-	int j ;
-	for(j = lv4octree_chosen; j < palette_size; j++){
-		if(lv2octree[j - lv4octree_chosen].num == 0)	/* because we need to calculate the average, so I igonre the value of the palette */
-			continue;
-		p->palette[j][0] = (uint8_t)(lv2octree[j - lv4octree_chosen].avg_r / lv2octree[j - lv4octree_chosen].num);	/* tick it into palette */
-		p->palette[j][1] = (uint8_t)(lv2octree[j - lv4octree_chosen].avg_g / lv2octree[j - lv4octree_chosen].num);
-		p->palette[j][2] = (uint8_t)(lv2octree[j - lv4octree_chosen].avg_b / lv2octree[j - lv4octree_chosen].num);
+	pyr_photos++;
+	pyr_base_bytes += photos[i]->hdr.width * photos[i]->hdr.height;
+	for (lvl = 1; PHOTO_LEVELS > lvl && NULL != photos[i]->level[lvl];
+	     lvl++) {
+	    pyr_bytes += (photos[i]->hdr.width >> lvl) *
+			 (photos[i]->hdr.height >> lvl);
 	}
+    }
+}
 
-	/* CRITICAL SECTION ABOUT MY CODE ABOUT MP2 CHECKPOINT 2 */
- 
-    /* All done.  Return success. */
-    (void)fclose (in);
-    return p;
+
+/*
+ * render_overview
+ *   DESCRIPTION: Render a whole room photo, centered at screen size, into
+ *                the overview buffer.  Uses the largest pyramid level that
+ *                fits on the screen; if none fits, samples every few
+ *                pixels of the smallest level available (the full-size
+ *                image for tiled photos, through the tile cache).
+ *   INPUTS: p -- the photo
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: fills ov_buf and sets ov_photo
+ */
+static void
+render_overview (const photo_t* p)
+{
+    int32_t  lvl;	/* pyramid level used           */
+    int32_t  w, h;	/* dimensions of level used     */
+    int32_t  step;	/* sampling step within level   */
+    int32_t  out_w;	/* width of overview image      */
+    int32_t  out_h;	/* height of overview image     */
+    int32_t  x0, y0;	/* upper left of image on screen */
+    int32_t  x, y;	/* index over overview image    */
+    const uint8_t* src; /* pixels of level used         */
+
+    for (lvl = 0; PHOTO_LEVELS - 1 > lvl && NULL != p->level[lvl + 1] &&
+	 (SCROLL_X_DIM < (p->hdr.width >> lvl) ||
+	  SCROLL_Y_DIM < (p->hdr.height >> lvl)); lvl++) {
+    }
+    w = p->hdr.width >> lvl;
+    h = p->hdr.height >> lvl;
+    step = (w + SCROLL_X_DIM - 1) / SCROLL_X_DIM;
+    if ((h + SCROLL_Y_DIM - 1) / SCROLL_Y_DIM > step) {
+        step = (h + SCROLL_Y_DIM - 1) / SCROLL_Y_DIM;
+    }
+    out_w = (w + step - 1) / step;
+    out_h = (h + step - 1) / step;
+    x0 = (SCROLL_X_DIM - out_w) / 2;
+    y0 = (SCROLL_Y_DIM - out_h) / 2;
+
+    (void)memset (ov_buf, 0, sizeof (ov_buf));
+    src = p->level[lvl];
+    for (y = 0; out_h > y; y++) {
+	for (x = 0; out_w > x; x++) {
+	    if (NULL != src) {
+		ov_buf[y0 + y][x0 + x] = src[w * y * step + x * step];
+	    } else {
+		tile_fill_horiz (p->tiles, x * step, y * step, 1,
+				 &ov_buf[y0 + y][x0 + x]);
+	    }
+	}
+    }
+    ov_photo = p;
+}
+
+
+/*
+ * set_overview
+ *   DESCRIPTION: Turn overview mode on or off.  The caller must reset the
+ *                view window to (0,0) and redraw the screen.
+ *   INPUTS: on -- 1 to show the whole room, 0 for normal scrolling view
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: changes the behavior of the line fill callbacks
+ */
+void
+set_overview (int32_t on)
+{
+    overview = on;
+    ov_photo = NULL;
+}
+
+
+/*
+ * overview_on
+ *   DESCRIPTION: Check whether overview mode is on.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if overview mode is on, 0 if not
+ *   SIDE EFFECTS: none
+ */
+int32_t
+overview_on ()
+{
+    return overview;
 }
 
 
+/*
+ * photo_report
+ *   DESCRIPTION: Print the memory used by photo pyramids.
+ *   INPUTS: f -- output stream
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void
+photo_report (FILE* f)
+{
+    if (0 == pyr_photos) {
+        return;
+    }
+    fprintf (f, "photo pyramids: %d photos, %u kB over %u kB full size "
+	     "(%u%%), %d threads, %s box filter\n", pyr_photos,
+	     pyr_bytes / 1024, pyr_base_bytes / 1024,
+	     100 * pyr_bytes / pyr_base_bytes, pyr_threads,
+	     (pyr_simd ? "SSE2" : "scalar"));
+}
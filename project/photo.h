@@ -39,6 +39,7 @@
 
 
 #include <stdint.h>
+#include <stdio.h>
 
 #include "types.h"
 #include "modex.h"
@@ -52,6 +53,37 @@
 #define MAX_OBJECT_WIDTH  160
 #define MAX_OBJECT_HEIGHT 100
 
+/*
+ * Room photos carry downscaled copies at 1/2, 1/4, and 1/8 size (levels 1
+ * to PHOTO_LEVELS - 1) for the overview mode.  The copies are built by
+ * box filtering when the world is built.
+ */
+#define PHOTO_LEVELS        4
+#define PYRAMID_MAX_THREADS 16
+
+/* 
+ * Objects are drawn from copies of their positions and images, of which
+ * there are at most PHOTO_MAX_OBJS (more than there are objects).
+ */
+#define PHOTO_MAX_OBJS 32
+typedef struct view_obj_t view_obj_t;
+struct view_obj_t {
+    int32_t        x, y;	/* position in room photo */
+    const image_t* img;		/* object image           */
+};
+
+
+/* Build the downscaled levels of a set of room photos in parallel. */
+extern void build_photo_pyramids (photo_t** photos, int32_t n);
+
+/* Turn overview mode (whole room at screen size) on or off. */
+extern void set_overview (int32_t on);
+
+/* Check whether overview mode is on. */
+extern int32_t overview_on ();
+
+/* Print the memory used by photo pyramids. */
+extern void photo_report (FILE* f);
 
 /* Fill a buffer with the pixels for a horizontal line of current room. */
 extern void fill_horiz_buffer (int x, int y, unsigned char buf[SCROLL_X_DIM]);
@@ -72,10 +104,17 @@ extern uint32_t photo_height (const photo_t* p);
 extern uint32_t photo_width (const photo_t* p);
 
 /* 
- * Prepare room for display (record pointer for use by callbacks, set up
- * VGA palette, etc.). 
+ * Prepare room photo for display (record pointer for use by callbacks,
+ * set up VGA palette, etc.). 
  */
-extern void prep_room (const room_t* r);
+extern void prep_room (const photo_t* p);
+
+/* Copy the objects in a room for drawing; returns the number copied. */
+extern int32_t get_room_objects (const room_t* r, view_obj_t* objs, 
+				 int32_t max);
+
+/* Set the objects drawn over the room photo. */
+extern void set_room_objects (const view_obj_t* objs, int32_t n);
 
 /* Read object image from a file into a dynamically allocated structure. */
 extern image_t* read_obj_image (const char* fname);
@@ -83,6 +122,10 @@ extern image_t* read_obj_image (const char* fname);
 /* Read room photo from a file into a dynamically allocated structure. */
 extern photo_t* read_photo (const char* fname);
 
+/* Map 5:6:5 RGB pixels to palette indices of a room photo. */
+extern void photo_map_pixels (const photo_t* p, const uint16_t* in,
+			      uint8_t* out, int n);
+
 /* 
  * N.B.  I'm aware that Valgrind and similar tools will report the fact that
  * I chose not to bother freeing image data before terminating the program.
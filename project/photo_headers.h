@@ -81,5 +81,30 @@ struct photo_header_t {
     uint16_t height;	/* image height in pixels */
 };
 
+/*
+ * Tiled room photo file header.  Tiled photos hold panoramas too large
+ * to keep resident; the game streams them a tile at a time.
+ *
+ * The magic sequence occupies the bytes used for the width and height in
+ * an untiled photo, and decodes there to a width far beyond any allowed
+ * for resident photos, so the two formats cannot be confused.
+ *
+ * Pixels are 5:6:5 RGB, as in untiled photos, but are grouped into square
+ * tiles of tile_dim pixels on a side.  Tiles are stored left to right, then
+ * top to bottom; pixels within a tile are stored in the same order.  Tiles
+ * on the right and bottom edges are padded with zero pixels to full size.
+ */
+#define TILED_PHOTO_MAGIC "TPH1"  /* tiled photo file magic sequence */
+#define PHOTO_TILE_DIM    64      /* tile width and height in pixels */
+
+typedef struct tiled_photo_header_t tiled_photo_header_t;
+struct tiled_photo_header_t {
+    char     magic[4];	/* TILED_PHOTO_MAGIC, without NUL       */
+    uint16_t width;	/* image width in pixels                */
+    uint16_t height;	/* image height in pixels               */
+    uint16_t tile_dim;	/* tile width and height (PHOTO_TILE_DIM) */
+    uint16_t reserved;	/* zero                                 */
+};
+
 #endif /* PHOTO_HEADERS_H */
 
@@ -0,0 +1,505 @@
+/*									tab:8
+ *
+ * port.c - VGA port I/O with write merging, recording, and a mock
+ *
+ * "Copyright (c) 2026 by Tianzuo Qin."
+ *
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation for any purpose, without fee, and without written agreement is
+ * hereby granted, provided that the above copyright notice and the following
+ * two paragraphs appear in all copies of this software.
+ *
+ * IN NO EVENT SHALL THE AUTHOR OR THE UNIVERSITY OF ILLINOIS BE LIABLE TO
+ * ANY PARTY FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL
+ * DAMAGES ARISING OUT  OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+ * EVEN IF THE AUTHOR AND/OR THE UNIVERSITY OF ILLINOIS HAS BEEN ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THE AUTHOR AND THE UNIVERSITY OF ILLINOIS SPECIFICALLY DISCLAIM ANY
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE
+ * PROVIDED HEREUNDER IS ON AN "AS IS" BASIS, AND NEITHER THE AUTHOR NOR
+ * THE UNIVERSITY OF ILLINOIS HAS ANY OBLIGATION TO PROVIDE MAINTENANCE,
+ * SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS."
+ *
+ * Author:	    Tianzuo Qin
+ * Version:	    1
+ * Creation Date:   Sun Oct 18 16:40:07 2026
+ * Filename:	    port.c
+ * History:
+ *	TQ	1	Sun Oct 18 16:40:07 2026
+ *		First written.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "port.h"
+
+
+/* 
+ * Shadow state for a VGA index/data port pair.  The registers that may be
+ * merged are those that have no side effects when written; writes to all
+ * other registers are always issued.
+ */
+typedef struct port_group_t port_group_t;
+struct port_group_t {
+    uint16_t port;		/* index port (data port is port + 1) */
+    uint8_t  hw_index;		/* index currently set in hardware    */
+    uint8_t  val[256];		/* last value written to each index   */
+    uint8_t  valid[256];	/* 1 if val holds the hardware value  */
+    uint8_t  merge[256];	/* 1 if redundant writes may be merged */
+};
+
+#define NUM_PORT_GROUPS 3
+#define PORT_LOG_MAX    (1 << 20)	/* maximum log length (writes) */
+
+static port_group_t group[NUM_PORT_GROUPS] = {
+    {0x03C4}, /* sequencer          */
+    {0x03CE}, /* graphics           */
+    {0x03D4}  /* CRT controller     */
+};
+
+static port_mode_t mode = PORT_NATIVE;
+
+/* write log for record and mock modes */
+static port_rec_t* log_buf = NULL;
+static int32_t     log_len = 0;
+static int32_t     log_cap = 0;
+static uint32_t    log_lost = 0;	/* writes not logged (log full) */
+
+/*
+ * Simulated display timing for the input status register (0x3DA) in mock
+ * mode: mode X scans 449 lines of 31.78 microseconds at 70 Hz, and the 
+ * vertical sync pulse (bit 3) lasts two lines.  Bit 0 (display disabled)
+ * is reported for 45 lines of vertical blanking starting with the pulse.
+ */
+#define MOCK_FRAME_USEC    14268
+#define MOCK_RETRACE_USEC  64
+#define MOCK_BLANK_USEC    1430
+
+/* write counts */
+static uint32_t frame_writes;	/* writes issued in current frame  */
+static uint32_t frame_merged;	/* writes merged in current frame  */
+static uint32_t n_frames;	/* frames ended                    */
+static uint64_t total_writes;	/* writes issued in ended frames   */
+static uint64_t total_merged;	/* writes merged in ended frames   */
+static uint32_t max_writes;	/* most writes issued in one frame */
+
+
+/*
+ * native_outb, native_outw, native_inb
+ *   DESCRIPTION: Execute a single port I/O instruction.
+ *   INPUTS: port -- I/O port
+ *           val -- value to write
+ *   OUTPUTS: none
+ *   RETURN VALUE: value read (native_inb only)
+ *   SIDE EFFECTS: port I/O
+ */
+static inline void
+native_outb (uint16_t port, uint8_t val)
+{
+    asm volatile ("outb %b1,(%w0)" : : "d" (port), "a" (val) : "memory");
+}
+
+static inline void
+native_outw (uint16_t port, uint16_t val)
+{
+    asm volatile ("outw %w1,(%w0)" : : "d" (port), "a" (val) : "memory");
+}
+
+static inline uint8_t
+native_inb (uint16_t port)
+{
+    uint8_t val; /* value read */
+
+    asm volatile ("inb (%w1),%b0" : "=a" (val) : "d" (port) : "memory");
+    return val;
+}
+
+
+/*
+ * find_group
+ *   DESCRIPTION: Find the shadowed port pair to which a port belongs.
+ *   INPUTS: port -- I/O port
+ *   OUTPUTS: *is_data -- 1 if port is the data port of the pair
+ *   RETURN VALUE: the port pair, or NULL if the port is not shadowed
+ *   SIDE EFFECTS: none
+ */
+static port_group_t*
+find_group (uint16_t port, int* is_data)
+{
+    int i; /* index over port pairs */
+
+    for (i = 0; NUM_PORT_GROUPS > i; i++) {
+	if (group[i].port == port || group[i].port + 1 == port) {
+	    *is_data = (group[i].port != port);
+	    return &group[i];
+	}
+    }
+    return NULL;
+}
+
+
+/*
+ * issue
+ *   DESCRIPTION: Issue (count, log, and perform) one port write.
+ *   INPUTS: port -- I/O port
+ *           val -- value to write
+ *           width -- 1 for a byte write, 2 for a word write
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: port I/O unless in mock mode; may grow the log
+ */
+static void
+issue (uint16_t port, uint16_t val, uint8_t width)
+{
+    port_rec_t* grown; /* reallocated log */
+
+    frame_writes++;
+    if (PORT_NATIVE != mode) {
+	if (log_len == log_cap && PORT_LOG_MAX > log_cap) {
+	    grown = realloc (log_buf, (0 == log_cap ? 4096 : 2 * log_cap) *
+				      sizeof (*log_buf));
+	    if (NULL != grown) {
+		log_buf = grown;
+		log_cap = (0 == log_cap ? 4096 : 2 * log_cap);
+	    }
+	}
+	if (log_len < log_cap) {
+	    log_buf[log_len].port = port;
+	    log_buf[log_len].val = val;
+	    log_buf[log_len].width = width;
+	    log_len++;
+	} else {
+	    log_lost++;
+	}
+    }
+    if (PORT_MOCK != mode) {
+	if (1 == width) {
+	    native_outb (port, val);
+	} else {
+	    native_outw (port, val);
+	}
+    }
+}
+
+
+/*
+ * port_init
+ *   DESCRIPTION: Choose the port I/O mode, forget all shadowed register
+ *                values, and empty the log.
+ *   INPUTS: m -- the mode
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void
+port_init (port_mode_t m)
+{
+    mode = m;
+    port_invalidate ();
+    port_log_clear ();
+
+    /* Registers that can be written without side effects. */
+    group[0].merge[0x02] = 1;	/* sequencer map mask          */
+    group[1].merge[0x05] = 1;	/* graphics mode               */
+    group[1].merge[0x08] = 1;	/* graphics bit mask           */
+    group[2].merge[0x0C] = 1;	/* CRTC start address high     */
+    group[2].merge[0x0D] = 1;	/* CRTC start address low      */
+}
+
+
+/*
+ * port_mode_from_env
+ *   DESCRIPTION: Get the port I/O mode named by ADVENTURE_PORT.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: the mode (PORT_NATIVE if unset or unknown)
+ *   SIDE EFFECTS: none
+ */
+port_mode_t
+port_mode_from_env ()
+{
+    const char* name = getenv ("ADVENTURE_PORT"); /* mode name */
+
+    if (NULL != name && 0 == strcmp (name, "record")) {
+        return PORT_RECORD;
+    }
+    if (NULL != name && 0 == strcmp (name, "mock")) {
+        return PORT_MOCK;
+    }
+    return PORT_NATIVE;
+}
+
+
+/*
+ * port_mode
+ *   DESCRIPTION: Get the current port I/O mode.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: the mode
+ *   SIDE EFFECTS: none
+ */
+port_mode_t
+port_mode ()
+{
+    return mode;
+}
+
+
+/*
+ * port_invalidate
+ *   DESCRIPTION: Forget all shadowed register values, so that the next
+ *                write to each register is issued.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void
+port_invalidate ()
+{
+    int i; /* index over port pairs */
+
+    for (i = 0; NUM_PORT_GROUPS > i; i++) {
+	(void)memset (group[i].valid, 0, sizeof (group[i].valid));
+    }
+}
+
+
+/*
+ * port_outb
+ *   DESCRIPTION: Write a byte to a port.  Byte writes are never merged,
+ *                but are tracked in the shadow registers.
+ *   INPUTS: port -- I/O port
+ *           val -- value to write
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: port I/O
+ */
+void
+port_outb (uint16_t port, uint8_t val)
+{
+    port_group_t* g;	   /* shadowed port pair, if any */
+    int           is_data; /* port is a data port        */
+
+    if (NULL != (g = find_group (port, &is_data))) {
+	if (is_data) {
+	    g->val[g->hw_index] = val;
+	    g->valid[g->hw_index] = 1;
+	} else {
+	    g->hw_index = val;
+	}
+    }
+    issue (port, val, 1);
+}
+
+
+/*
+ * port_outw
+ *   DESCRIPTION: Write a word to a port pair: the low byte selects a
+ *                register, and the high byte is written to it.  The write
+ *                is dropped if the register may be merged and already
+ *                holds the value.
+ *   INPUTS: port -- index port of the pair
+ *           val -- index (low byte) and data (high byte)
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: port I/O
+ */
+void
+port_outw (uint16_t port, uint16_t val)
+{
+    port_group_t* g;	   /* shadowed port pair, if any */
+    int           is_data; /* port is a data port        */
+    uint8_t       idx;	   /* register index             */
+
+    if (NULL != (g = find_group (port, &is_data)) && !is_data) {
+	idx = (val & 0xFF);
+	if (g->merge[idx] && g->valid[idx] && (val >> 8) == g->val[idx]) {
+	    frame_merged++;
+	    return;
+	}
+	g->hw_index = idx;
+	g->val[idx] = (val >> 8);
+	g->valid[idx] = 1;
+    }
+    issue (port, val, 2);
+}
+
+
+/*
+ * mock_input_status
+ *   DESCRIPTION: Simulate the VGA input status register: bit 3 is set
+ *                during vertical sync and bit 0 during vertical blanking,
+ *                at 70 Hz on the monotonic clock.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: the register value
+ *   SIDE EFFECTS: none
+ */
+static uint8_t
+mock_input_status ()
+{
+    struct timespec now; /* current time            */
+    long            pos; /* microseconds into frame */
+
+    (void)clock_gettime (CLOCK_MONOTONIC, &now);
+    pos = (long)(((uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000) % 
+		 MOCK_FRAME_USEC);
+    if (MOCK_RETRACE_USEC > pos) {
+        return 0x09;
+    }
+    if (MOCK_BLANK_USEC > pos) {
+        return 0x01;
+    }
+    return 0x00;
+}
+
+
+/*
+ * port_inb
+ *   DESCRIPTION: Read a byte from a port.  In mock mode, data ports of
+ *                shadowed pairs return the last value written, the input
+ *                status register follows simulated display timing, and 
+ *                other ports return 0.
+ *   INPUTS: port -- I/O port
+ *   OUTPUTS: none
+ *   RETURN VALUE: the value read
+ *   SIDE EFFECTS: port I/O (reading some VGA ports changes their state)
+ */
+uint8_t
+port_inb (uint16_t port)
+{
+    port_group_t* g;	   /* shadowed port pair, if any */
+    int           is_data; /* port is a data port        */
+
+    if (PORT_MOCK != mode) {
+        return native_inb (port);
+    }
+    if (NULL != (g = find_group (port, &is_data)) && is_data) {
+        return g->val[g->hw_index];
+    }
+    if (0x03DA == port) {
+        return mock_input_status ();
+    }
+    return 0;
+}
+
+
+
+/*
+ * port_outsb
+ *   DESCRIPTION: Write an array of bytes to one port.
+ *   INPUTS: port -- I/O port
+ *           src -- bytes to write
+ *           n -- number of bytes
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: port I/O
+ */
+void
+port_outsb (uint16_t port, const uint8_t* src, int n)
+{
+    for (; 0 < n; n--) {
+        port_outb (port, *src++);
+    }
+}
+
+
+/*
+ * port_outsw
+ *   DESCRIPTION: Write an array of words to a port pair.
+ *   INPUTS: port -- index port of the pair
+ *           src -- words to write
+ *           n -- number of words
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: port I/O
+ */
+void
+port_outsw (uint16_t port, const uint16_t* src, int n)
+{
+    for (; 0 < n; n--) {
+        port_outw (port, *src++);
+    }
+}
+
+
+/*
+ * port_frame_end
+ *   DESCRIPTION: Fold the current frame's write counts into the totals.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void
+port_frame_end ()
+{
+    n_frames++;
+    total_writes += frame_writes;
+    total_merged += frame_merged;
+    if (max_writes < frame_writes) {
+        max_writes = frame_writes;
+    }
+    frame_writes = frame_merged = 0;
+}
+
+
+/*
+ * port_log
+ *   DESCRIPTION: Get the log of writes issued in record and mock modes.
+ *   INPUTS: none
+ *   OUTPUTS: *n -- number of writes in log
+ *   RETURN VALUE: pointer to the log
+ *   SIDE EFFECTS: none
+ */
+const port_rec_t*
+port_log (int32_t* n)
+{
+    *n = log_len;
+    return log_buf;
+}
+
+
+/*
+ * port_log_clear
+ *   DESCRIPTION: Empty the log of writes.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void
+port_log_clear ()
+{
+    log_len = 0;
+    log_lost = 0;
+}
+
+
+/*
+ * port_report
+ *   DESCRIPTION: Print port writes per frame, if any frames were shown.
+ *   INPUTS: f -- output stream
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void
+port_report (FILE* f)
+{
+    if (0 == n_frames) {
+        return;
+    }
+    fprintf (f, "port I/O: %u frames, %.1f writes/frame (max %u), "
+	     "%.1f merged/frame\n", n_frames, (double)total_writes / n_frames,
+	     max_writes, (double)total_merged / n_frames);
+    if (PORT_NATIVE != mode) {
+	fprintf (f, "port I/O: %d writes logged, %u not logged\n", log_len,
+		 log_lost);
+    }
+}
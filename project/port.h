@@ -0,0 +1,114 @@
+/*									tab:8
+ *
+ * port.h - header file for VGA port I/O
+ *
+ * "Copyright (c) 2026 by Tianzuo Qin."
+ *
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation for any purpose, without fee, and without written agreement is
+ * hereby granted, provided that the above copyright notice and the following
+ * two paragraphs appear in all copies of this software.
+ *
+ * IN NO EVENT SHALL THE AUTHOR OR THE UNIVERSITY OF ILLINOIS BE LIABLE TO
+ * ANY PARTY FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL
+ * DAMAGES ARISING OUT  OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+ * EVEN IF THE AUTHOR AND/OR THE UNIVERSITY OF ILLINOIS HAS BEEN ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THE AUTHOR AND THE UNIVERSITY OF ILLINOIS SPECIFICALLY DISCLAIM ANY
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE
+ * PROVIDED HEREUNDER IS ON AN "AS IS" BASIS, AND NEITHER THE AUTHOR NOR
+ * THE UNIVERSITY OF ILLINOIS HAS ANY OBLIGATION TO PROVIDE MAINTENANCE,
+ * SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS."
+ *
+ * Author:	    Tianzuo Qin
+ * Version:	    1
+ * Creation Date:   Sun Oct 18 16:40:07 2026
+ * Filename:	    port.h
+ * History:
+ *	TQ	1	Sun Oct 18 16:40:07 2026
+ *		First written.
+ */
+#ifndef PORT_H
+#define PORT_H
+
+
+#include <stdint.h>
+#include <stdio.h>
+
+
+/*
+ * All VGA register traffic goes through the functions below.  Under
+ * virtualization each port write traps, so the layer keeps a shadow copy
+ * of registers that have no side effects when written (the sequencer map
+ * mask and the CRTC start address) and drops writes that would not change
+ * them.  Writes are counted per frame (see port_frame_end).
+ *
+ * The layer runs in one of three modes, chosen by the ADVENTURE_PORT
+ * environment variable when the VGA backend is opened:
+ *
+ *   native -- write to the hardware (the default)
+ *   record -- write to the hardware and log every write issued
+ *   mock   -- log every write without touching the hardware; reads
+ *             return the last value written, except that the input
+ *             status register (0x3DA) simulates 70 Hz display timing
+ *
+ * The log holds the writes actually issued (after merging), in order, and
+ * can be compared against expected register traffic.  If ADVENTURE_PORT_LOG
+ * names a file, the game writes the log there as text when it exits.
+ */
+typedef enum {
+    PORT_NATIVE,
+    PORT_RECORD,
+    PORT_MOCK
+} port_mode_t;
+
+/* one logged port write */
+typedef struct port_rec_t port_rec_t;
+struct port_rec_t {
+    uint16_t port;	/* I/O port written                  */
+    uint16_t val;	/* value written                     */
+    uint8_t  width;	/* 1 for a byte write, 2 for a word  */
+};
+
+/* Choose the mode and forget all shadowed register values. */
+extern void port_init (port_mode_t mode);
+
+/* Get the mode named by ADVENTURE_PORT (native if unset or unknown). */
+extern port_mode_t port_mode_from_env (void);
+
+/* Get the current mode. */
+extern port_mode_t port_mode (void);
+
+/* Forget shadowed register values (e.g., after a mode set). */
+extern void port_invalidate (void);
+
+/* Write a byte to a port. */
+extern void port_outb (uint16_t port, uint8_t val);
+
+/* Write a word (index in low byte, data in high byte) to a port pair. */
+extern void port_outw (uint16_t port, uint16_t val);
+
+/* Read a byte from a port. */
+extern uint8_t port_inb (uint16_t port);
+
+/* Write an array of bytes to one port. */
+extern void port_outsb (uint16_t port, const uint8_t* src, int n);
+
+/* Write an array of words to a port pair. */
+extern void port_outsw (uint16_t port, const uint16_t* src, int n);
+
+/* Mark the end of a frame for the per-frame write counts. */
+extern void port_frame_end (void);
+
+/* Get the log of writes (record and mock modes); sets *n to its length. */
+extern const port_rec_t* port_log (int32_t* n);
+
+/* Empty the log. */
+extern void port_log_clear (void);
+
+/* Print the per-frame port write report (if any frames were shown). */
+extern void port_report (FILE* f);
+
+#endif /* PORT_H */
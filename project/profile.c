@@ -0,0 +1,309 @@
+/*									tab:8
+ *
+ * profile.c - per-tick phase profiler with latency histograms
+ *
+ * "Copyright (c) 2026 by Tianzuo Qin."
+ *
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation for any purpose, without fee, and without written agreement is
+ * hereby granted, provided that the above copyright notice and the following
+ * two paragraphs appear in all copies of this software.
+ *
+ * IN NO EVENT SHALL THE AUTHOR OR THE UNIVERSITY OF ILLINOIS BE LIABLE TO
+ * ANY PARTY FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL
+ * DAMAGES ARISING OUT  OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+ * EVEN IF THE AUTHOR AND/OR THE UNIVERSITY OF ILLINOIS HAS BEEN ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THE AUTHOR AND THE UNIVERSITY OF ILLINOIS SPECIFICALLY DISCLAIM ANY
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE
+ * PROVIDED HEREUNDER IS ON AN "AS IS" BASIS, AND NEITHER THE AUTHOR NOR
+ * THE UNIVERSITY OF ILLINOIS HAS ANY OBLIGATION TO PROVIDE MAINTENANCE,
+ * SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS."
+ *
+ * Author:	    Tianzuo Qin
+ * Version:	    1
+ * Creation Date:   Sun Oct 18 23:15:40 2026
+ * Filename:	    profile.c
+ * History:
+ *	TQ	1	Sun Oct 18 23:15:40 2026
+ *		First written.
+ */
+
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "assert.h"
+#include "profile.h"
+
+#if defined(PROFILE)
+
+
+/*
+ * Histogram geometry: times below 2 * PROF_SUB_BUCKETS nanoseconds have
+ * a bucket each; above that, each power of two is split into 
+ * PROF_SUB_BUCKETS buckets.  PROF_BUCKETS covers times up to 2^40 ns 
+ * (about eighteen minutes); longer times fall into the last bucket.
+ */
+#define PROF_SUB_BITS    4
+#define PROF_SUB_BUCKETS (1 << PROF_SUB_BITS)
+#define PROF_MAX_BITS    40
+#define PROF_BUCKETS     ((PROF_MAX_BITS - PROF_SUB_BITS + 1) * \
+			  PROF_SUB_BUCKETS)
+
+/* a latency histogram */
+typedef struct prof_hist_t prof_hist_t;
+struct prof_hist_t {
+    uint64_t count;			/* times counted          */
+    uint64_t sum;			/* total time (ns)        */
+    uint64_t max;			/* longest time (ns)      */
+    uint32_t bucket[PROF_BUCKETS];	/* times in each range    */
+};
+
+
+/* local functions--see function headers for details */
+static void catch_usr1 (int sig);
+static uint32_t bucket_of (uint64_t nsec);
+static uint64_t bucket_top (uint32_t b);
+static uint64_t percentile (const prof_hist_t* h, double pct);
+
+
+/* file-scope variables */
+
+/* 
+ * One histogram per phase.  Each phase is recorded by only one thread,
+ * so the counts need no locks; a report printed while other threads 
+ * record may be off by the times being recorded.
+ */
+static prof_hist_t hist[NUM_PROF_PHASES];
+
+/* set by SIGUSR1, cleared when the histograms are printed */
+static volatile sig_atomic_t report_asked;
+
+/* phase names for prof_report */
+static const char* const phase_name[NUM_PROF_PHASES] = {
+    "tick wait", "ticks", "input poll", "tux buttons", "commands",
+    "status text", "publish view", "prep room", "view window",
+    "draw lines", "status bar", "show screen"
+};
+
+
+/*
+ * prof_init
+ *   DESCRIPTION: Arrange for the histograms to be printed (by prof_poll)
+ *                when SIGUSR1 is received.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: sets the behavior of SIGUSR1
+ */
+void
+prof_init ()
+{
+    struct sigaction sa;   /* signal behavior definition structure */
+
+    (void)memset (&sa, 0, sizeof (sa));
+    sa.sa_handler = catch_usr1;
+    (void)sigemptyset (&sa.sa_mask);
+    if (-1 == sigaction (SIGUSR1, &sa, NULL))
+        PANIC ("writing signal action failed");
+}
+
+
+/*
+ * prof_poll
+ *   DESCRIPTION: Print the histograms if SIGUSR1 has been received since
+ *                they were last printed.  Printing is left to the game 
+ *                loop, as it is not safe in a signal handler.
+ *   INPUTS: f -- output stream
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: may print to f
+ */
+void
+prof_poll (FILE* f)
+{
+    if (report_asked) {
+	report_asked = 0;
+	prof_report (f);
+	(void)fflush (f);
+    }
+}
+
+
+/*
+ * prof_report
+ *   DESCRIPTION: Print the number of times, the mean, median, 90th, 
+ *                99th, and 99.9th percentiles, and the maximum time of
+ *                each phase timed, in microseconds.
+ *   INPUTS: f -- output stream
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: prints to f
+ */
+void
+prof_report (FILE* f)
+{
+    const prof_hist_t* h;  /* histogram of a phase */
+    int32_t p;             /* index over phases    */
+
+    fprintf (f, "profile (us):   %8s %9s %9s %9s %9s %9s %9s\n", "count",
+	     "mean", "p50", "p90", "p99", "p99.9", "max");
+    for (p = 0; NUM_PROF_PHASES > p; p++) {
+	h = &hist[p];
+	if (0 == h->count) {
+	    continue;
+	}
+	fprintf (f, "  %-13s %8llu %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f\n",
+		 phase_name[p], (unsigned long long)h->count,
+		 h->sum / 1e3 / h->count, percentile (h, 0.5) / 1e3,
+		 percentile (h, 0.9) / 1e3, percentile (h, 0.99) / 1e3,
+		 percentile (h, 0.999) / 1e3, h->max / 1e3);
+    }
+}
+
+
+/*
+ * prof_now
+ *   DESCRIPTION: Get the current time for timing a phase.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: the time in nanoseconds (CLOCK_MONOTONIC)
+ *   SIDE EFFECTS: none
+ */
+uint64_t
+prof_now ()
+{
+    struct timespec t;	/* current time */
+
+    (void)clock_gettime (CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+
+/*
+ * prof_record
+ *   DESCRIPTION: Count one time for a phase.
+ *   INPUTS: phase -- the phase timed
+ *           nsec -- the time taken in nanoseconds
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: changes the phase's histogram
+ */
+void
+prof_record (prof_phase_t phase, uint64_t nsec)
+{
+    prof_hist_t* h = &hist[phase];  /* histogram of the phase */
+
+    h->count++;
+    h->sum += nsec;
+    if (h->max < nsec) {
+        h->max = nsec;
+    }
+    h->bucket[bucket_of (nsec)]++;
+}
+
+
+/*
+ * catch_usr1
+ *   DESCRIPTION: Ask for the histograms to be printed.
+ *   INPUTS: sig -- the signal received (SIGUSR1)
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: sets report_asked
+ */
+static void
+catch_usr1 (int sig)
+{
+    report_asked = 1;
+}
+
+
+/*
+ * bucket_of
+ *   DESCRIPTION: Find the histogram bucket for a time.  Times below 
+ *                2 * PROF_SUB_BUCKETS have their own buckets; a longer 
+ *                time with highest bit e falls into one of the 
+ *                PROF_SUB_BUCKETS buckets for e, chosen by the 
+ *                PROF_SUB_BITS bits below its highest bit.
+ *   INPUTS: nsec -- the time in nanoseconds
+ *   OUTPUTS: none
+ *   RETURN VALUE: the bucket index
+ *   SIDE EFFECTS: none
+ */
+static uint32_t
+bucket_of (uint64_t nsec)
+{
+    uint32_t e;  /* index of highest bit set */
+
+    if (2 * PROF_SUB_BUCKETS > nsec) {
+        return nsec;
+    }
+    e = 63 - __builtin_clzll (nsec);
+    if (PROF_MAX_BITS <= e) {
+        return PROF_BUCKETS - 1;
+    }
+    return (e - PROF_SUB_BITS) * PROF_SUB_BUCKETS + 
+	   (nsec >> (e - PROF_SUB_BITS));
+}
+
+
+/*
+ * bucket_top
+ *   DESCRIPTION: Find the longest time that falls into a bucket.
+ *   INPUTS: b -- the bucket index
+ *   OUTPUTS: none
+ *   RETURN VALUE: the longest time in the bucket, in nanoseconds
+ *   SIDE EFFECTS: none
+ */
+static uint64_t
+bucket_top (uint32_t b)
+{
+    uint32_t e;     /* highest bit of times in bucket  */
+    uint64_t mant;  /* top bits of times in bucket     */
+
+    if (2 * PROF_SUB_BUCKETS > b) {
+        return b;
+    }
+    e = b / PROF_SUB_BUCKETS + PROF_SUB_BITS - 1;
+    mant = b % PROF_SUB_BUCKETS + PROF_SUB_BUCKETS;
+    return ((mant + 1) << (e - PROF_SUB_BITS)) - 1;
+}
+
+
+/*
+ * percentile
+ *   DESCRIPTION: Find a time no shorter than a given fraction of the 
+ *                times in a histogram.  The result is the longest time
+ *                in the bucket reached, but no longer than the maximum.
+ *   INPUTS: h -- the histogram (not empty)
+ *           pct -- the fraction (0 to 1)
+ *   OUTPUTS: none
+ *   RETURN VALUE: the time in nanoseconds
+ *   SIDE EFFECTS: none
+ */
+static uint64_t
+percentile (const prof_hist_t* h, double pct)
+{
+    uint64_t want;  /* times to reach     */
+    uint64_t seen;  /* times passed       */
+    uint32_t b;     /* index over buckets */
+
+    want = (uint64_t)(pct * h->count + 0.5);
+    if (1 > want) {
+        want = 1;
+    }
+    for (b = 0, seen = 0; PROF_BUCKETS > b; b++) {
+	seen += h->bucket[b];
+	if (want <= seen) {
+	    break;
+	}
+    }
+    return (h->max < bucket_top (b) ? h->max : bucket_top (b));
+}
+
+#endif /* PROFILE */
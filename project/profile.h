@@ -0,0 +1,105 @@
+/*									tab:8
+ *
+ * profile.h - header file for the per-tick phase profiler
+ *
+ * "Copyright (c) 2026 by Tianzuo Qin."
+ *
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation for any purpose, without fee, and without written agreement is
+ * hereby granted, provided that the above copyright notice and the following
+ * two paragraphs appear in all copies of this software.
+ *
+ * IN NO EVENT SHALL THE AUTHOR OR THE UNIVERSITY OF ILLINOIS BE LIABLE TO
+ * ANY PARTY FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL
+ * DAMAGES ARISING OUT  OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+ * EVEN IF THE AUTHOR AND/OR THE UNIVERSITY OF ILLINOIS HAS BEEN ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THE AUTHOR AND THE UNIVERSITY OF ILLINOIS SPECIFICALLY DISCLAIM ANY
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE
+ * PROVIDED HEREUNDER IS ON AN "AS IS" BASIS, AND NEITHER THE AUTHOR NOR
+ * THE UNIVERSITY OF ILLINOIS HAS ANY OBLIGATION TO PROVIDE MAINTENANCE,
+ * SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS."
+ *
+ * Author:	    Tianzuo Qin
+ * Version:	    1
+ * Creation Date:   Sun Oct 18 23:15:40 2026
+ * Filename:	    profile.h
+ * History:
+ *	TQ	1	Sun Oct 18 23:15:40 2026
+ *		First written.
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+
+#include <stdint.h>
+#include <stdio.h>
+
+
+/*
+ * Building with PROFILE defined ("make clean; make PROFILE=1") times 
+ * each phase of the game's work with clock_gettime, which costs well
+ * under a microsecond, and keeps a latency histogram for each phase.
+ * Histogram buckets cover each power of two in sixteen steps, so that
+ * times from nanoseconds to minutes are kept to within about six 
+ * percent in fixed space.  The histograms are printed at exit, and on
+ * receipt of SIGUSR1.  Without PROFILE, the macros below compile to 
+ * nothing.
+ *
+ * Each phase is timed by one thread: the game loop (waiting, ticks, 
+ * input, commands, status bar text, publishing views), the Tux thread
+ * (button reads), or the render thread (the rest).
+ */
+typedef enum {
+    PROF_WAIT,		/* tick-wait slack (sleeping in epoll_wait)   */
+    PROF_TICKS,		/* simulating ticks (timed events, Tux clock) */
+    PROF_INPUT,		/* polling the keyboard (get_command)         */
+    PROF_BUTTONS,	/* reading Tux buttons (get_button_status)    */
+    PROF_COMMANDS,	/* dispatching queued commands                */
+    PROF_STATUS_TEXT,	/* making the status bar text                 */
+    PROF_PUBLISH,	/* building and publishing a view             */
+    PROF_PREP_ROOM,	/* palette and objects for a redrawn room     */
+    PROF_VIEW_WINDOW,	/* set_view_window                            */
+    PROF_DRAW_LINES,	/* draw_horiz_line and draw_vert_line         */
+    PROF_STATUS_BAR,	/* drawing and uploading the status bar       */
+    PROF_SHOW_SCREEN,	/* show_screen                                */
+    NUM_PROF_PHASES
+} prof_phase_t;
+
+#if defined(PROFILE)
+
+/* Start timing a phase, declaring a variable t to hold the start time. */
+#define PROF_BEGIN(t)      uint64_t t = prof_now ()
+
+/* Finish timing a phase started with PROF_BEGIN(t). */
+#define PROF_END(phase, t) prof_record ((phase), prof_now () - (t))
+
+/* Print the histograms when SIGUSR1 is received. */
+extern void prof_init (void);
+
+/* Print the histograms if SIGUSR1 has been received since the last call. */
+extern void prof_poll (FILE* f);
+
+/* Print the histograms. */
+extern void prof_report (FILE* f);
+
+/* Get the time in nanoseconds (CLOCK_MONOTONIC). */
+extern uint64_t prof_now (void);
+
+/* Count one time for a phase. */
+extern void prof_record (prof_phase_t phase, uint64_t nsec);
+
+#else /* !defined(PROFILE) */
+
+#define PROF_BEGIN(t)
+#define PROF_END(phase, t)
+#define prof_init()
+#define prof_poll(f)
+#define prof_report(f)
+
+#endif /* PROFILE */
+
+#endif /* PROFILE_H */
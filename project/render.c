@@ -0,0 +1,524 @@
+/*									tab:8
+ *
+ * render.c - render thread drawing snapshots of the game view
+ *
+ * "Copyright (c) 2026 by Tianzuo Qin."
+ *
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation for any purpose, without fee, and without written agreement is
+ * hereby granted, provided that the above copyright notice and the following
+ * two paragraphs appear in all copies of this software.
+ *
+ * IN NO EVENT SHALL THE AUTHOR OR THE UNIVERSITY OF ILLINOIS BE LIABLE TO
+ * ANY PARTY FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL
+ * DAMAGES ARISING OUT  OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+ * EVEN IF THE AUTHOR AND/OR THE UNIVERSITY OF ILLINOIS HAS BEEN ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THE AUTHOR AND THE UNIVERSITY OF ILLINOIS SPECIFICALLY DISCLAIM ANY
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE
+ * PROVIDED HEREUNDER IS ON AN "AS IS" BASIS, AND NEITHER THE AUTHOR NOR
+ * THE UNIVERSITY OF ILLINOIS HAS ANY OBLIGATION TO PROVIDE MAINTENANCE,
+ * SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS."
+ *
+ * Author:	    Tianzuo Qin
+ * Version:	    1
+ * Creation Date:   Sun Oct 18 22:08:13 2026
+ * Filename:	    render.c
+ * History:
+ *	TQ	1	Sun Oct 18 22:08:13 2026
+ *		First written.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "modex.h"
+#include "photo.h"
+#include "profile.h"
+#include "render.h"
+#include "trace.h"
+
+
+/* marks the middle buffer as holding a view not yet taken */
+#define VIEW_FRESH 4
+
+/* what drawing a view took */
+typedef enum {
+    DRAWN_STILL,	/* the status bar only (no motion)    */
+    DRAWN_SCROLL,	/* lines exposed by scrolling         */
+    DRAWN_FULL,		/* the whole screen                   */
+    DRAWN_ROOM		/* the whole screen for a new room    */
+} drawn_t;
+
+
+/* local functions--see function headers for details */
+static void* render_thread (void* ignore);
+static int take_view (void);
+static drawn_t draw_view (const view_t* v);
+static long usec_between (const struct timespec* t1, 
+			  const struct timespec* t2);
+
+
+/* file-scope variables */
+
+/*
+ * The three buffers.  The game loop fills view[back], and the render
+ * thread draws view[front]; mid holds the index of the third buffer,
+ * plus VIEW_FRESH if it holds a view not yet taken.  Publishing and 
+ * taking exchange a buffer with the middle one.  Each view's publish 
+ * time and number are kept alongside it in made[] and seq[].
+ */
+static view_t          view[3];
+static struct timespec made[3];
+static uint32_t        seq[3];
+static uint32_t        back = 0;
+static uint32_t        front = 1;
+static uint32_t        mid = 2;
+
+static view_t    shown;		/* view last drawn                  */
+static int       shown_valid;	/* 1 once a view has been drawn     */
+static pthread_t render_id;	/* the render thread                */
+static int       running;	/* 1 while the render thread runs   */
+static int       stopping;	/* 1 when the thread should exit    */
+static int       wake_fd = -1;	/* eventfd written for each view    */
+static int       done_fd = -1;	/* eventfd written after each draw  */
+static uint32_t  drawn_seq;	/* number of the view last drawn    */
+static long      frame_usec;	/* frame period (0 if uncapped)     */
+
+/* statistics for render_report (times in microseconds) */
+static uint32_t num_published;	/* views published                  */
+static uint32_t num_skipped;	/* views replaced before taken      */
+static uint32_t num_drawn;	/* views drawn                      */
+static uint32_t num_dropped;	/* frame times passed while waiting */
+static uint32_t num_idle;	/* wakeups with no view to draw     */
+static double   draw_sum, draw_max;	/* time to draw a view      */
+static double   lag_sum, lag_max;	/* publish to drawn         */
+static uint32_t num_rooms;	/* views drawn for a new room       */
+static double   room_sum, room_max;	/* room entered to drawn    */
+static uint32_t num_scrolls;	/* views drawn only by scrolling    */
+static double   scroll_sum, scroll_max;	/* time to draw a scroll    */
+
+
+/*
+ * render_start
+ *   DESCRIPTION: Read the frame rate cap and start the render thread.
+ *                Mode X must be set first.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, or -1 on failure
+ *   SIDE EFFECTS: reads ADVENTURE_FPS; creates two eventfds and a thread
+ */
+int
+render_start ()
+{
+    const char* fps;	/* render rate cap from environment */
+
+    fps = getenv ("ADVENTURE_FPS");
+    if (NULL != fps && 0 < atoi (fps)) {
+        frame_usec = 1000000L / atoi (fps);
+    }
+    wake_fd = eventfd (0, EFD_CLOEXEC);
+    if (0 > wake_fd) {
+        return -1;
+    }
+    done_fd = eventfd (0, EFD_CLOEXEC);
+    if (0 > done_fd) {
+	(void)close (wake_fd);
+        return -1;
+    }
+    if (0 != pthread_create (&render_id, NULL, render_thread, NULL)) {
+	(void)close (wake_fd);
+	(void)close (done_fd);
+	return -1;
+    }
+    running = 1;
+    return 0;
+}
+
+
+/*
+ * render_stop
+ *   DESCRIPTION: Ask the render thread to exit, and wait until it has,
+ *                so that it is not drawing when mode X is cleared.  The
+ *                thread first draws the newest view, if not yet drawn.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: joins the render thread
+ */
+void
+render_stop ()
+{
+    uint64_t one = 1;	/* eventfd increment */
+
+    if (!running) {
+        return;
+    }
+    __atomic_store_n (&stopping, 1, __ATOMIC_RELEASE);
+    (void)write (wake_fd, &one, sizeof (one));
+    (void)pthread_join (render_id, NULL);
+    (void)close (wake_fd);
+    (void)close (done_fd);
+    running = 0;
+}
+
+
+/*
+ * render_publish
+ *   DESCRIPTION: Hand a view to the render thread, replacing any view 
+ *                published earlier that it has not yet taken.  Never
+ *                waits.  Only the game loop may publish.
+ *   INPUTS: v -- the view
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: wakes the render thread
+ */
+void
+render_publish (const view_t* v)
+{
+    uint32_t old;	/* previous middle buffer */
+    uint64_t one = 1;	/* eventfd increment      */
+
+    view[back] = *v;
+    (void)clock_gettime (CLOCK_MONOTONIC, &made[back]);
+    seq[back] = ++num_published;
+    old = __atomic_exchange_n (&mid, back | VIEW_FRESH, __ATOMIC_ACQ_REL);
+    back = old & ~VIEW_FRESH;
+    if (0 != (old & VIEW_FRESH)) {
+	(void)__atomic_add_fetch (&num_skipped, 1, __ATOMIC_RELAXED);
+    }
+    (void)write (wake_fd, &one, sizeof (one));
+}
+
+
+/*
+ * render_sync
+ *   DESCRIPTION: Wait until the render thread has drawn the last view 
+ *                published, so that no view is skipped.  Only the game
+ *                loop may wait.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void
+render_sync ()
+{
+    uint64_t count;	/* eventfd count (unused) */
+
+    if (!running) {
+        return;
+    }
+    while (num_published != __atomic_load_n (&drawn_seq, __ATOMIC_ACQUIRE)) {
+	while (0 > read (done_fd, &count, sizeof (count)) && 
+	       EINTR == errno) {
+	}
+    }
+}
+
+
+/*
+ * render_counts
+ *   DESCRIPTION: Get the numbers of frames drawn and dropped so far.
+ *   INPUTS: none
+ *   OUTPUTS: drawn -- frames drawn
+ *            dropped -- frame times passed while a view waited
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void
+render_counts (uint32_t* drawn, uint32_t* dropped)
+{
+    *drawn = __atomic_load_n (&num_drawn, __ATOMIC_RELAXED);
+    *dropped = __atomic_load_n (&num_dropped, __ATOMIC_RELAXED);
+}
+
+
+/*
+ * render_report
+ *   DESCRIPTION: Print the frame rate cap, the numbers of views 
+ *                published, skipped, and drawn, wakeups with nothing to
+ *                draw, and the mean and maximum time to draw a view and
+ *                from publishing a view until it was drawn; then the 
+ *                mean and maximum time from entering a room until it 
+ *                was shown, and to draw a scroll step.
+ *   INPUTS: f -- output stream
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: prints to f
+ */
+void
+render_report (FILE* f)
+{
+    if (0 == num_drawn) {
+        return;
+    }
+    if (0 == frame_usec) {
+	fprintf (f, "render: uncapped");
+    } else {
+	fprintf (f, "render: %.0f frames per second cap", 1e6 / frame_usec);
+    }
+    fprintf (f, "; %u views published, %u skipped, %u drawn, %u idle "
+	     "wakeups; draw %.0f us (max %.0f), published to drawn %.0f us "
+	     "(max %.0f)\n", num_published, num_skipped, num_drawn, num_idle,
+	     draw_sum / num_drawn, draw_max, lag_sum / num_drawn, lag_max);
+    fprintf (f, "render: %u new rooms drawn, %.0f us after entry (max %.0f); "
+	     "%u scroll steps, drawn in %.0f us (max %.0f)\n", num_rooms,
+	     (0 == num_rooms ? 0 : room_sum / num_rooms), room_max,
+	     num_scrolls, (0 == num_scrolls ? 0 : scroll_sum / num_scrolls),
+	     scroll_max);
+}
+
+
+/*
+ * render_thread
+ *   DESCRIPTION: Function executed by the render thread.  Waits for a
+ *                view to be published, waits for the next frame time if
+ *                the frame rate is capped, then draws the newest view.
+ *                When stopped, draws the newest view (without waiting)
+ *                if it has not been drawn, then returns.
+ *   INPUTS: none (ignored)
+ *   OUTPUTS: none
+ *   RETURN VALUE: NULL
+ *   SIDE EFFECTS: draws to the screen
+ */
+static void*
+render_thread (void* ignore)
+{
+    struct timespec next_frame;	/* earliest time for next frame */
+    struct timespec now;	/* current time                 */
+    struct timespec start;	/* time drawing started         */
+    uint64_t count;		/* eventfd count (unused)       */
+    uint64_t one = 1;		/* eventfd increment            */
+    long late;			/* time since frame was due     */
+    double usec;		/* time measured                */
+    drawn_t drawn;		/* what drawing the view took   */
+    int stop;			/* 1 if asked to stop           */
+
+    trace_thread ("render");
+    (void)clock_gettime (CLOCK_MONOTONIC, &next_frame);
+    while (1) {
+	/* Sleep until a view is published (or we are stopped). */
+	while (0 > read (wake_fd, &count, sizeof (count)) && 
+	       EINTR == errno) {
+	}
+	stop = __atomic_load_n (&stopping, __ATOMIC_ACQUIRE);
+	if (0 == (__atomic_load_n (&mid, __ATOMIC_ACQUIRE) & VIEW_FRESH)) {
+	    if (stop) {
+		break;
+	    }
+	    num_idle++;
+	    continue;
+	}
+
+	/* 
+	 * With a cap, wait for the next frame time.  A view that arrives
+	 * after its frame time has passed is drawn at once; frame times 
+	 * that pass while a view waits are dropped.
+	 */
+	(void)clock_gettime (CLOCK_MONOTONIC, &now);
+	if (0 != frame_usec && !stop) {
+	    if (0 > usec_between (&next_frame, &now)) {
+		while (EINTR == clock_nanosleep (CLOCK_MONOTONIC, 
+						 TIMER_ABSTIME, &next_frame,
+						 NULL)) {
+		}
+		(void)clock_gettime (CLOCK_MONOTONIC, &now);
+	    }
+	}
+
+	/* Take the newest view, and draw it. */
+	(void)take_view ();
+	if (0 != frame_usec) {
+	    if (0 < usec_between (&next_frame, &made[front])) {
+		next_frame = made[front];
+	    }
+	    late = usec_between (&next_frame, &now);
+	    (void)__atomic_add_fetch (&num_dropped, late / frame_usec,
+				      __ATOMIC_RELAXED);
+	    next_frame = now;
+	    next_frame.tv_nsec += frame_usec * 1000;
+	    while (1000000000 <= next_frame.tv_nsec) {
+		next_frame.tv_sec++;
+		next_frame.tv_nsec -= 1000000000;
+	    }
+	}
+	start = now;
+	TRACE_BEGIN (draw_start);
+	drawn = draw_view (&view[front]);
+	TRACE_END ("render", NULL, draw_start);
+
+	/* 
+	 * Record the time to draw (and so to draw a scroll step), from 
+	 * publishing to drawn, and from entering a new room to drawn.  
+	 * Then let the game loop know, in case it waits for the view.
+	 */
+	(void)clock_gettime (CLOCK_MONOTONIC, &now);
+	usec = usec_between (&start, &now);
+	draw_sum += usec;
+	if (draw_max < usec) {
+	    draw_max = usec;
+	}
+	if (DRAWN_SCROLL == drawn) {
+	    num_scrolls++;
+	    scroll_sum += usec;
+	    if (scroll_max < usec) {
+		scroll_max = usec;
+	    }
+	}
+	usec = usec_between (&made[front], &now);
+	lag_sum += usec;
+	if (lag_max < usec) {
+	    lag_max = usec;
+	}
+	if (DRAWN_ROOM == drawn) {
+	    usec = usec_between (&view[front].entered, &now);
+	    num_rooms++;
+	    room_sum += usec;
+	    if (room_max < usec) {
+		room_max = usec;
+	    }
+	}
+	(void)__atomic_add_fetch (&num_drawn, 1, __ATOMIC_RELAXED);
+	__atomic_store_n (&drawn_seq, seq[front], __ATOMIC_RELEASE);
+	(void)write (done_fd, &one, sizeof (one));
+	if (stop) {
+	    break;
+	}
+    }
+    return NULL;
+}
+
+
+/*
+ * take_view
+ *   DESCRIPTION: Take the newest view published, if not yet taken, as
+ *                the view to draw (view[front]).
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if a new view was taken, or 0 if not
+ *   SIDE EFFECTS: changes front
+ */
+static int
+take_view ()
+{
+    uint32_t old;	/* previous middle buffer */
+
+    if (0 == (__atomic_load_n (&mid, __ATOMIC_ACQUIRE) & VIEW_FRESH)) {
+        return 0;
+    }
+    old = __atomic_exchange_n (&mid, front, __ATOMIC_ACQ_REL);
+    front = old & ~VIEW_FRESH;
+    return 1;
+}
+
+
+/*
+ * draw_view
+ *   DESCRIPTION: Draw a view.  A new room or photo sets up its palette;
+ *                a new room, photo, overview mode, or object generation
+ *                redraws the whole screen; otherwise, only the lines 
+ *                exposed by moving the view window since the last view
+ *                drawn are drawn.  The status bar and screen are then 
+ *                shown.
+ *   INPUTS: v -- the view
+ *   OUTPUTS: none
+ *   RETURN VALUE: what was drawn
+ *   SIDE EFFECTS: draws to the build buffer and the screen
+ */
+static drawn_t
+draw_view (const view_t* v)
+{
+    int32_t dx, dy;	/* motion of view window     */
+    int32_t i;		/* index over lines to draw  */
+    int full;		/* 1 to redraw all lines     */
+    drawn_t drawn;	/* what was drawn            */
+
+    /* Set up a new room or photo. */
+    PROF_BEGIN (prep_start);
+    full = 0;
+    drawn = DRAWN_STILL;
+    if (!shown_valid || shown.room_gen != v->room_gen || 
+	shown.photo != v->photo || shown.overview != v->overview) {
+	set_overview (v->overview);
+	prep_room (v->photo);
+	full = 1;
+    }
+    if (full || shown.obj_gen != v->obj_gen) {
+	set_room_objects (v->obj, v->n_objs);
+	full = 1;
+	PROF_END (PROF_PREP_ROOM, prep_start);
+    }
+
+    /* Move the view window and draw what it exposes. */
+    dx = v->map_x - shown.map_x;
+    dy = v->map_y - shown.map_y;
+    PROF_BEGIN (window_start);
+    set_view_window (v->map_x, v->map_y);
+    PROF_END (PROF_VIEW_WINDOW, window_start);
+    PROF_BEGIN (lines_start);
+    if (full || SCROLL_X_DIM <= abs (dx) || SCROLL_Y_DIM <= abs (dy)) {
+	for (i = 0; SCROLL_Y_DIM > i; i++) {
+	    (void)draw_horiz_line (i);
+	}
+	drawn = (!shown_valid || shown.room_gen != v->room_gen ? 
+		 DRAWN_ROOM : DRAWN_FULL);
+    } else {
+	if (0 != dx || 0 != dy) {
+	    drawn = DRAWN_SCROLL;
+	}
+	for (i = 0; -dy > i; i++) {
+	    (void)draw_horiz_line (i);
+	}
+	for (i = 1; dy >= i; i++) {
+	    (void)draw_horiz_line (SCROLL_Y_DIM - i);
+	}
+	for (i = 0; -dx > i; i++) {
+	    (void)draw_vert_line (i);
+	}
+	for (i = 1; dx >= i; i++) {
+	    (void)draw_vert_line (SCROLL_X_DIM - i);
+	}
+    }
+    PROF_END (PROF_DRAW_LINES, lines_start);
+
+    /* Show the screen after the status bar so that frames include both. */
+    PROF_BEGIN (status_start);
+    show_status_bar (v->status);
+    PROF_END (PROF_STATUS_BAR, status_start);
+    PROF_BEGIN (screen_start);
+    TRACE_BEGIN (screen_trace);
+    show_screen ();
+    TRACE_END ("show_screen", NULL, screen_trace);
+    PROF_END (PROF_SHOW_SCREEN, screen_start);
+
+    shown = *v;
+    shown_valid = 1;
+    return drawn;
+}
+
+
+/*
+ * usec_between
+ *   DESCRIPTION: Find the time from one time to a second time.
+ *   INPUTS: t1 -- the first time
+ *           t2 -- the second time
+ *   OUTPUTS: none
+ *   RETURN VALUE: microseconds from t1 to t2 (negative if t2 is earlier)
+ *   SIDE EFFECTS: none
+ */
+static long
+usec_between (const struct timespec* t1, const struct timespec* t2)
+{
+    return (t2->tv_sec - t1->tv_sec) * 1000000L + 
+	   (t2->tv_nsec - t1->tv_nsec) / 1000;
+}
@@ -0,0 +1,102 @@
+/*									tab:8
+ *
+ * render.h - header file for the render thread
+ *
+ * "Copyright (c) 2026 by Tianzuo Qin."
+ *
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation for any purpose, without fee, and without written agreement is
+ * hereby granted, provided that the above copyright notice and the following
+ * two paragraphs appear in all copies of this software.
+ *
+ * IN NO EVENT SHALL THE AUTHOR OR THE UNIVERSITY OF ILLINOIS BE LIABLE TO
+ * ANY PARTY FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL
+ * DAMAGES ARISING OUT  OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+ * EVEN IF THE AUTHOR AND/OR THE UNIVERSITY OF ILLINOIS HAS BEEN ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THE AUTHOR AND THE UNIVERSITY OF ILLINOIS SPECIFICALLY DISCLAIM ANY
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE
+ * PROVIDED HEREUNDER IS ON AN "AS IS" BASIS, AND NEITHER THE AUTHOR NOR
+ * THE UNIVERSITY OF ILLINOIS HAS ANY OBLIGATION TO PROVIDE MAINTENANCE,
+ * SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS."
+ *
+ * Author:	    Tianzuo Qin
+ * Version:	    1
+ * Creation Date:   Sun Oct 18 22:08:13 2026
+ * Filename:	    render.h
+ * History:
+ *	TQ	1	Sun Oct 18 22:08:13 2026
+ *		First written.
+ */
+#ifndef RENDER_H
+#define RENDER_H
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "modex.h"
+#include "photo.h"
+
+
+/*
+ * The game loop and the screen run at their own paces on separate 
+ * threads.  After handling input and timed events, the game loop 
+ * describes what the screen should show in a view_t and publishes it
+ * whenever it changes; the render thread, which alone draws to the
+ * screen once started, draws the newest view published.  Views pass
+ * between the threads through three buffers without locks: the game
+ * loop fills one, the render thread draws from another, and the third
+ * holds the newest view not yet taken.  A view published before the
+ * previous one was taken replaces it, so a slow render thread skips
+ * views rather than delaying the game loop, and the skips are counted.
+ *
+ * The ADVENTURE_FPS environment variable caps the render rate (for 
+ * example, at 30 or 60 frames per second); unset, "0", or "uncapped"
+ * draws each view as soon as it can.  Frame times that pass while a 
+ * view waits to be drawn are counted as dropped frames.
+ *
+ * Each view drawn for a new room_gen is timed from when the room was
+ * entered until it is shown, and each view drawn only by scrolling is
+ * timed as a scroll step, for render_report.
+ */
+
+/* what the screen shows */
+typedef struct view_t view_t;
+struct view_t {
+    const photo_t* photo;		/* room photo                   */
+    uint32_t       room_gen;		/* changes on entering a room   */
+    struct timespec entered;		/* time room_gen last changed   */
+    uint32_t       obj_gen;		/* changes to redraw the room   */
+    int32_t        map_x, map_y;	/* upper left display pixel     */
+    int32_t        overview;		/* 1 if whole room is shown     */
+    int32_t        n_objs;		/* objects in the room          */
+    view_obj_t     obj[PHOTO_MAX_OBJS];
+    unsigned char  status[STATUS_BAR_CELLS]; /* status bar text     */
+};
+
+/* Start the render thread; returns 0 on success, or -1 on failure. */
+extern int render_start (void);
+
+/* Stop the render thread after it finishes drawing. */
+extern void render_stop (void);
+
+/* Hand a view to the render thread (game loop only). */
+extern void render_publish (const view_t* v);
+
+/* Wait until the last view published has been drawn (game loop only). */
+extern void render_sync (void);
+
+/* Get the numbers of frames drawn and dropped so far. */
+extern void render_counts (uint32_t* drawn, uint32_t* dropped);
+
+/* 
+ * Print the frame rate cap, views skipped, and render, room change, and
+ * scroll step times.
+ */
+extern void render_report (FILE* f);
+
+#endif /* RENDER_H */
@@ -0,0 +1,524 @@
+/*									tab:8
+ *
+ * replay.c - recording and replaying input for repeatable runs
+ *
+ * "Copyright (c) 2026 by Tianzuo Qin."
+ *
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation for any purpose, without fee, and without written agreement is
+ * hereby granted, provided that the above copyright notice and the following
+ * two paragraphs appear in all copies of this software.
+ *
+ * IN NO EVENT SHALL THE AUTHOR OR THE UNIVERSITY OF ILLINOIS BE LIABLE TO
+ * ANY PARTY FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL
+ * DAMAGES ARISING OUT  OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+ * EVEN IF THE AUTHOR AND/OR THE UNIVERSITY OF ILLINOIS HAS BEEN ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THE AUTHOR AND THE UNIVERSITY OF ILLINOIS SPECIFICALLY DISCLAIM ANY
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE
+ * PROVIDED HEREUNDER IS ON AN "AS IS" BASIS, AND NEITHER THE AUTHOR NOR
+ * THE UNIVERSITY OF ILLINOIS HAS ANY OBLIGATION TO PROVIDE MAINTENANCE,
+ * SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS."
+ *
+ * Author:	    Tianzuo Qin
+ * Version:	    1
+ * Creation Date:   Sun Oct 18 23:58:37 2026
+ * Filename:	    replay.c
+ * History:
+ *	TQ	1	Sun Oct 18 23:58:37 2026
+ *		First written.
+ */
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "input.h"
+#include "replay.h"
+
+
+/* recording header */
+#define REPLAY_MAGIC   "ADVR"
+#define REPLAY_VERSION 1
+typedef struct replay_hdr_t replay_hdr_t;
+struct replay_hdr_t {
+    char     magic[4];	/* REPLAY_MAGIC           */
+    uint32_t version;	/* REPLAY_VERSION         */
+    uint32_t seed;	/* seed passed to srand   */
+};
+
+/* bytes of a record before its typed command */
+#define REPLAY_REC_SIZE 6
+
+/* local functions--see function headers for details */
+static int read_route (size_t len, uint32_t* seed);
+static int add_record (unsigned char** buf, size_t* size, size_t* len,
+		       uint32_t tick, cmd_t cmd, const char* typed);
+
+
+/* file-scope variables */
+
+static const char* rec_name;	/* recording being made (or NULL)  */
+static FILE*       rec_file;	/* recording being made            */
+static char        rec_typed[MAX_TYPED_LEN + 1]; /* as last recorded */
+
+static const char*    play_name;  /* recording replayed (or NULL)  */
+static unsigned char* play_buf;	  /* whole recording               */
+static size_t         play_len;	  /* bytes in recording            */
+static size_t         play_pos;	  /* offset of next record         */
+static int            play_fast;  /* 1 to replay as fast as can be */
+static int            play_step;  /* 1 to draw every view, too     */
+static int            play_ended; /* 1 once the end is replayed    */
+
+static uint32_t cur_tick;	/* last tick simulated             */
+static uint32_t num_events;	/* records written or replayed     */
+static uint32_t num_bytes;	/* bytes written or replayed       */
+
+
+/*
+ * replay_init
+ *   DESCRIPTION: Start replaying the recording (or route) named by 
+ *                ADVENTURE_REPLAY, or start recording to the file named
+ *                by ADVENTURE_RECORD.  Call before srand.
+ *   INPUTS: seed -- the seed for srand
+ *   OUTPUTS: seed -- the recorded seed, if replaying
+ *   RETURN VALUE: 0 on success, or -1 on failure (after printing why)
+ *   SIDE EFFECTS: reads ADVENTURE_REPLAY, ADVENTURE_REPLAY_SPEED, and
+ *                 ADVENTURE_RECORD; reads or creates a file
+ */
+int
+replay_init (uint32_t* seed)
+{
+    replay_hdr_t hdr;   /* recording header      */
+    const char* speed;  /* replay speed from env */
+    FILE* f;            /* recording replayed    */
+    long len;           /* length of recording   */
+
+    play_name = getenv ("ADVENTURE_REPLAY");
+    if (NULL != play_name && '\0' != *play_name) {
+	if (NULL == (f = fopen (play_name, "rb")) ||
+	    0 != fseek (f, 0, SEEK_END) || 
+	    sizeof (hdr) > (len = ftell (f)) ||
+	    0 != fseek (f, 0, SEEK_SET) ||
+	    NULL == (play_buf = malloc (len)) ||
+	    1 != fread (play_buf, len, 1, f)) {
+	    perror (play_name);
+	    if (NULL != f) {
+		(void)fclose (f);
+	    }
+	    return -1;
+	}
+	(void)fclose (f);
+	(void)memcpy (&hdr, play_buf, sizeof (hdr));
+	if (0 != memcmp (hdr.magic, REPLAY_MAGIC, sizeof (hdr.magic))) {
+	    /* Not a recording, so try it as a route. */
+	    if (0 != read_route (len, seed)) {
+		return -1;
+	    }
+	} else if (REPLAY_VERSION != hdr.version) {
+	    fprintf (stderr, "%s is not a recording.\n", play_name);
+	    return -1;
+	} else {
+	    *seed = hdr.seed;
+	    play_len = len;
+	}
+	play_pos = sizeof (hdr);
+	num_bytes = sizeof (hdr);
+	speed = getenv ("ADVENTURE_REPLAY_SPEED");
+	play_step = (NULL != speed && 0 == strcmp (speed, "step"));
+	play_fast = (play_step || 
+		     (NULL != speed && 0 == strcmp (speed, "fast")));
+	return 0;
+    }
+    play_name = NULL;
+
+    rec_name = getenv ("ADVENTURE_RECORD");
+    if (NULL != rec_name && '\0' != *rec_name) {
+	(void)memcpy (hdr.magic, REPLAY_MAGIC, sizeof (hdr.magic));
+	hdr.version = REPLAY_VERSION;
+	hdr.seed = *seed;
+	if (NULL == (rec_file = fopen (rec_name, "wb")) ||
+	    1 != fwrite (&hdr, sizeof (hdr), 1, rec_file)) {
+	    perror (rec_name);
+	    return -1;
+	}
+	num_bytes = sizeof (hdr);
+    }
+    return 0;
+}
+
+
+/*
+ * replay_close
+ *   DESCRIPTION: Finish and close the recording being made, if any.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: closes the recording
+ */
+void
+replay_close ()
+{
+    if (NULL != rec_file) {
+	if (0 != fclose (rec_file)) {
+	    perror (rec_name);
+	}
+	rec_file = NULL;
+    }
+}
+
+
+/*
+ * replay_tick
+ *   DESCRIPTION: Set the number of the last tick simulated, which is 
+ *                recorded with each event, or which events replayed 
+ *                must wait for.
+ *   INPUTS: tick -- the tick number
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void
+replay_tick (uint32_t tick)
+{
+    cur_tick = tick;
+}
+
+
+/*
+ * replay_record
+ *   DESCRIPTION: If recording, record a command with the typed command
+ *                when it was handled, or record a change to the typed
+ *                command (when cmd is CMD_NONE).
+ *   INPUTS: cmd -- the command handled, or CMD_NONE
+ *           typed -- the typed command
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: writes to the recording
+ */
+void
+replay_record (cmd_t cmd, const char* typed)
+{
+    unsigned char rec[REPLAY_REC_SIZE];  /* record before typed command */
+    uint8_t len;                         /* length of typed command     */
+
+    if (NULL == rec_file ||
+	(CMD_NONE == cmd && 0 == strcmp (typed, rec_typed))) {
+        return;
+    }
+    len = strlen (typed);
+    (void)memcpy (rec, &cur_tick, sizeof (cur_tick));
+    rec[4] = cmd;
+    rec[5] = len;
+    if (1 != fwrite (rec, sizeof (rec), 1, rec_file) ||
+	len != fwrite (typed, 1, len, rec_file)) {
+	perror (rec_name);
+	(void)fclose (rec_file);
+	rec_file = NULL;
+	return;
+    }
+    (void)strcpy (rec_typed, typed);
+    num_events++;
+    num_bytes += sizeof (rec) + len;
+}
+
+
+/*
+ * replay_playing
+ *   DESCRIPTION: Check whether a recording is being replayed.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if replaying, 0 if not
+ *   SIDE EFFECTS: none
+ */
+int
+replay_playing ()
+{
+    return (NULL != play_name);
+}
+
+
+/*
+ * replay_fast
+ *   DESCRIPTION: Check whether a recording is being replayed as fast 
+ *                as possible.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if replaying fast, 0 if not
+ *   SIDE EFFECTS: none
+ */
+int
+replay_fast ()
+{
+    return (NULL != play_name && play_fast);
+}
+
+
+/*
+ * replay_step
+ *   DESCRIPTION: Check whether a recording is being replayed as fast 
+ *                as possible, but with every view published drawn.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if replaying in steps, 0 if not
+ *   SIDE EFFECTS: none
+ */
+int
+replay_step ()
+{
+    return (NULL != play_name && play_step);
+}
+
+
+/*
+ * replay_next
+ *   DESCRIPTION: Replay the recorded events due by the current tick, up
+ *                to and including the next command.  A truncated record
+ *                ends the recording.
+ *   INPUTS: none
+ *   OUTPUTS: typed -- the typed command, as recorded
+ *   RETURN VALUE: the command replayed; CMD_NONE if none is due yet; or
+ *                 CMD_QUIT (only once) if the recording has ended
+ *   SIDE EFFECTS: advances through the recording
+ */
+cmd_t
+replay_next (char typed[MAX_TYPED_LEN + 1])
+{
+    uint32_t tick;  /* tick of record            */
+    cmd_t cmd;      /* command recorded          */
+    uint8_t len;    /* length of typed command   */
+
+    while (!play_ended) {
+	if (play_len < play_pos + REPLAY_REC_SIZE) {
+	    break;
+	}
+	(void)memcpy (&tick, &play_buf[play_pos], sizeof (tick));
+	cmd = play_buf[play_pos + 4];
+	len = play_buf[play_pos + 5];
+	if (play_len < play_pos + REPLAY_REC_SIZE + len ||
+	    MAX_TYPED_LEN < len || NUM_COMMANDS <= cmd) {
+	    break;
+	}
+	if (tick > cur_tick) {
+	    return CMD_NONE;
+	}
+	(void)memcpy (typed, &play_buf[play_pos + REPLAY_REC_SIZE], len);
+	typed[len] = '\0';
+	play_pos += REPLAY_REC_SIZE + len;
+	num_events++;
+	num_bytes += REPLAY_REC_SIZE + len;
+	if (CMD_NONE != cmd) {
+	    return cmd;
+	}
+    }
+
+    /* The recording has ended; quit. */
+    if (play_ended) {
+        return CMD_NONE;
+    }
+    play_ended = 1;
+    return CMD_QUIT;
+}
+
+
+/*
+ * replay_report
+ *   DESCRIPTION: Print the number of events and bytes recorded or 
+ *                replayed, if any.
+ *   INPUTS: f -- output stream
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: prints to f
+ */
+void
+replay_report (FILE* f)
+{
+    if (NULL != play_name) {
+	fprintf (f, "replay: %u events (%u bytes) from %s, %s speed\n",
+		 num_events, num_bytes, play_name, 
+		 (play_step ? "step" : (play_fast ? "fast" : "real")));
+    } else if (NULL != rec_name && '\0' != *rec_name) {
+	fprintf (f, "record: %u events (%u bytes) to %s\n", num_events,
+		 num_bytes, rec_name);
+    }
+}
+
+
+/*
+ * read_route
+ *   DESCRIPTION: Turn the route (see replay.h) read into play_buf into 
+ *                a recording, which replaces it.
+ *   INPUTS: len -- bytes of route in play_buf
+ *   OUTPUTS: seed -- the seed given by the route (or 1)
+ *   RETURN VALUE: 0 on success, or -1 on failure (after printing why)
+ *   SIDE EFFECTS: replaces play_buf and sets play_len
+ */
+static int
+read_route (size_t len, uint32_t* seed)
+{
+    static const char* const cmd_word[NUM_COMMANDS] = {
+	NULL, "right", "left", "up", "down", "move_left", "enter", 
+	"move_right", "type", "quit"
+    };
+    replay_hdr_t hdr;	    /* recording header             */
+    unsigned char* rec;	    /* recording made               */
+    size_t rec_size;	    /* bytes allocated to rec       */
+    size_t rec_len;	    /* bytes of rec used            */
+    char* text;		    /* route, NUL-terminated        */
+    char* line;		    /* current line                 */
+    char* next;		    /* line after current line      */
+    char* word;		    /* first word of line           */
+    char* arg;		    /* rest of line                 */
+    char* end;		    /* end of line or of number     */
+    uint32_t tick;	    /* tick of next command         */
+    unsigned long n;	    /* number given                 */
+    int line_num;	    /* line number, for errors      */
+    int cmd;		    /* command named by word        */
+
+    /* Make the route a string. */
+    if (NULL == (text = realloc (play_buf, len + 1))) {
+	perror (play_name);
+	return -1;
+    }
+    play_buf = NULL;
+    text[len] = '\0';
+
+    rec_size = 4096;
+    if (NULL == (rec = malloc (rec_size))) {
+	perror (play_name);
+	free (text);
+	return -1;
+    }
+    rec_len = sizeof (hdr);
+    *seed = 1;
+    tick = 1;
+    for (line = text, line_num = 1; NULL != line; line = next, line_num++) {
+	/* Cut off the line, and any comment and trailing space. */
+	if (NULL != (next = strchr (line, '\n'))) {
+	    *next++ = '\0';
+	}
+	if (NULL != (end = strchr (line, '#'))) {
+	    *end = '\0';
+	}
+	end = line + strlen (line);
+	while (line < end && isspace (end[-1])) {
+	    *--end = '\0';
+	}
+
+	/* Split the line into a word and the rest. */
+	for (word = line; isspace (*word); word++) {
+	}
+	if ('\0' == *word) {
+	    continue;
+	}
+	for (arg = word; '\0' != *arg && !isspace (*arg); arg++) {
+	}
+	if ('\0' != *arg) {
+	    *arg++ = '\0';
+	    while (isspace (*arg)) {
+		arg++;
+	    }
+	}
+
+	/* Type the rest of the line. */
+	if (0 == strcmp (word, cmd_word[CMD_TYPED])) {
+	    if (MAX_TYPED_LEN < strlen (arg) ||
+		0 != add_record (&rec, &rec_size, &rec_len, tick++, 
+				 CMD_TYPED, arg)) {
+		break;
+	    }
+	    continue;
+	}
+
+	/* Everything else takes a number, which may be optional. */
+	n = 1;
+	if ('\0' != *arg) {
+	    n = strtoul (arg, &end, 10);
+	    if ('\0' != *end) {
+		break;
+	    }
+	}
+	if (0 == strcmp (word, "seed")) {
+	    *seed = n;
+	    continue;
+	}
+	if (0 == strcmp (word, "wait")) {
+	    tick += n;
+	    continue;
+	}
+	for (cmd = CMD_NONE + 1; NUM_COMMANDS > cmd; cmd++) {
+	    if (0 == strcmp (word, cmd_word[cmd])) {
+		break;
+	    }
+	}
+	if (NUM_COMMANDS == cmd) {
+	    break;
+	}
+	for (; 0 < n; n--) {
+	    if (0 != add_record (&rec, &rec_size, &rec_len, tick++, cmd, "")) {
+		break;
+	    }
+	}
+	if (0 < n) {
+	    break;
+	}
+    }
+    free (text);
+    if (NULL != line) {
+	fprintf (stderr, "%s:%d: cannot follow route (see replay.h)\n", 
+		 play_name, line_num);
+	free (rec);
+	return -1;
+    }
+
+    /* Start the recording with a header. */
+    (void)memcpy (hdr.magic, REPLAY_MAGIC, sizeof (hdr.magic));
+    hdr.version = REPLAY_VERSION;
+    hdr.seed = *seed;
+    (void)memcpy (rec, &hdr, sizeof (hdr));
+    play_buf = rec;
+    play_len = rec_len;
+    return 0;
+}
+
+
+/*
+ * add_record
+ *   DESCRIPTION: Add a record to a recording being made in memory.
+ *   INPUTS: buf -- the recording
+ *           size -- bytes allocated to the recording
+ *           len -- bytes of the recording used
+ *           tick -- tick of the record
+ *           cmd -- command recorded
+ *           typed -- typed command recorded
+ *   OUTPUTS: buf, size, len -- the recording, with the record added
+ *   RETURN VALUE: 0 on success, or -1 on failure (after printing why)
+ *   SIDE EFFECTS: may reallocate *buf
+ */
+static int
+add_record (unsigned char** buf, size_t* size, size_t* len, uint32_t tick,
+	    cmd_t cmd, const char* typed)
+{
+    unsigned char* grown;   /* reallocated recording     */
+    uint8_t typed_len;	    /* length of typed command   */
+
+    typed_len = strlen (typed);
+    if (*size < *len + REPLAY_REC_SIZE + typed_len) {
+	if (NULL == (grown = realloc (*buf, *size * 2))) {
+	    perror (play_name);
+	    return -1;
+	}
+	*buf = grown;
+	*size *= 2;
+    }
+    (void)memcpy (*buf + *len, &tick, sizeof (tick));
+    (*buf)[*len + 4] = cmd;
+    (*buf)[*len + 5] = typed_len;
+    (void)memcpy (*buf + *len + REPLAY_REC_SIZE, typed, typed_len);
+    *len += REPLAY_REC_SIZE + typed_len;
+    return 0;
+}
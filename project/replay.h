@@ -0,0 +1,117 @@
+/*									tab:8
+ *
+ * replay.h - header file for recording and replaying input
+ *
+ * "Copyright (c) 2026 by Tianzuo Qin."
+ *
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation for any purpose, without fee, and without written agreement is
+ * hereby granted, provided that the above copyright notice and the following
+ * two paragraphs appear in all copies of this software.
+ *
+ * IN NO EVENT SHALL THE AUTHOR OR THE UNIVERSITY OF ILLINOIS BE LIABLE TO
+ * ANY PARTY FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL
+ * DAMAGES ARISING OUT  OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+ * EVEN IF THE AUTHOR AND/OR THE UNIVERSITY OF ILLINOIS HAS BEEN ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THE AUTHOR AND THE UNIVERSITY OF ILLINOIS SPECIFICALLY DISCLAIM ANY
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE
+ * PROVIDED HEREUNDER IS ON AN "AS IS" BASIS, AND NEITHER THE AUTHOR NOR
+ * THE UNIVERSITY OF ILLINOIS HAS ANY OBLIGATION TO PROVIDE MAINTENANCE,
+ * SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS."
+ *
+ * Author:	    Tianzuo Qin
+ * Version:	    1
+ * Creation Date:   Sun Oct 18 23:58:37 2026
+ * Filename:	    replay.h
+ * History:
+ *	TQ	1	Sun Oct 18 23:58:37 2026
+ *		First written.
+ */
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "input.h"
+
+
+/*
+ * Setting ADVENTURE_RECORD to a file name records the seed given to 
+ * srand and every player command, in the order in which the game loop
+ * handles them, along with the typed command as it changes, each with
+ * the number of the tick after which it was handled.  Setting 
+ * ADVENTURE_REPLAY to such a file plays the game again with the same
+ * seed (and so the same object placement) by feeding the recorded 
+ * input back through get_command, after the same ticks; the keyboard
+ * is then ignored, except for the backquote that quits, and the Tux
+ * buttons are not read.  The game quits when the recording ends.
+ * Replay runs at real speed unless ADVENTURE_REPLAY_SPEED is "fast", 
+ * in which case the game loop simulates ticks as fast as it can 
+ * instead of waiting for them, or "step", in which case it also waits 
+ * for each view it publishes to be drawn, so that no view is skipped
+ * and a replay always draws the same frames.
+ *
+ * A recording is a header followed by one record per event, in the
+ * byte order of the machine that made it:
+ *
+ *   header: "ADVR", uint32_t version (1), uint32_t seed
+ *   record: uint32_t tick, uint8_t command (cmd_t), uint8_t length,
+ *           then length bytes of typed command (no NUL)
+ *
+ * Typed command records (with command CMD_NONE) are written only when
+ * the typed command changes, so most records take six bytes.
+ *
+ * ADVENTURE_REPLAY may instead name a route: a text file, written by
+ * hand, that is turned into a recording when read.  Each line holds one
+ * of the following (a '#' starts a comment):
+ *
+ *   seed N           the seed for srand (1 if not given)
+ *   wait N           let N ticks pass
+ *   COMMAND [N]      issue a command N times (once if N is not given);
+ *                    COMMAND is right, left, up, down, move_left, 
+ *                    enter, move_right, or quit
+ *   type TEXT        type TEXT and press enter
+ *
+ * Each command is issued one tick after the one before it.
+ */
+
+/* 
+ * Open a recording or replay as requested.  Records *seed, or replaces
+ * it with the recorded seed; returns 0 on success, or -1 on failure.
+ */
+extern int replay_init (uint32_t* seed);
+
+/* Write any recording out and close it. */
+extern void replay_close (void);
+
+/* Set the number of the last tick simulated. */
+extern void replay_tick (uint32_t tick);
+
+/* Record a command or a change to the typed command, if recording. */
+extern void replay_record (cmd_t cmd, const char* typed);
+
+/* 1 if replaying a recording */
+extern int replay_playing (void);
+
+/* 1 if replaying as fast as possible */
+extern int replay_fast (void);
+
+/* 1 if replaying as fast as possible, drawing every view */
+extern int replay_step (void);
+
+/* 
+ * Get the next recorded command due by the current tick, setting the
+ * typed command as recorded; returns CMD_NONE if none is due.
+ */
+extern cmd_t replay_next (char typed[MAX_TYPED_LEN + 1]);
+
+/* Print the number of events recorded or replayed. */
+extern void replay_report (FILE* f);
+
+#endif /* REPLAY_H */
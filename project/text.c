@@ -44,10 +44,10 @@ const int two1440 = 2880; /* offset of plane 2 */
 const int three1440 = 4320; /* offset of plane 3 */
 const int seven = 7; /* there are 0-7 bits */
 const int wordh16 = 16; /* the word height is sixteen */
-const int barl40 = 40; /* the length of the bar is 40 */
+const int rowbytes80 = 80; /* each line of a plane is 80 bytes */
 const int totplanes4 = 4; /* the number of total plane is 4 */
-const unsigned char background_color = 0x37;  /* the background of status bar I chose is 0x37 */
-const unsigned char font_color = 0x2C; /* the font_color I chose is 0x2C */
+static unsigned char background_color = 0x37;  /* the background of status bar I chose is 0x37 */
+static unsigned char font_color = 0x2C; /* the font_color I chose is 0x2C */
 /* 
  * These font data were read out of video memory during text mode and
  * saved here.  They could be read in the same manner at the start of a
@@ -575,96 +575,104 @@ unsigned char font_data[256][16] = {
 /* plane 1 to plane 4 offset */
 
 
+/*
+ * The glyph atlas holds, for each character and font line, the two bytes
+ * that the line's eight pixels put in each of the four planes (pixels
+ * 0 and 4 in plane 0, and so on), in the status bar colors.  It is built
+ * when first needed and again after the colors change.
+ */
+static unsigned char glyph_atlas[256][16][4][2];
+static int atlas_valid = 0; /* 1 if glyph_atlas matches the colors */
+
+
+/*
+ * set_text_colors
+ *   DESCRIPTION: Change the status bar colors.  The glyph atlas is 
+ *                rebuilt when next used.
+ *   INPUTS: fg -- font color
+ *           bg -- background color
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if the colors changed, 0 if not
+ *   SIDE EFFECTS: none
+ */
+
+int set_text_colors(unsigned char fg, unsigned char bg){
+    if(fg == font_color && bg == background_color){
+        return 0;
+    }
+    font_color = fg;
+    background_color = bg;
+    atlas_valid = 0;
+    return 1;
+}
+
+
+/*
+ * build_atlas
+ *   DESCRIPTION: Fill the glyph atlas from the font in the current colors.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: modify glyph_atlas
+ */
+
+static void build_atlas(){
+    int ch = 0;
+    int j = 0;
+    int b = seven;
+    for( ch = 0; ch < 256; ch++){
+        for( j = 0; j < wordh16; j++){
+            unsigned char linebit = font_data[ch][j];
+            /* pixel (seven - b) goes to plane (seven - b) % 4, byte / 4 */
+            for( b = seven; b >= 0; b--){
+                glyph_atlas[ch][j][(seven - b) % totplanes4][(seven - b) >> 2] =
+                    ((linebit & (1 << b)) ? font_color : background_color);
+            }
+        }
+    }
+    atlas_valid = 1;
+}
+
+
 /*
  * text2graphic
- *   DESCRIPTION: Show the text on the statusbar.
- *   INPUTS: char* status_bar_input, char* status_bar_buf
- *   OUTPUTS: status_bar_buf
- *   RETURN VALUE: status_bar_buf
- *   SIDE EFFECTS: modify status_bar_buf
+ *   DESCRIPTION: Show the text on the statusbar: draw the cells first to
+ *                first + n - 1 (each 8 pixels wide, with an empty line 
+ *                above and below the font) into the status bar image.
+ *                Each line of a cell is four two-byte copies from the
+ *                glyph atlas.
+ *   INPUTS: status_bar_input -- 40 characters
+ *           first -- first cell to draw
+ *           n -- number of cells to draw
+ *   OUTPUTS: status_bar_buf -- four planes, 80 bytes per line
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: modify status_bar_buf; may rebuild the glyph atlas
  */  
 
-unsigned char* text2graphic(unsigned char* status_bar_input, unsigned char* status_bar_buf){
-     int plane_offset[4] = {zero1440,one1440,two1440,three1440};
+void text2graphic(const unsigned char* status_bar_input, 
+		  unsigned char* status_bar_buf, int first, int n){
+     const int plane_offset[4] = {zero1440,one1440,two1440,three1440};
+     unsigned char blank[2] = {background_color, background_color};
      int j = 0;
      int k = 0;
-     int b = seven;
-     /* Do it by line */
-     /* the first empty line */
-     for( k = 0; k < barl40; k++){
-        unsigned char uch = 0;
-        /* jth line, get the line bit*/
-        unsigned char linebit = font_data[uch][j];
-        /* decide which plane to place (start with plane 0)*/
-        int whichplane = 0;
-        /* loop for eight bit */
-        for( b = seven; b >=0 ; b --){
-            /* get the temporary bit value */
-            int thisbit = (linebit & (1 << b));
-            /* prepare for the input color */
-            unsigned char input_color = background_color;
-            if(thisbit){
-               input_color = font_color;
-            }
-            /* plus offset and update offset*/
-            status_bar_buf[plane_offset[whichplane]] = input_color; 
-            plane_offset[whichplane] ++;
-            /* plane update */
-            whichplane ++;
-            whichplane %= totplanes4;
-        }
-    }
-     for( j = 0; j < wordh16; j++){
-         /* For each line, we push each big line into the different planes */
+     int p = 0;
+     if(!atlas_valid){
+         build_atlas();
+     }
+     /* Do it by line: the empty line, sixteen font lines, the empty line */
+     for( j = 0; j < wordh16 + 2; j++){
          /* scan for each character */
-         for( k = 0; k < barl40; k++){
-            unsigned char uch = status_bar_input[k];
-            /* jth line, get the line bit*/
-            unsigned char linebit = font_data[uch][j];
-            /* decide which plane to place (start with plane 0)*/
-            int whichplane = 0;
-            /* loop for eight bit */
-            for( b = seven; b >=0 ; b --){
-                /* get the temporary bit value */
-                int thisbit = (linebit & (1 << b));
-                /* prepare for the input color */
-                unsigned char input_color = background_color;
-                if(thisbit){
-                    input_color = font_color;
+         for( k = first; k < first + n; k++){
+            /* the cell's two bytes in each plane of line j */
+            unsigned char* dst = status_bar_buf + j * rowbytes80 + k * 2;
+            for( p = 0; p < totplanes4; p++){
+                if(j >= 1 && j <= wordh16){
+                    memcpy(dst + plane_offset[p],
+                           glyph_atlas[status_bar_input[k]][j - 1][p], 2);
+                }else{
+                    memcpy(dst + plane_offset[p], blank, 2);
                 }
-                /* plus offset and update offset*/
-                status_bar_buf[plane_offset[whichplane]] = input_color; 
-                plane_offset[whichplane] ++;
-                /* plane update */
-                whichplane ++;
-                whichplane %= totplanes4;
             }
          }
      }
-      /* Do it by line */
-     /* the last empty line */
-     for( k = 0; k < barl40; k++){
-        unsigned char uch = 0;
-        /* jth line, get the line bit*/
-        unsigned char linebit = font_data[uch][j];
-        /* decide which plane to place (start with plane 0)*/
-        int whichplane = 0;
-        /* loop for eight bit */
-        for( b = seven; b >=0 ; b --){
-            /* get the temporary bit value */
-            int thisbit = (linebit & (1 << b));
-            /* prepare for the input color */
-            unsigned char input_color = background_color;
-            if(thisbit){
-               input_color = font_color;
-            }
-            /* plus offset and update offset*/
-            status_bar_buf[plane_offset[whichplane]] = input_color; 
-            plane_offset[whichplane] ++;
-            /* plane update */
-            whichplane ++;
-            whichplane %= totplanes4;
-        }
-    }
-    return status_bar_buf;
 }
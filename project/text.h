@@ -43,7 +43,11 @@
 /* Standard VGA text font. */
 extern unsigned char font_data[256][16];
 
-/* convert text to graphic */
-extern unsigned char* text2graphic(unsigned char* status_bar_input, unsigned char* status_bar_buf);
+/* change the status bar colors; returns 1 if they changed, 0 if not */
+extern int set_text_colors (unsigned char fg, unsigned char bg);
+
+/* convert n characters of text, starting at cell first, to graphic */
+extern void text2graphic (const unsigned char* status_bar_input, 
+			  unsigned char* status_bar_buf, int first, int n);
 
 #endif /* TEXT_H */
@@ -0,0 +1,523 @@
+/*									tab:8
+ *
+ * tile.c - tile cache for streaming tiled room photos
+ *
+ * "Copyright (c) 2026 by Tianzuo Qin."
+ *
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation for any purpose, without fee, and without written agreement is
+ * hereby granted, provided that the above copyright notice and the following
+ * two paragraphs appear in all copies of this software.
+ *
+ * IN NO EVENT SHALL THE AUTHOR OR THE UNIVERSITY OF ILLINOIS BE LIABLE TO
+ * ANY PARTY FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL
+ * DAMAGES ARISING OUT  OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+ * EVEN IF THE AUTHOR AND/OR THE UNIVERSITY OF ILLINOIS HAS BEEN ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THE AUTHOR AND THE UNIVERSITY OF ILLINOIS SPECIFICALLY DISCLAIM ANY
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE
+ * PROVIDED HEREUNDER IS ON AN "AS IS" BASIS, AND NEITHER THE AUTHOR NOR
+ * THE UNIVERSITY OF ILLINOIS HAS ANY OBLIGATION TO PROVIDE MAINTENANCE,
+ * SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS."
+ *
+ * Author:	    Tianzuo Qin
+ * Version:	    1
+ * Creation Date:   Sun Oct 18 10:12:40 2026
+ * Filename:	    tile.c
+ * History:
+ *	TQ	1	Sun Oct 18 10:12:40 2026
+ *		First written.
+ */
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "assert.h"
+#include "photo.h"
+#include "photo_headers.h"
+#include "tile.h"
+
+
+#define TILE_PIXELS (PHOTO_TILE_DIM * PHOTO_TILE_DIM)
+
+/* An open tiled photo. */
+struct tile_src_t {
+    int            fd;		/* file descriptor for tile reads     */
+    uint32_t       data_off;	/* file offset of first tile          */
+    const photo_t* photo;	/* photo (for dimensions and colors)  */
+    int32_t        tiles_x;	/* number of tile columns             */
+    int32_t        tiles_y;	/* number of tile rows                */
+    int32_t        last_rect[4]; /* last prefetch request, in tiles   */
+};
+
+/* states of a tile cache slot */
+typedef enum {
+    TILE_EMPTY,		/* holds nothing                       */
+    TILE_LOADING,	/* being read; must not be evicted     */
+    TILE_READY		/* holds valid pixels; may be evicted  */
+} tile_state_t;
+
+/* One tile cache slot. */
+typedef struct tile_slot_t tile_slot_t;
+struct tile_slot_t {
+    tile_src_t*  src;			/* photo to which tile belongs     */
+    int32_t      tx, ty;		/* tile column and row             */
+    tile_state_t state;			/* slot state                      */
+    uint32_t     last_use;		/* time stamp for LRU replacement  */
+    uint8_t      pix[TILE_PIXELS];	/* palette indices, row by row     */
+};
+
+/* A prefetch request. */
+typedef struct tile_req_t tile_req_t;
+struct tile_req_t {
+    tile_src_t* src;	/* photo to which tile belongs */
+    int32_t     tx, ty;	/* tile column and row         */
+};
+
+
+/* local functions--see function headers for details */
+static tile_slot_t* tile_claim (void);
+static tile_slot_t* tile_find (const tile_src_t* src, int32_t tx, int32_t ty);
+static tile_slot_t* tile_get (tile_src_t* src, int32_t tx, int32_t ty);
+static void tile_load (tile_slot_t* s, tile_src_t* src, int32_t tx,
+		       int32_t ty);
+static void* tile_thread (void* ignore);
+
+
+/*
+ * The cache, the prefetch queue, and the statistics are all protected by
+ * tile_lock.  Tile reads from disk are done without holding the lock; the
+ * slot being loaded is marked TILE_LOADING so that nobody evicts it.
+ * Threads waiting for a slot to finish loading wait on tile_cv; the
+ * helper thread waits on req_cv for prefetch requests.
+ */
+static pthread_mutex_t tile_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  tile_cv = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t  req_cv = PTHREAD_COND_INITIALIZER;
+static tile_slot_t     slot[TILE_CACHE_SLOTS];
+static uint32_t        use_clock;
+static tile_req_t      queue[TILE_QUEUE_LEN];
+static int32_t         q_head, q_count;
+static pthread_t       tile_thread_id;
+static int32_t         n_sources;
+
+/* cache statistics */
+static uint32_t stat_hits;	/* tile found in cache                    */
+static uint32_t stat_stalls;	/* caller read the tile from disk itself  */
+static uint32_t stat_waits;	/* caller waited on an in-flight prefetch */
+static uint32_t stat_prefetched; /* tiles read by the helper thread      */
+static uint32_t stat_dropped;	/* prefetch requests lost to a full queue */
+
+
+/*
+ * tile_src_open
+ *   DESCRIPTION: Open a tiled photo file for streaming.  The photo's
+ *                palette and color map must already be computed.  Starts
+ *                the prefetch helper thread on first use.
+ *   INPUTS: fname -- tiled photo file name
+ *           data_off -- file offset of the first tile
+ *           p -- the photo to be streamed
+ *   OUTPUTS: none
+ *   RETURN VALUE: pointer to a new tile source, or NULL on failure
+ *   SIDE EFFECTS: opens a file; dynamically allocates the tile source
+ */
+tile_src_t*
+tile_src_open (const char* fname, uint32_t data_off, const photo_t* p)
+{
+    tile_src_t* src;	/* new tile source */
+
+    if (NULL == (src = malloc (sizeof (*src)))) {
+        return NULL;
+    }
+    if (-1 == (src->fd = open (fname, O_RDONLY))) {
+	free (src);
+        return NULL;
+    }
+    src->data_off = data_off;
+    src->photo = p;
+    src->tiles_x = (photo_width (p) + PHOTO_TILE_DIM - 1) / PHOTO_TILE_DIM;
+    src->tiles_y = (photo_height (p) + PHOTO_TILE_DIM - 1) / PHOTO_TILE_DIM;
+    src->last_rect[0] = src->last_rect[2] = -1;
+
+    (void)pthread_mutex_lock (&tile_lock);
+    if (0 == n_sources++ &&
+	0 != pthread_create (&tile_thread_id, NULL, tile_thread, NULL)) {
+	(void)pthread_mutex_unlock (&tile_lock);
+	PANIC ("failed to create tile prefetch thread");
+    }
+    (void)pthread_mutex_unlock (&tile_lock);
+
+    return src;
+}
+
+
+/*
+ * tile_fill_horiz
+ *   DESCRIPTION: Copy a run of pixels from one row of a tiled photo.
+ *                Pixels outside of the photo are set to 0.
+ *   INPUTS: src -- tile source
+ *           (x,y) -- leftmost pixel of the run
+ *           len -- number of pixels in the run
+ *   OUTPUTS: buf -- the pixels
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: may block to read tiles that are not cached
+ */
+void
+tile_fill_horiz (tile_src_t* src, int x, int y, int len, unsigned char* buf)
+{
+    int32_t      width;	/* photo width in pixels                 */
+    int32_t      idx;	/* index over pixels in run              */
+    int32_t      px;	/* photo column of current pixel         */
+    int32_t      run;	/* pixels available from the current tile */
+    tile_slot_t* s;	/* tile holding current pixel            */
+
+    width = photo_width (src->photo);
+    (void)pthread_mutex_lock (&tile_lock);
+    for (idx = 0; len > idx; idx += run) {
+	px = x + idx;
+	if (0 > y || photo_height (src->photo) <= y || 0 > px || width <= px) {
+	    buf[idx] = 0;
+	    run = 1;
+	    continue;
+	}
+	run = PHOTO_TILE_DIM - px % PHOTO_TILE_DIM;
+	if (len - idx < run) {
+	    run = len - idx;
+	}
+	if (width - px < run) {
+	    run = width - px;
+	}
+	s = tile_get (src, px / PHOTO_TILE_DIM, y / PHOTO_TILE_DIM);
+	memcpy (&buf[idx], &s->pix[PHOTO_TILE_DIM * (y % PHOTO_TILE_DIM) +
+				   px % PHOTO_TILE_DIM], run);
+    }
+    (void)pthread_mutex_unlock (&tile_lock);
+}
+
+
+/*
+ * tile_fill_vert
+ *   DESCRIPTION: Copy a run of pixels from one column of a tiled photo.
+ *                Pixels outside of the photo are set to 0.
+ *   INPUTS: src -- tile source
+ *           (x,y) -- top pixel of the run
+ *           len -- number of pixels in the run
+ *   OUTPUTS: buf -- the pixels
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: may block to read tiles that are not cached
+ */
+void
+tile_fill_vert (tile_src_t* src, int x, int y, int len, unsigned char* buf)
+{
+    int32_t        height; /* photo height in pixels                  */
+    int32_t        idx;	   /* index over pixels in run                */
+    int32_t        py;	   /* photo row of current pixel              */
+    int32_t        run;	   /* pixels available from the current tile  */
+    tile_slot_t*   s;	   /* tile holding current pixel              */
+    const uint8_t* pix;	   /* current pixel within tile               */
+
+    height = photo_height (src->photo);
+    (void)pthread_mutex_lock (&tile_lock);
+    for (idx = 0; len > idx; ) {
+	py = y + idx;
+	if (0 > x || photo_width (src->photo) <= x || 0 > py || height <= py) {
+	    buf[idx++] = 0;
+	    continue;
+	}
+	run = PHOTO_TILE_DIM - py % PHOTO_TILE_DIM;
+	if (len - idx < run) {
+	    run = len - idx;
+	}
+	if (height - py < run) {
+	    run = height - py;
+	}
+	s = tile_get (src, x / PHOTO_TILE_DIM, py / PHOTO_TILE_DIM);
+	pix = &s->pix[PHOTO_TILE_DIM * (py % PHOTO_TILE_DIM) +
+		      x % PHOTO_TILE_DIM];
+	for (; 0 < run; run--, pix += PHOTO_TILE_DIM) {
+	    buf[idx++] = *pix;
+	}
+    }
+    (void)pthread_mutex_unlock (&tile_lock);
+}
+
+
+/*
+ * tile_prefetch
+ *   DESCRIPTION: Queue requests for the helper thread to read any tiles
+ *                covering a rectangle of the photo that are not yet in
+ *                the cache.  Repeated requests for the same set of tiles
+ *                are ignored cheaply.
+ *   INPUTS: src -- tile source
+ *           (x,y) -- upper left pixel of rectangle (may lie off the photo)
+ *           (w,h) -- rectangle dimensions in pixels
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: requests beyond the queue length are dropped
+ */
+void
+tile_prefetch (tile_src_t* src, int x, int y, int w, int h)
+{
+    int32_t tx0, ty0, tx1, ty1; /* tile range (inclusive)     */
+    int32_t tx, ty;		/* index over tiles           */
+    int32_t i;			/* index over queued requests */
+    int32_t queued;		/* number of new requests     */
+
+    /* Clip the rectangle to the photo and convert it to tiles. */
+    tx0 = (0 > x ? 0 : x / PHOTO_TILE_DIM);
+    ty0 = (0 > y ? 0 : y / PHOTO_TILE_DIM);
+    tx1 = (x + w - 1) / PHOTO_TILE_DIM;
+    ty1 = (y + h - 1) / PHOTO_TILE_DIM;
+    if (src->tiles_x <= tx1) {
+        tx1 = src->tiles_x - 1;
+    }
+    if (src->tiles_y <= ty1) {
+        ty1 = src->tiles_y - 1;
+    }
+    if (0 > x + w - 1 || 0 > y + h - 1 || tx0 > tx1 || ty0 > ty1) {
+        return;
+    }
+
+    (void)pthread_mutex_lock (&tile_lock);
+    if (tx0 == src->last_rect[0] && ty0 == src->last_rect[1] &&
+	tx1 == src->last_rect[2] && ty1 == src->last_rect[3]) {
+	(void)pthread_mutex_unlock (&tile_lock);
+	return;
+    }
+    src->last_rect[0] = tx0;
+    src->last_rect[1] = ty0;
+    src->last_rect[2] = tx1;
+    src->last_rect[3] = ty1;
+
+    for (queued = 0, ty = ty0; ty1 >= ty; ty++) {
+	for (tx = tx0; tx1 >= tx; tx++) {
+	    if (NULL != tile_find (src, tx, ty)) {
+	        continue;
+	    }
+	    for (i = 0; q_count > i; i++) {
+		tile_req_t* r = &queue[(q_head + i) % TILE_QUEUE_LEN];
+		if (src == r->src && tx == r->tx && ty == r->ty) {
+		    break;
+		}
+	    }
+	    if (q_count > i) {
+	        continue;
+	    }
+	    if (TILE_QUEUE_LEN == q_count) {
+	        stat_dropped++;
+		continue;
+	    }
+	    i = (q_head + q_count++) % TILE_QUEUE_LEN;
+	    queue[i].src = src;
+	    queue[i].tx = tx;
+	    queue[i].ty = ty;
+	    queued++;
+	}
+    }
+    if (0 < queued) {
+	(void)pthread_cond_signal (&req_cv);
+    }
+    (void)pthread_mutex_unlock (&tile_lock);
+}
+
+
+/*
+ * tile_report
+ *   DESCRIPTION: Print tile cache statistics, if any tiled photo was
+ *                opened.
+ *   INPUTS: f -- output stream
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void
+tile_report (FILE* f)
+{
+    if (0 == n_sources) {
+        return;
+    }
+    (void)pthread_mutex_lock (&tile_lock);
+    fprintf (f, "tile cache: %u hits, %u stalls, %u waits on prefetch, "
+	     "%u prefetched, %u requests dropped\n", stat_hits, stat_stalls,
+	     stat_waits, stat_prefetched, stat_dropped);
+    (void)pthread_mutex_unlock (&tile_lock);
+}
+
+
+/*
+ * tile_find
+ *   DESCRIPTION: Find the cache slot holding (or loading) a tile.  Must
+ *                be called with tile_lock held.
+ *   INPUTS: src -- tile source
+ *           (tx,ty) -- tile column and row
+ *   OUTPUTS: none
+ *   RETURN VALUE: the slot, or NULL if the tile is not in the cache
+ *   SIDE EFFECTS: none
+ */
+static tile_slot_t*
+tile_find (const tile_src_t* src, int32_t tx, int32_t ty)
+{
+    int32_t i;	/* index over cache slots */
+
+    for (i = 0; TILE_CACHE_SLOTS > i; i++) {
+	if (TILE_EMPTY != slot[i].state && src == slot[i].src &&
+	    tx == slot[i].tx && ty == slot[i].ty) {
+	    return &slot[i];
+	}
+    }
+    return NULL;
+}
+
+
+/*
+ * tile_claim
+ *   DESCRIPTION: Pick a cache slot to receive a new tile: an empty slot
+ *                if one exists, or else the least recently used slot
+ *                that is not being loaded.  Must be called with tile_lock
+ *                held.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: the slot, or NULL if all slots are being loaded
+ *   SIDE EFFECTS: none
+ */
+static tile_slot_t*
+tile_claim ()
+{
+    tile_slot_t* best = NULL;	/* best candidate so far  */
+    int32_t      i;		/* index over cache slots */
+
+    for (i = 0; TILE_CACHE_SLOTS > i; i++) {
+	if (TILE_EMPTY == slot[i].state) {
+	    return &slot[i];
+	}
+	if (TILE_READY == slot[i].state &&
+	    (NULL == best || best->last_use > slot[i].last_use)) {
+	    best = &slot[i];
+	}
+    }
+    return best;
+}
+
+
+/*
+ * tile_get
+ *   DESCRIPTION: Get a tile, reading it from disk if necessary.  Must be
+ *                called with tile_lock held; the tile remains valid until
+ *                the lock is released.
+ *   INPUTS: src -- tile source
+ *           (tx,ty) -- tile column and row
+ *   OUTPUTS: none
+ *   RETURN VALUE: the slot holding the tile
+ *   SIDE EFFECTS: may release and reacquire tile_lock
+ */
+static tile_slot_t*
+tile_get (tile_src_t* src, int32_t tx, int32_t ty)
+{
+    tile_slot_t* s;	/* slot holding tile */
+
+    while (1) {
+	s = tile_find (src, tx, ty);
+	if (NULL != s && TILE_READY == s->state) {
+	    stat_hits++;
+	    s->last_use = ++use_clock;
+	    return s;
+	}
+	if (NULL != s) {
+	    /* The helper thread is reading it; wait for it to finish. */
+	    stat_waits++;
+	    (void)pthread_cond_wait (&tile_cv, &tile_lock);
+	    continue;
+	}
+	if (NULL == (s = tile_claim ())) {
+	    (void)pthread_cond_wait (&tile_cv, &tile_lock);
+	    continue;
+	}
+	stat_stalls++;
+	tile_load (s, src, tx, ty);
+	return s;
+    }
+}
+
+
+/*
+ * tile_load
+ *   DESCRIPTION: Read a tile from disk into a cache slot and convert it
+ *                to palette indices.  Must be called with tile_lock held.
+ *   INPUTS: s -- slot to receive the tile
+ *           src -- tile source
+ *           (tx,ty) -- tile column and row
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: releases tile_lock while reading; wakes any threads
+ *                 waiting for tiles to load
+ */
+static void
+tile_load (tile_slot_t* s, tile_src_t* src, int32_t tx, int32_t ty)
+{
+    uint16_t raw[TILE_PIXELS];	/* 5:6:5 pixels read from file */
+    off_t    off;		/* file offset of tile         */
+    ssize_t  got;		/* number of bytes read        */
+
+    s->src = src;
+    s->tx = tx;
+    s->ty = ty;
+    s->state = TILE_LOADING;
+    (void)pthread_mutex_unlock (&tile_lock);
+
+    off = src->data_off + (off_t)(src->tiles_x * ty + tx) * sizeof (raw);
+    got = pread (src->fd, raw, sizeof (raw), off);
+    if (0 > got) {
+        got = 0;
+    }
+    (void)memset ((char*)raw + got, 0, sizeof (raw) - got);
+    photo_map_pixels (src->photo, raw, s->pix, TILE_PIXELS);
+
+    (void)pthread_mutex_lock (&tile_lock);
+    s->state = TILE_READY;
+    s->last_use = ++use_clock;
+    (void)pthread_cond_broadcast (&tile_cv);
+}
+
+
+/*
+ * tile_thread
+ *   DESCRIPTION: Function executed by the tile prefetch helper thread.
+ *                Waits for prefetch requests and reads the tiles named
+ *                into the cache.
+ *   INPUTS: none (ignored)
+ *   OUTPUTS: none
+ *   RETURN VALUE: NULL
+ *   SIDE EFFECTS: fills tile cache slots
+ */
+static void*
+tile_thread (void* ignore)
+{
+    tile_req_t   r;	/* request being served */
+    tile_slot_t* s;	/* slot to receive tile */
+
+    (void)pthread_mutex_lock (&tile_lock);
+    while (1) {
+	while (0 == q_count) {
+	    (void)pthread_cond_wait (&req_cv, &tile_lock);
+	}
+	r = queue[q_head];
+	q_head = (q_head + 1) % TILE_QUEUE_LEN;
+	q_count--;
+
+	/* Skip tiles loaded on demand since the request was queued. */
+	if (NULL != tile_find (r.src, r.tx, r.ty) ||
+	    NULL == (s = tile_claim ())) {
+	    continue;
+	}
+	stat_prefetched++;
+	tile_load (s, r.src, r.tx, r.ty);
+    }
+
+    /* This code never executes--the process exits with the thread live. */
+    return NULL;
+}
@@ -0,0 +1,79 @@
+/*									tab:8
+ *
+ * tile.h - header file for streaming tiled room photos
+ *
+ * "Copyright (c) 2026 by Tianzuo Qin."
+ *
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation for any purpose, without fee, and without written agreement is
+ * hereby granted, provided that the above copyright notice and the following
+ * two paragraphs appear in all copies of this software.
+ *
+ * IN NO EVENT SHALL THE AUTHOR OR THE UNIVERSITY OF ILLINOIS BE LIABLE TO
+ * ANY PARTY FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL
+ * DAMAGES ARISING OUT  OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+ * EVEN IF THE AUTHOR AND/OR THE UNIVERSITY OF ILLINOIS HAS BEEN ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THE AUTHOR AND THE UNIVERSITY OF ILLINOIS SPECIFICALLY DISCLAIM ANY
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE
+ * PROVIDED HEREUNDER IS ON AN "AS IS" BASIS, AND NEITHER THE AUTHOR NOR
+ * THE UNIVERSITY OF ILLINOIS HAS ANY OBLIGATION TO PROVIDE MAINTENANCE,
+ * SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS."
+ *
+ * Author:	    Tianzuo Qin
+ * Version:	    1
+ * Creation Date:   Sun Oct 18 10:12:40 2026
+ * Filename:	    tile.h
+ * History:
+ *	TQ	1	Sun Oct 18 10:12:40 2026
+ *		First written.
+ */
+#ifndef TILE_H
+#define TILE_H
+
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "types.h"
+
+
+/*
+ * Tiled photos are read from disk a tile at a time into a single cache
+ * shared by all tiled photos.  The cache never grows, so memory use is
+ * the same whatever the size of the panoramas.  Each cached tile holds
+ * PHOTO_TILE_DIM x PHOTO_TILE_DIM palette indices.
+ *
+ * A helper thread reads tiles named by prefetch requests.  Drawing code
+ * requests the tiles around the lines that it draws, so that by the time
+ * the view window scrolls onto a tile, the tile is normally in the cache.
+ * Reads of tiles that are not cached (or not yet finished loading) block
+ * the caller and are counted as stalls.
+ *
+ * The cache must hold at least the tiles under the screen plus a one-tile
+ * margin all around (at most 8 x 6 tiles for a 320x182 window).
+ */
+#define TILE_CACHE_SLOTS  96
+#define TILE_QUEUE_LEN    64	/* maximum outstanding prefetch requests */
+
+/* Open a tiled photo file for streaming pixels of photo p. */
+extern tile_src_t* tile_src_open (const char* fname, uint32_t data_off,
+				  const photo_t* p);
+
+/* Fill buf with len pixels of row y, starting at column x. */
+extern void tile_fill_horiz (tile_src_t* src, int x, int y, int len,
+			     unsigned char* buf);
+
+/* Fill buf with len pixels of column x, starting at row y. */
+extern void tile_fill_vert (tile_src_t* src, int x, int y, int len,
+			    unsigned char* buf);
+
+/* Ask the helper thread to load the tiles covering a rectangle. */
+extern void tile_prefetch (tile_src_t* src, int x, int y, int w, int h);
+
+/* Print tile cache statistics (if any tiled photo was used). */
+extern void tile_report (FILE* f);
+
+#endif /* TILE_H */
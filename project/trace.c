@@ -0,0 +1,329 @@
+/*									tab:8
+ *
+ * trace.c - per-thread event rings written as a Chrome trace
+ *
+ * "Copyright (c) 2026 by Tianzuo Qin."
+ *
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation for any purpose, without fee, and without written agreement is
+ * hereby granted, provided that the above copyright notice and the following
+ * two paragraphs appear in all copies of this software.
+ *
+ * IN NO EVENT SHALL THE AUTHOR OR THE UNIVERSITY OF ILLINOIS BE LIABLE TO
+ * ANY PARTY FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL
+ * DAMAGES ARISING OUT  OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+ * EVEN IF THE AUTHOR AND/OR THE UNIVERSITY OF ILLINOIS HAS BEEN ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THE AUTHOR AND THE UNIVERSITY OF ILLINOIS SPECIFICALLY DISCLAIM ANY
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE
+ * PROVIDED HEREUNDER IS ON AN "AS IS" BASIS, AND NEITHER THE AUTHOR NOR
+ * THE UNIVERSITY OF ILLINOIS HAS ANY OBLIGATION TO PROVIDE MAINTENANCE,
+ * SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS."
+ *
+ * Author:	    Tianzuo Qin
+ * Version:	    1
+ * Creation Date:   Sun Oct 18 23:52:26 2026
+ * Filename:	    trace.c
+ * History:
+ *	TQ	1	Sun Oct 18 23:52:26 2026
+ *		First written.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "trace.h"
+
+
+/* 
+ * Each thread's ring holds TRACE_RING_SIZE events (a power of two); at
+ * most TRACE_MAX_THREADS threads may record.
+ */
+#define TRACE_RING_SIZE   (1 << 15)
+#define TRACE_MAX_THREADS 16
+
+/* an event: a span if dur is not zero, an instant event if it is */
+typedef struct trace_event_t trace_event_t;
+struct trace_event_t {
+    const char* name;	/* what happened                 */
+    const char* arg;	/* detail shown, or NULL         */
+    uint64_t    start;	/* start time (ns)               */
+    uint64_t    dur;	/* duration (ns), 0 for instants */
+};
+
+/* a thread's ring; only the thread writes it */
+typedef struct trace_ring_t trace_ring_t;
+struct trace_ring_t {
+    const char*    name;	/* thread name                  */
+    uint32_t       head;	/* events ever recorded         */
+    trace_event_t* ev;		/* TRACE_RING_SIZE events       */
+};
+
+
+/* local functions--see function headers for details */
+static void record (const char* name, const char* arg, uint64_t start,
+		    uint64_t dur);
+static void write_string (FILE* f, const char* s);
+
+
+/* file-scope variables */
+
+int trace_on = 0;
+
+static const char*   trace_file;		   /* output file name */
+static uint64_t      trace_start;		   /* time at init     */
+static trace_ring_t  ring[TRACE_MAX_THREADS];	   /* rings in use     */
+static uint32_t      n_rings;			   /* rings claimed    */
+static __thread trace_ring_t* my_ring;		   /* calling thread's */
+
+
+/*
+ * trace_init
+ *   DESCRIPTION: Start tracing if ADVENTURE_TRACE names a trace file,
+ *                and name the calling thread.  Call before any other
+ *                thread records.
+ *   INPUTS: name -- name of the calling thread
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: reads ADVENTURE_TRACE; may set trace_on
+ */
+void
+trace_init (const char* name)
+{
+    trace_file = getenv ("ADVENTURE_TRACE");
+    if (NULL == trace_file || '\0' == *trace_file) {
+        return;
+    }
+    trace_start = trace_clock ();
+    trace_on = 1;
+    trace_thread (name);
+}
+
+
+/*
+ * trace_thread
+ *   DESCRIPTION: Name the calling thread in the trace, and give it a 
+ *                ring in which to record.  Does nothing if tracing is 
+ *                off, or if too many threads have rings already.
+ *   INPUTS: name -- name of the thread (a string that lasts)
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: allocates the ring
+ */
+void
+trace_thread (const char* name)
+{
+    trace_event_t* ev;  /* events of the ring  */
+    uint32_t idx;       /* index of the ring   */
+
+    if (!trace_on || NULL != my_ring) {
+        return;
+    }
+    ev = malloc (TRACE_RING_SIZE * sizeof (*ev));
+    if (NULL == ev) {
+        return;
+    }
+    idx = __atomic_fetch_add (&n_rings, 1, __ATOMIC_RELAXED);
+    if (TRACE_MAX_THREADS <= idx) {
+	free (ev);
+        return;
+    }
+    ring[idx].name = name;
+    ring[idx].ev = ev;
+    my_ring = &ring[idx];
+}
+
+
+/*
+ * trace_clock
+ *   DESCRIPTION: Get the current time for a trace event.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: the time in nanoseconds (CLOCK_MONOTONIC)
+ *   SIDE EFFECTS: none
+ */
+uint64_t
+trace_clock ()
+{
+    struct timespec t;	/* current time */
+
+    (void)clock_gettime (CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+
+/*
+ * trace_span
+ *   DESCRIPTION: Record a span of time in the calling thread's ring.
+ *   INPUTS: name -- what the thread did
+ *           arg -- detail to show, or NULL
+ *           start -- time the span began (from trace_clock)
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: may overwrite the ring's oldest event
+ */
+void
+trace_span (const char* name, const char* arg, uint64_t start)
+{
+    uint64_t now = trace_clock ();  /* end of span */
+
+    /* A span must not look like an instant event. */
+    record (name, arg, start, (now > start ? now - start : 1));
+}
+
+
+/*
+ * trace_mark
+ *   DESCRIPTION: Record an instant event in the calling thread's ring.
+ *   INPUTS: name -- what happened
+ *           arg -- detail to show, or NULL
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: may overwrite the ring's oldest event
+ */
+void
+trace_mark (const char* name, const char* arg)
+{
+    record (name, arg, trace_clock (), 0);
+}
+
+
+/*
+ * trace_flush
+ *   DESCRIPTION: Write the events in all rings to the trace file, as
+ *                complete ("X") and instant ("i") events, with a name
+ *                for each thread, and report how many events were kept
+ *                and lost.  Threads still recording may have their
+ *                newest events left out.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: writes the trace file; prints to stdout
+ */
+void
+trace_flush ()
+{
+    FILE* f;                   /* trace file                   */
+    const trace_ring_t* r;     /* ring being written           */
+    const trace_event_t* e;    /* event being written          */
+    uint32_t rings;            /* rings claimed                */
+    uint32_t head, first;      /* events recorded, and first   */
+    uint32_t i, j;             /* indices over rings, events   */
+    uint32_t kept, lost;       /* events written and lost      */
+    const char* sep;           /* separator before next event  */
+
+    if (!trace_on) {
+        return;
+    }
+    f = fopen (trace_file, "w");
+    if (NULL == f) {
+	perror (trace_file);
+        return;
+    }
+    rings = __atomic_load_n (&n_rings, __ATOMIC_RELAXED);
+    if (TRACE_MAX_THREADS < rings) {
+        rings = TRACE_MAX_THREADS;
+    }
+    kept = lost = 0;
+    sep = "";
+    fputs ("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", f);
+    for (i = 0; rings > i; i++) {
+	r = &ring[i];
+	if (NULL == r->ev) {
+	    continue;
+	}
+	fprintf (f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+		 "\"tid\":%u,\"args\":{\"name\":", sep, i + 1);
+	write_string (f, r->name);
+	fputs ("}}", f);
+	sep = ",\n";
+	head = __atomic_load_n (&r->head, __ATOMIC_ACQUIRE);
+	first = (TRACE_RING_SIZE < head ? head - TRACE_RING_SIZE : 0);
+	lost += first;
+	for (j = first; head != j; j++) {
+	    e = &r->ev[j % TRACE_RING_SIZE];
+	    fprintf (f, "%s{\"name\":", sep);
+	    write_string (f, e->name);
+	    if (0 == e->dur) {
+		fprintf (f, ",\"ph\":\"i\",\"s\":\"t\"");
+	    } else {
+		fprintf (f, ",\"ph\":\"X\",\"dur\":%.3f", e->dur / 1e3);
+	    }
+	    fprintf (f, ",\"ts\":%.3f,\"pid\":1,\"tid\":%u", 
+		     (e->start - trace_start) / 1e3, i + 1);
+	    if (NULL != e->arg) {
+		fputs (",\"args\":{\"detail\":", f);
+		write_string (f, e->arg);
+		fputc ('}', f);
+	    }
+	    fputc ('}', f);
+	    kept++;
+	}
+    }
+    fputs ("\n]}\n", f);
+    (void)fclose (f);
+    printf ("trace: %u events written to %s from %u threads, %u lost\n", 
+	    kept, trace_file, rings, lost);
+}
+
+
+/*
+ * record
+ *   DESCRIPTION: Add an event to the calling thread's ring.  The event 
+ *                is filled before head is advanced past it, so that
+ *                trace_flush sees only whole events.
+ *   INPUTS: name -- what happened
+ *           arg -- detail to show, or NULL
+ *           start -- time of the event (ns)
+ *           dur -- duration of a span (ns), or 0 for an instant
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: may overwrite the ring's oldest event
+ */
+static void
+record (const char* name, const char* arg, uint64_t start, uint64_t dur)
+{
+    trace_ring_t* r = my_ring;  /* calling thread's ring */
+    trace_event_t* e;           /* event to fill         */
+
+    if (NULL == r) {
+        return;
+    }
+    e = &r->ev[r->head % TRACE_RING_SIZE];
+    e->name = name;
+    e->arg = arg;
+    e->start = start;
+    e->dur = dur;
+    __atomic_store_n (&r->head, r->head + 1, __ATOMIC_RELEASE);
+}
+
+
+/*
+ * write_string
+ *   DESCRIPTION: Write a string as a JSON string.
+ *   INPUTS: f -- output stream
+ *           s -- the string
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: writes to f
+ */
+static void
+write_string (FILE* f, const char* s)
+{
+    fputc ('"', f);
+    for (; '\0' != *s; s++) {
+	if ('"' == *s || '\\' == *s) {
+	    fputc ('\\', f);
+	}
+	if (' ' > (unsigned char)*s) {
+	    fprintf (f, "\\u%04x", (unsigned char)*s);
+	    continue;
+	}
+	fputc (*s, f);
+    }
+    fputc ('"', f);
+}
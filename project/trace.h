@@ -0,0 +1,90 @@
+/*									tab:8
+ *
+ * trace.h - header file for Chrome trace-event output
+ *
+ * "Copyright (c) 2026 by Tianzuo Qin."
+ *
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation for any purpose, without fee, and without written agreement is
+ * hereby granted, provided that the above copyright notice and the following
+ * two paragraphs appear in all copies of this software.
+ *
+ * IN NO EVENT SHALL THE AUTHOR OR THE UNIVERSITY OF ILLINOIS BE LIABLE TO
+ * ANY PARTY FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL
+ * DAMAGES ARISING OUT  OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+ * EVEN IF THE AUTHOR AND/OR THE UNIVERSITY OF ILLINOIS HAS BEEN ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THE AUTHOR AND THE UNIVERSITY OF ILLINOIS SPECIFICALLY DISCLAIM ANY
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE
+ * PROVIDED HEREUNDER IS ON AN "AS IS" BASIS, AND NEITHER THE AUTHOR NOR
+ * THE UNIVERSITY OF ILLINOIS HAS ANY OBLIGATION TO PROVIDE MAINTENANCE,
+ * SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS."
+ *
+ * Author:	    Tianzuo Qin
+ * Version:	    1
+ * Creation Date:   Sun Oct 18 23:52:26 2026
+ * Filename:	    trace.h
+ * History:
+ *	TQ	1	Sun Oct 18 23:52:26 2026
+ *		First written.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+
+#include <stdint.h>
+
+
+/*
+ * Setting ADVENTURE_TRACE to a file name records what each thread does
+ * on a timeline, and writes it at exit as a Chrome trace (JSON trace 
+ * events), which chrome://tracing and Perfetto display.  Each thread 
+ * records into its own ring of TRACE_RING_SIZE events, without locks 
+ * and without waiting for other threads; when a ring fills, its oldest
+ * events are overwritten (and counted as lost).  Spans are recorded as
+ * one complete event, holding both the begin and end times, when they 
+ * end.  Without ADVENTURE_TRACE, each macro below costs one test of a 
+ * flag.
+ *
+ * A thread records nothing until it calls trace_thread to name itself;
+ * trace_init names the thread that calls it.
+ */
+
+/* Start a span, declaring a variable t to hold the start time. */
+#define TRACE_BEGIN(t) \
+    uint64_t t = (trace_on ? trace_clock () : 0)
+
+/* End a span started with TRACE_BEGIN(t); arg, if not NULL, is shown. */
+#define TRACE_END(name, arg, t) \
+    do { if (trace_on) { trace_span ((name), (arg), (t)); } } while (0)
+
+/* Record an instant event. */
+#define TRACE_MARK(name, arg) \
+    do { if (trace_on) { trace_mark ((name), (arg)); } } while (0)
+
+/* 1 if tracing is on (read by the macros) */
+extern int trace_on;
+
+/* Start tracing if ADVENTURE_TRACE is set; names this thread. */
+extern void trace_init (const char* name);
+
+/* Name the calling thread, and give it a ring (if tracing is on). */
+extern void trace_thread (const char* name);
+
+/* Write the trace file.  Other threads should have stopped. */
+extern void trace_flush (void);
+
+/* Get the time for a trace event, in nanoseconds. */
+extern uint64_t trace_clock (void);
+
+/* 
+ * Record a span from start until now, or an instant event.  Names and
+ * args must be strings that last until trace_flush.
+ */
+extern void trace_span (const char* name, const char* arg, uint64_t start);
+extern void trace_mark (const char* name, const char* arg);
+
+#endif /* TRACE_H */
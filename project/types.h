@@ -42,4 +42,7 @@ typedef struct image_t image_t;
 typedef struct room_t room_t;
 typedef struct object_t object_t;
 
+/* types defined in tile.c */
+typedef struct tile_src_t tile_src_t;
+
 #endif /* TYPES_H */
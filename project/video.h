@@ -0,0 +1,144 @@
+/*									tab:8
+ *
+ * video.h - header file for pluggable video output backends
+ *
+ * "Copyright (c) 2026 by Tianzuo Qin."
+ *
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation for any purpose, without fee, and without written agreement is
+ * hereby granted, provided that the above copyright notice and the following
+ * two paragraphs appear in all copies of this software.
+ *
+ * IN NO EVENT SHALL THE AUTHOR OR THE UNIVERSITY OF ILLINOIS BE LIABLE TO
+ * ANY PARTY FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL
+ * DAMAGES ARISING OUT  OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+ * EVEN IF THE AUTHOR AND/OR THE UNIVERSITY OF ILLINOIS HAS BEEN ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THE AUTHOR AND THE UNIVERSITY OF ILLINOIS SPECIFICALLY DISCLAIM ANY
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE
+ * PROVIDED HEREUNDER IS ON AN "AS IS" BASIS, AND NEITHER THE AUTHOR NOR
+ * THE UNIVERSITY OF ILLINOIS HAS ANY OBLIGATION TO PROVIDE MAINTENANCE,
+ * SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS."
+ *
+ * Author:	    Tianzuo Qin
+ * Version:	    1
+ * Creation Date:   Sun Oct 18 14:02:51 2026
+ * Filename:	    video.h
+ * History:
+ *	TQ	1	Sun Oct 18 14:02:51 2026
+ *		First written.
+ */
+#ifndef VIDEO_H
+#define VIDEO_H
+
+
+#include <stdint.h>
+#include <stdio.h>
+
+
+/*
+ * The mode X code in modex.c builds screen images in memory and hands
+ * them to a video backend, which owns the display device.  The VGA
+ * backend (in modex.c) writes to video memory and VGA registers through
+ * /dev/mem and port I/O.  The in-memory backend (vmem.c) keeps the same
+ * state--four 64kB planes, the palette, and the display start address--in
+ * ordinary memory, so the renderer can run and be measured on any Linux
+ * host, and can dump displayed frames as PPM images.
+ *
+ * The terminal backend (vterm.c) draws the in-memory backend's frames
+ * in a terminal with ANSI colors, for watching the game remotely.
+ *
+ * The backend is chosen when mode X is set by the ADVENTURE_VIDEO
+ * environment variable ("vga", the default, "mem", or "term").
+ *
+ * Rows of the display are VIDEO_ROW_BYTES apart in video memory unless
+ * set_row_bytes widens them (for hardware scrolling, the CRTC offset
+ * register).  The status bar uses the same row spacing, but is never
+ * panned horizontally.
+ */
+
+#define VIDEO_PLANE_SIZE   65536  /* bytes in one plane of video memory  */
+#define VIDEO_ROW_BYTES    80     /* bytes per plane per row in mode X   */
+#define VIDEO_STATUS_ROWS  18     /* status bar rows, at address 0       */
+#define VIDEO_STATUS_SIZE  (VIDEO_ROW_BYTES * VIDEO_STATUS_ROWS)
+
+/* display modes known to backends */
+typedef enum {
+    VIDEO_MODE_X,	/* 320x200 planar graphics, split status bar */
+    VIDEO_MODE_TEXT	/* 80x25 color text (mode 3)                  */
+} video_mode_t;
+
+/* operations provided by a video backend */
+typedef struct video_ops_t video_ops_t;
+struct video_ops_t {
+    const char* name;
+
+    /* Acquire the display device.  Returns 0 on success, -1 on failure. */
+    int (*open) (void);
+
+    /* Release the display device. */
+    void (*close) (void);
+
+    /* Program a display mode; mode X also clears video memory. */
+    void (*set_mode) (video_mode_t mode);
+
+    /* Fill all four planes of video memory with zeroes. */
+    void (*clear) (void);
+
+    /* Copy len bytes into one plane (0-3) of video memory at addr. */
+    void (*write_plane) (int plane, uint16_t addr, const unsigned char* src,
+			 int len);
+
+    /* 
+     * Display the screen image starting at video memory address start,
+     * shifted left by pan (0-3) pixels.
+     */
+    void (*present) (uint16_t start, int pan);
+
+    /* Set the distance between display rows (an even number of bytes). */
+    void (*set_row_bytes) (int row_bytes);
+
+    /* 
+     * Copy a rectangle of width bytes by height rows, stride bytes apart,
+     * from src to dst in all four planes (four pixels per byte, through
+     * the VGA latches).  The rectangles may overlap.
+     */
+    void (*copy_vram) (uint16_t dst, uint16_t src, int width, int height,
+		       int stride);
+
+    /* Load count 6-bit RGB palette colors starting at color first. */
+    void (*load_palette) (int first, const unsigned char* rgb, int count);
+
+    /* 
+     * Copy bytes x to x + width - 1 of each row of a status bar image
+     * (four planes of VIDEO_STATUS_SIZE bytes, VIDEO_ROW_BYTES per row)
+     * to the same place in the status bar at the start of video memory.
+     */
+    void (*write_status_bar) (const unsigned char* img, int x, int width);
+};
+
+/* the VGA backend (modex.c) */
+extern const video_ops_t vga_video;
+
+/* the in-memory backend (vmem.c) */
+extern const video_ops_t vmem_video;
+
+/* Write the frame last presented by the in-memory backend as a PPM file. */
+extern int vmem_dump_ppm (const char* fname);
+
+/* 
+ * Get the frame last presented by the in-memory backend: color indices,
+ * IMAGE_X_DIM per row, with the status bar rows below the view, and the
+ * 6-bit RGB palette.
+ */
+extern void vmem_read_frame (unsigned char* pix, unsigned char rgb[256][3]);
+
+/* the ANSI terminal backend (vterm.c), built on the in-memory backend */
+extern const video_ops_t vterm_video;
+
+/* Print output per frame of the terminal backend (if it was used). */
+extern void vterm_report (FILE* f);
+
+#endif /* VIDEO_H */
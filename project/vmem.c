@@ -0,0 +1,421 @@
+/*									tab:8
+ *
+ * vmem.c - in-memory video backend
+ *
+ * "Copyright (c) 2026 by Tianzuo Qin."
+ *
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation for any purpose, without fee, and without written agreement is
+ * hereby granted, provided that the above copyright notice and the following
+ * two paragraphs appear in all copies of this software.
+ *
+ * IN NO EVENT SHALL THE AUTHOR OR THE UNIVERSITY OF ILLINOIS BE LIABLE TO
+ * ANY PARTY FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL
+ * DAMAGES ARISING OUT  OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+ * EVEN IF THE AUTHOR AND/OR THE UNIVERSITY OF ILLINOIS HAS BEEN ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THE AUTHOR AND THE UNIVERSITY OF ILLINOIS SPECIFICALLY DISCLAIM ANY
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE
+ * PROVIDED HEREUNDER IS ON AN "AS IS" BASIS, AND NEITHER THE AUTHOR NOR
+ * THE UNIVERSITY OF ILLINOIS HAS ANY OBLIGATION TO PROVIDE MAINTENANCE,
+ * SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS."
+ *
+ * Author:	    Tianzuo Qin
+ * Version:	    1
+ * Creation Date:   Sun Oct 18 14:02:51 2026
+ * Filename:	    vmem.c
+ * History:
+ *	TQ	1	Sun Oct 18 14:02:51 2026
+ *		First written.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "copy.h"
+#include "modex.h"
+#include "video.h"
+
+
+/* local functions--see function headers for details */
+static int vmem_open (void);
+static void vmem_close (void);
+static void vmem_set_mode (video_mode_t mode);
+static void vmem_clear (void);
+static void vmem_write_plane (int plane, uint16_t addr,
+			      const unsigned char* src, int len);
+static void vmem_present (uint16_t start, int pan);
+static void vmem_set_row_bytes (int row_bytes);
+static void vmem_copy_vram (uint16_t dst, uint16_t src, int width,
+			    int height, int stride);
+static void copy_vram_row (int p, uint16_t dst, uint16_t src, int width,
+			   int forward);
+static void vmem_load_palette (int first, const unsigned char* rgb,
+			       int count);
+static void vmem_write_status_bar (const unsigned char* img, int x,
+				   int width);
+
+
+/* the in-memory backend */
+const video_ops_t vmem_video = {
+    "mem", vmem_open, vmem_close, vmem_set_mode, vmem_clear,
+    vmem_write_plane, vmem_present, vmem_set_row_bytes, vmem_copy_vram,
+    vmem_load_palette, vmem_write_status_bar
+};
+
+/* 
+ * The emulated display: four planes of video memory, the palette (6-bit
+ * RGB), the current mode, the start address and pixel panning of the
+ * displayed image, and the distance between rows.  As with the VGA,
+ * addresses wrap within a plane.
+ */
+static unsigned char plane[4][VIDEO_PLANE_SIZE];
+static unsigned char palette[256][3];
+static video_mode_t  mode = VIDEO_MODE_TEXT;
+static uint16_t      start_addr;
+static int           pan_pixels;
+static int           row_bytes = VIDEO_ROW_BYTES;
+
+/* 
+ * If ADVENTURE_PPM is set when the backend is opened, every presented
+ * frame is written to a file named by appending a six-digit frame number
+ * and ".ppm" to the variable's value.
+ */
+static const char* ppm_prefix;
+static uint32_t    frame_count;
+
+
+/*
+ * vmem_open
+ *   DESCRIPTION: Open the in-memory backend.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 (cannot fail)
+ *   SIDE EFFECTS: reads ADVENTURE_PPM
+ */
+static int
+vmem_open ()
+{
+    ppm_prefix = getenv ("ADVENTURE_PPM");
+    frame_count = 0;
+    return 0;
+}
+
+
+/*
+ * vmem_close
+ *   DESCRIPTION: Close the in-memory backend.  The contents of memory are
+ *                kept for inspection.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void
+vmem_close ()
+{
+}
+
+
+/*
+ * vmem_set_mode
+ *   DESCRIPTION: Record the display mode; mode X clears video memory.
+ *   INPUTS: m -- the mode to set
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: may clear video memory
+ */
+static void
+vmem_set_mode (video_mode_t m)
+{
+    mode = m;
+    start_addr = 0;
+    pan_pixels = 0;
+    row_bytes = VIDEO_ROW_BYTES;
+    if (VIDEO_MODE_X == m) {
+	copy_select (plane[0], SCROLL_X_WIDTH * SCROLL_Y_DIM);
+        vmem_clear ();
+    }
+}
+
+
+/*
+ * vmem_clear
+ *   DESCRIPTION: Fill video memory with zeroes.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: clears all four planes
+ */
+static void
+vmem_clear ()
+{
+    (void)memset (plane, 0, sizeof (plane));
+}
+
+
+/*
+ * vmem_write_plane
+ *   DESCRIPTION: Copy data into one plane of video memory.
+ *   INPUTS: p -- the plane (0-3) to write
+ *           addr -- the destination offset in video memory
+ *           src -- the data to copy
+ *           len -- number of bytes to copy
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void
+vmem_write_plane (int p, uint16_t addr, const unsigned char* src, int len)
+{
+    int first;	/* bytes before the end of the plane */
+
+    first = VIDEO_PLANE_SIZE - addr;
+    if (len <= first) {
+	copy_kernel->copy (&plane[p][addr], src, len);
+    } else {
+	copy_kernel->copy (&plane[p][addr], src, first);
+	copy_kernel->copy (plane[p], src + first, len - first);
+    }
+}
+
+
+/*
+ * vmem_present
+ *   DESCRIPTION: Record the start address and panning of the displayed 
+ *                image, and dump the frame if requested.
+ *   INPUTS: start -- video memory address of the screen image
+ *           pan -- pixels (0-3) to shift the image left
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: may write a PPM file
+ */
+static void
+vmem_present (uint16_t start, int pan)
+{
+    char fname[4096];	/* name of frame file */
+
+    start_addr = start;
+    pan_pixels = pan;
+    frame_count++;
+    if (NULL != ppm_prefix) {
+	(void)snprintf (fname, sizeof (fname), "%s%06u.ppm", ppm_prefix,
+			frame_count);
+	(void)vmem_dump_ppm (fname);
+    }
+}
+
+
+/*
+ * vmem_set_row_bytes
+ *   DESCRIPTION: Set the distance between display rows in video memory.
+ *   INPUTS: n -- bytes per row in each plane
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void
+vmem_set_row_bytes (int n)
+{
+    row_bytes = n;
+}
+
+
+/*
+ * vmem_copy_vram
+ *   DESCRIPTION: Copy a rectangle of video memory in all four planes, as
+ *                the VGA does with latch copies.  As with writes, 
+ *                addresses wrap within a plane.
+ *   INPUTS: dst -- video memory address of upper left of destination
+ *           src -- video memory address of upper left of source
+ *           width -- bytes per row to copy
+ *           height -- number of rows
+ *           stride -- bytes from one row to the next
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void
+vmem_copy_vram (uint16_t dst, uint16_t src, int width, int height,
+		int stride)
+{
+    int p;  /* loop index over planes */
+    int y;  /* loop index over rows   */
+
+    for (p = 0; p < 4; p++) {
+	if (dst <= src) {
+	    for (y = 0; height > y; y++) {
+		copy_vram_row (p, dst + y * stride, src + y * stride, width,
+			       1);
+	    }
+	} else {
+	    for (y = height; y-- > 0; ) {
+		copy_vram_row (p, dst + y * stride, src + y * stride, width,
+			       0);
+	    }
+	}
+    }
+}
+
+
+/*
+ * copy_vram_row
+ *   DESCRIPTION: Copy one row of a latch copy within a plane, wrapping 
+ *                addresses at the end of the plane.
+ *   INPUTS: p -- the plane (0-3)
+ *           dst -- video memory address of the destination
+ *           src -- video memory address of the source
+ *           width -- bytes to copy
+ *           forward -- 1 to copy first byte first (if the row wraps and
+ *                      overlaps itself), or 0 to copy last byte first
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void
+copy_vram_row (int p, uint16_t dst, uint16_t src, int width, int forward)
+{
+    int i;  /* loop index over bytes */
+
+    if (VIDEO_PLANE_SIZE >= dst + width && VIDEO_PLANE_SIZE >= src + width) {
+	(void)memmove (&plane[p][dst], &plane[p][src], width);
+	return;
+    }
+
+    /* Rows that wrap are rare; copy them a byte at a time. */
+    if (forward) {
+	for (i = 0; width > i; i++) {
+	    plane[p][(uint16_t)(dst + i)] = plane[p][(uint16_t)(src + i)];
+	}
+    } else {
+	for (i = width; i-- > 0; ) {
+	    plane[p][(uint16_t)(dst + i)] = plane[p][(uint16_t)(src + i)];
+	}
+    }
+}
+
+
+/*
+ * vmem_load_palette
+ *   DESCRIPTION: Write colors into the palette.
+ *   INPUTS: first -- first color to write
+ *           rgb -- 6-bit RGB values, three bytes per color
+ *           count -- number of colors to write
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: changes palette colors
+ */
+static void
+vmem_load_palette (int first, const unsigned char* rgb, int count)
+{
+    (void)memcpy (palette[first], rgb, count * 3);
+}
+
+
+/*
+ * vmem_write_status_bar
+ *   DESCRIPTION: Copy columns of the four planes of the status bar image
+ *                to the start of video memory.
+ *   INPUTS: img -- status bar image, one plane after another
+ *           x -- first byte of each row to copy
+ *           width -- bytes of each row to copy
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void
+vmem_write_status_bar (const unsigned char* img, int x, int width)
+{
+    int i;  /* loop index over video planes */
+    int y;  /* loop index over status bar rows */
+
+    for (i = 0; i < 4; i++) {
+	for (y = 0; VIDEO_STATUS_ROWS > y; y++) {
+	    vmem_write_plane (i, y * row_bytes + x, img + i * VIDEO_STATUS_SIZE
+			      + y * VIDEO_ROW_BYTES + x, width);
+	}
+    }
+}
+
+
+/*
+ * vmem_read_frame
+ *   DESCRIPTION: Get the displayed mode X frame as one color index per
+ *                pixel: the scrolling image from the start address 
+ *                (shifted by the pixel panning), followed by the status
+ *                bar from address 0 (where the VGA line compare register
+ *                splits the screen; the split part is not panned).  Also
+ *                get the palette.
+ *   INPUTS: none
+ *   OUTPUTS: pix -- IMAGE_X_DIM * (IMAGE_Y_DIM + VIDEO_STATUS_ROWS) color
+ *                   indices, row by row
+ *            rgb -- the 6-bit RGB palette
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void
+vmem_read_frame (unsigned char* pix, unsigned char rgb[256][3])
+{
+    int      x, y; /* pixel coordinates on screen      */
+    int      px;   /* panned x coordinate              */
+    uint16_t addr; /* video memory address of a pixel  */
+
+    for (y = 0; IMAGE_Y_DIM + VIDEO_STATUS_ROWS > y; y++) {
+	for (x = 0; IMAGE_X_DIM > x; x++) {
+	    if (IMAGE_Y_DIM > y) {
+		px = x + pan_pixels;
+		addr = start_addr + y * row_bytes + (px >> 2);
+	    } else {
+		px = x;
+		addr = (y - IMAGE_Y_DIM) * row_bytes + (px >> 2);
+	    }
+	    *pix++ = plane[px & 3][addr];
+	}
+    }
+    (void)memcpy (rgb, palette, sizeof (palette));
+}
+
+
+/*
+ * vmem_dump_ppm
+ *   DESCRIPTION: Write the displayed mode X frame as a binary PPM image.
+ *   INPUTS: fname -- output file name
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on failure
+ *   SIDE EFFECTS: writes a file
+ */
+int
+vmem_dump_ppm (const char* fname)
+{
+    static unsigned char pix[IMAGE_X_DIM * (IMAGE_Y_DIM + VIDEO_STATUS_ROWS)];
+    unsigned char  pal[256][3];	 /* palette                     */
+    FILE*          out;		 /* output file                 */
+    int            x, y;	 /* pixel coordinates on screen */
+    const unsigned char* rgb;	 /* palette color of pixel      */
+    unsigned char  row[IMAGE_X_DIM * 3]; /* 8-bit RGB row       */
+
+    if (NULL == (out = fopen (fname, "wb"))) {
+        return -1;
+    }
+    vmem_read_frame (pix, pal);
+    fprintf (out, "P6\n%d %d\n255\n", IMAGE_X_DIM,
+	     IMAGE_Y_DIM + VIDEO_STATUS_ROWS);
+    for (y = 0; IMAGE_Y_DIM + VIDEO_STATUS_ROWS > y; y++) {
+	for (x = 0; IMAGE_X_DIM > x; x++) {
+	    rgb = pal[pix[y * IMAGE_X_DIM + x]];
+
+	    /* Scale 6-bit color to 8 bits. */
+	    row[3 * x] = (rgb[0] << 2) | (rgb[0] >> 4);
+	    row[3 * x + 1] = (rgb[1] << 2) | (rgb[1] >> 4);
+	    row[3 * x + 2] = (rgb[2] << 2) | (rgb[2] >> 4);
+	}
+	if (1 != fwrite (row, sizeof (row), 1, out)) {
+	    (void)fclose (out);
+	    return -1;
+	}
+    }
+    return (0 == fclose (out) ? 0 : -1);
+}
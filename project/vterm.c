@@ -0,0 +1,638 @@
+/*									tab:8
+ *
+ * vterm.c - ANSI terminal video backend
+ *
+ * "Copyright (c) 2026 by Tianzuo Qin."
+ *
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation for any purpose, without fee, and without written agreement is
+ * hereby granted, provided that the above copyright notice and the following
+ * two paragraphs appear in all copies of this software.
+ *
+ * IN NO EVENT SHALL THE AUTHOR OR THE UNIVERSITY OF ILLINOIS BE LIABLE TO
+ * ANY PARTY FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL
+ * DAMAGES ARISING OUT  OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+ * EVEN IF THE AUTHOR AND/OR THE UNIVERSITY OF ILLINOIS HAS BEEN ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THE AUTHOR AND THE UNIVERSITY OF ILLINOIS SPECIFICALLY DISCLAIM ANY
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE
+ * PROVIDED HEREUNDER IS ON AN "AS IS" BASIS, AND NEITHER THE AUTHOR NOR
+ * THE UNIVERSITY OF ILLINOIS HAS ANY OBLIGATION TO PROVIDE MAINTENANCE,
+ * SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS."
+ *
+ * Author:	    Tianzuo Qin
+ * Version:	    1
+ * Creation Date:   Sun Oct 18 21:47:12 2026
+ * Filename:	    vterm.c
+ * History:
+ *	TQ	1	Sun Oct 18 21:47:12 2026
+ *		First written.
+ */
+
+
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "modex.h"
+#include "video.h"
+
+
+/*
+ * The terminal backend keeps video memory in the in-memory backend, and 
+ * on each present converts the displayed frame into character cells:
+ * each cell shows two pixels, one above the other, as an upper half 
+ * block with the upper pixel's color as the foreground and the lower 
+ * pixel's color as the background (24-bit ANSI colors).  At scale s, 
+ * each half of a cell averages an s x s box of pixels.
+ *
+ * Only cells that differ from what the terminal shows are sent.  The
+ * cursor is moved to the first changed cell of each run, and short gaps
+ * of unchanged cells within a run are redrawn rather than skipped, since
+ * that is cheaper than a cursor move.  Colors are sent only when they
+ * change from the previous cell.
+ *
+ * Output per frame is limited to ADVENTURE_TERM_BYTES bytes (default
+ * TERM_DEF_BYTES); cells not sent remain different from the terminal and
+ * are sent with later frames.  When the limit is reached, or a write 
+ * blocks for longer than TERM_SLOW_USEC, for TERM_SLOW_FRAMES frames in a
+ * row, the terminal cannot keep up and the scale grows (halving output
+ * roughly four times over).  After TERM_FAST_FRAMES frames using less than
+ * a quarter of the limit, the scale shrinks again, but never below the
+ * smallest scale that fits the terminal (or ADVENTURE_TERM_SCALE).
+ */
+#define TERM_X_DIM        IMAGE_X_DIM
+#define TERM_Y_DIM        (IMAGE_Y_DIM + VIDEO_STATUS_ROWS)
+#define TERM_MAX_SCALE    8
+#define TERM_MAX_COLS     TERM_X_DIM
+#define TERM_MAX_ROWS     ((TERM_Y_DIM + 1) / 2)
+#define TERM_DEF_BYTES    65536
+#define TERM_CELL_BYTES   56	/* most bytes sent for one cell      */
+#define TERM_GAP_CELLS    2	/* unchanged cells redrawn in a run  */
+#define TERM_SLOW_USEC    20000
+#define TERM_SLOW_FRAMES  4
+#define TERM_FAST_FRAMES  60
+#define TERM_NO_CELL      (~(uint64_t)0)
+
+
+/* local functions--see function headers for details */
+static int vterm_open (void);
+static void vterm_close (void);
+static void vterm_set_mode (video_mode_t mode);
+static void vterm_clear (void);
+static void vterm_write_plane (int plane, uint16_t addr,
+			       const unsigned char* src, int len);
+static void vterm_present (uint16_t start, int pan);
+static void vterm_set_row_bytes (int row_bytes);
+static void vterm_copy_vram (uint16_t dst, uint16_t src, int width,
+			     int height, int stride);
+static void vterm_load_palette (int first, const unsigned char* rgb,
+				int count);
+static void vterm_write_status_bar (const unsigned char* img, int x,
+				    int width);
+static void set_scale (int s);
+static void make_cells (void);
+static uint32_t box_color (int x0, int y0);
+static int draw_cells (void);
+static int put_color (char* out, int bg, uint32_t rgb);
+static void term_write (const char* buf, int len);
+
+
+/* the terminal backend */
+const video_ops_t vterm_video = {
+    "term", vterm_open, vterm_close, vterm_set_mode, vterm_clear,
+    vterm_write_plane, vterm_present, vterm_set_row_bytes, vterm_copy_vram,
+    vterm_load_palette, vterm_write_status_bar
+};
+
+/* frame last presented and its cells at the current scale */
+static unsigned char pix[TERM_X_DIM * TERM_Y_DIM];
+static unsigned char pal[256][3];
+static uint64_t cell[TERM_MAX_ROWS][TERM_MAX_COLS]; /* upper, lower RGB */
+static uint64_t shown[TERM_MAX_ROWS][TERM_MAX_COLS]; /* on the terminal */
+static int      scale;		/* pixels per half cell, each way     */
+static int      min_scale;	/* smallest scale allowed             */
+static int      cols, rows;	/* cells at the current scale         */
+static int      active;		/* 1 while the terminal shows mode X  */
+
+/* output limit, adaptation, and statistics */
+static char     out_buf[TERM_DEF_BYTES * 4 + TERM_CELL_BYTES * 2];
+static int      max_bytes = TERM_DEF_BYTES;
+static int      slow_frames;	/* frames in a row over budget        */
+static int      fast_frames;	/* frames in a row well under budget  */
+static int      slow_write;	/* 1 if the last write blocked        */
+static uint32_t term_frames;	/* frames presented                   */
+static uint32_t term_capped;	/* frames cut off by the limit        */
+static int      term_last;	/* bytes sent for the last frame      */
+static uint32_t term_max;	/* most bytes sent for one frame      */
+static uint64_t term_total;	/* bytes sent for all frames          */
+static uint32_t term_rescales;	/* changes of scale                   */
+
+
+/*
+ * vterm_open
+ *   DESCRIPTION: Open the terminal backend: choose the output limit and
+ *                the smallest scale that fits the terminal.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on failure
+ *   SIDE EFFECTS: reads ADVENTURE_TERM_BYTES and ADVENTURE_TERM_SCALE
+ */
+static int
+vterm_open ()
+{
+    struct winsize ws;	/* terminal size      */
+    const char* name;	/* environment value  */
+    int s;		/* scale under test   */
+
+    name = getenv ("ADVENTURE_TERM_BYTES");
+    max_bytes = (NULL == name ? TERM_DEF_BYTES : atoi (name));
+    if (TERM_CELL_BYTES > max_bytes || TERM_DEF_BYTES * 4 < max_bytes) {
+	fprintf (stderr, "ADVENTURE_TERM_BYTES must be from %d to %d\n",
+		 TERM_CELL_BYTES, TERM_DEF_BYTES * 4);
+        return -1;
+    }
+
+    /* Find the smallest scale that fits, if the size is known. */
+    min_scale = 1;
+    if (0 == ioctl (STDOUT_FILENO, TIOCGWINSZ, &ws) && 0 < ws.ws_col &&
+	0 < ws.ws_row) {
+	for (s = 1; TERM_MAX_SCALE > s; s++) {
+	    if ((TERM_X_DIM + s - 1) / s <= ws.ws_col &&
+		(TERM_Y_DIM + 2 * s - 1) / (2 * s) <= ws.ws_row) {
+	        break;
+	    }
+	}
+	min_scale = s;
+    }
+    name = getenv ("ADVENTURE_TERM_SCALE");
+    if (NULL != name && 1 <= atoi (name) && TERM_MAX_SCALE >= atoi (name)) {
+        min_scale = atoi (name);
+    }
+    term_frames = term_capped = term_max = term_rescales = 0;
+    term_total = 0;
+    return vmem_video.open ();
+}
+
+
+/*
+ * vterm_close
+ *   DESCRIPTION: Close the terminal backend, restoring the terminal.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: writes to the terminal
+ */
+static void
+vterm_close ()
+{
+    vterm_set_mode (VIDEO_MODE_TEXT);
+    vmem_video.close ();
+}
+
+
+/*
+ * vterm_set_mode
+ *   DESCRIPTION: Set the display mode.  Mode X switches the terminal to
+ *                its alternate screen with the cursor hidden; text mode
+ *                switches back.
+ *   INPUTS: mode -- the mode to set
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: writes to the terminal; may clear video memory
+ */
+static void
+vterm_set_mode (video_mode_t mode)
+{
+    static const char enter[] = "\033[?1049h\033[?25l";
+    static const char leave[] = "\033[0m\033[?25h\033[?1049l";
+
+    vmem_video.set_mode (mode);
+    if (VIDEO_MODE_X == mode && !active) {
+	term_write (enter, sizeof (enter) - 1);
+	active = 1;
+	set_scale (min_scale);
+    } else if (VIDEO_MODE_TEXT == mode && active) {
+	term_write (leave, sizeof (leave) - 1);
+	active = 0;
+    }
+}
+
+
+/*
+ * vterm_present
+ *   DESCRIPTION: Display a screen image, and send the cells that changed
+ *                to the terminal, adapting the scale to how well the 
+ *                terminal keeps up.
+ *   INPUTS: start -- video memory address of the screen image
+ *           pan -- pixels (0-3) to shift the image left
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: writes to the terminal
+ */
+static void
+vterm_present (uint16_t start, int pan)
+{
+    int capped;  /* 1 if output was cut off */
+
+    vmem_video.present (start, pan);
+    if (!active) {
+        return;
+    }
+    vmem_read_frame (pix, pal);
+    make_cells ();
+    capped = draw_cells ();
+    term_frames++;
+
+    /* Grow the scale if the terminal falls behind; shrink it if not. */
+    if (capped || slow_write) {
+	fast_frames = 0;
+	if (TERM_SLOW_FRAMES <= ++slow_frames && TERM_MAX_SCALE > scale) {
+	    set_scale (scale + 1);
+	}
+    } else if (max_bytes / 4 > term_last) {
+	slow_frames = 0;
+	if (TERM_FAST_FRAMES <= ++fast_frames && min_scale < scale) {
+	    set_scale (scale - 1);
+	}
+    } else {
+        slow_frames = fast_frames = 0;
+    }
+}
+
+
+/*
+ * vterm_report
+ *   DESCRIPTION: Print the bytes sent to the terminal per frame.
+ *   INPUTS: f -- stream for the report
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void
+vterm_report (FILE* f)
+{
+    if (0 == term_frames) {
+        return;
+    }
+    fprintf (f, "terminal: %u frames, %.0f bytes/frame (max %u, limit %d), "
+	     "%u cut off, scale %d (%u changes)\n", term_frames, 
+	     (double)term_total / term_frames, term_max, max_bytes, 
+	     term_capped, scale, term_rescales);
+}
+
+
+/*
+ * set_scale
+ *   DESCRIPTION: Change the scale, clearing the terminal so that all 
+ *                cells are sent with the next frame.
+ *   INPUTS: s -- new scale (1 to TERM_MAX_SCALE)
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: writes to the terminal
+ */
+static void
+set_scale (int s)
+{
+    static const char clear[] = "\033[0m\033[2J";
+    int r, c;  /* loop indices over cells */
+
+    if (0 != scale && s != scale) {
+        term_rescales++;
+    }
+    scale = s;
+    cols = (TERM_X_DIM + s - 1) / s;
+    rows = (TERM_Y_DIM + 2 * s - 1) / (2 * s);
+    for (r = 0; TERM_MAX_ROWS > r; r++) {
+	for (c = 0; TERM_MAX_COLS > c; c++) {
+	    shown[r][c] = TERM_NO_CELL;
+	}
+    }
+    slow_frames = fast_frames = 0;
+    term_write (clear, sizeof (clear) - 1);
+}
+
+
+/*
+ * make_cells
+ *   DESCRIPTION: Convert the frame last presented into cells at the 
+ *                current scale.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void
+make_cells ()
+{
+    int r, c;  /* loop indices over cells */
+
+    for (r = 0; rows > r; r++) {
+	for (c = 0; cols > c; c++) {
+	    cell[r][c] = (((uint64_t)box_color (c * scale, 2 * r * scale) << 24)
+			  | box_color (c * scale, (2 * r + 1) * scale));
+	}
+    }
+}
+
+
+/*
+ * box_color
+ *   DESCRIPTION: Average the colors of a box of scale x scale pixels,
+ *                clipped to the frame (black if entirely outside).
+ *   INPUTS: (x0,y0) -- upper left pixel of the box
+ *   OUTPUTS: none
+ *   RETURN VALUE: 8-bit RGB color, red in the most significant byte
+ *   SIDE EFFECTS: none
+ */
+static uint32_t
+box_color (int x0, int y0)
+{
+    int x, y;		/* pixel coordinates          */
+    int x1, y1;		/* end of box (clipped)       */
+    int sum[3] = {0, 0, 0}; /* sums of 6-bit components */
+    int n;		/* pixels in box              */
+    int i;		/* loop index over components */
+    const unsigned char* rgb; /* color of a pixel     */
+    uint32_t col = 0;	/* result                     */
+
+    x1 = (TERM_X_DIM < x0 + scale ? TERM_X_DIM : x0 + scale);
+    y1 = (TERM_Y_DIM < y0 + scale ? TERM_Y_DIM : y0 + scale);
+    if (x0 >= x1 || y0 >= y1) {
+        return 0;
+    }
+    for (y = y0; y1 > y; y++) {
+	for (x = x0; x1 > x; x++) {
+	    rgb = pal[pix[y * TERM_X_DIM + x]];
+	    sum[0] += rgb[0];
+	    sum[1] += rgb[1];
+	    sum[2] += rgb[2];
+	}
+    }
+    n = (x1 - x0) * (y1 - y0);
+
+    /* Scale 6-bit color to 8 bits. */
+    for (i = 0; i < 3; i++) {
+	col = (col << 8) | ((sum[i] * 255 + n * 63 / 2) / (n * 63));
+    }
+    return col;
+}
+
+
+/*
+ * draw_cells
+ *   DESCRIPTION: Send the cells that differ from what the terminal shows,
+ *                up to the output limit.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if the limit cut off the output, or 0 if not
+ *   SIDE EFFECTS: writes to the terminal
+ */
+static int
+draw_cells ()
+{
+    int      len = 0;		/* bytes in out_buf                 */
+    int      r, c;		/* loop indices over cells          */
+    int      k;			/* loop index over gap cells        */
+    int      cur_r = -1;	/* cursor row, or -1 if unknown     */
+    int      cur_c = -1;	/* cursor column                    */
+    int64_t  fg = -1, bg = -1;	/* colors set, or -1 if unknown     */
+    uint32_t top, bot;		/* colors of upper and lower pixels */
+    int      capped = 0;	/* 1 if the limit was reached       */
+
+    for (r = 0; rows > r && !capped; r++) {
+	for (c = 0; cols > c; c++) {
+
+	    /* Skip unchanged cells, except short gaps within a run. */
+	    if (shown[r][c] == cell[r][c]) {
+		if (cur_r != r || cur_c != c) {
+		    continue;
+		}
+		for (k = 1; TERM_GAP_CELLS >= k && cols > c + k && 
+		     shown[r][c + k] == cell[r][c + k]; k++) {
+		}
+		if (TERM_GAP_CELLS < k || cols <= c + k) {
+		    continue;
+		}
+	    }
+	    if (max_bytes - TERM_CELL_BYTES < len) {
+	        capped = 1;
+		break;
+	    }
+
+	    if (cur_r != r || cur_c != c) {
+		len += sprintf (out_buf + len, "\033[%d;%dH", r + 1, c + 1);
+	    }
+	    top = cell[r][c] >> 24;
+	    bot = cell[r][c] & 0xFFFFFF;
+	    if (bg != bot) {
+		len += put_color (out_buf + len, 1, bot);
+		bg = bot;
+	    }
+	    if (top == bot) {
+		out_buf[len++] = ' ';
+	    } else {
+		if (fg != top) {
+		    len += put_color (out_buf + len, 0, top);
+		    fg = top;
+		}
+		(void)memcpy (out_buf + len, "\342\226\200", 3); /* U+2580 */
+		len += 3;
+	    }
+	    shown[r][c] = cell[r][c];
+
+	    /* The cursor position is unknown after the last column. */
+	    cur_r = (cols > c + 1 ? r : -1);
+	    cur_c = c + 1;
+	}
+    }
+    term_write (out_buf, len);
+
+    term_last = len;
+    term_total += len;
+    if (term_max < (uint32_t)len) {
+        term_max = len;
+    }
+    if (capped) {
+        term_capped++;
+    }
+    return capped;
+}
+
+
+/*
+ * put_color
+ *   DESCRIPTION: Write an escape sequence setting a 24-bit color.
+ *   INPUTS: bg -- 1 for the background color, 0 for the foreground
+ *           rgb -- 8-bit RGB color, red in the most significant byte
+ *   OUTPUTS: out -- the escape sequence (at most 19 bytes, no NUL)
+ *   RETURN VALUE: length of the sequence
+ *   SIDE EFFECTS: none
+ */
+static int
+put_color (char* out, int bg, uint32_t rgb)
+{
+    char seq[24];  /* sequence with terminating NUL */
+    int len;	   /* length of sequence            */
+
+    len = sprintf (seq, "\033[%d;2;%u;%u;%um", (bg ? 48 : 38), 
+		   (rgb >> 16) & 0xFF, (rgb >> 8) & 0xFF, rgb & 0xFF);
+    (void)memcpy (out, seq, len);
+    return len;
+}
+
+
+/*
+ * term_write
+ *   DESCRIPTION: Write to the terminal, noting whether the write blocked
+ *                for long (the terminal is not keeping up).
+ *   INPUTS: buf -- bytes to write
+ *           len -- number of bytes
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: sets slow_write
+ */
+static void
+term_write (const char* buf, int len)
+{
+    struct timespec t0, t1;  /* start and end of write */
+    ssize_t n;		     /* bytes written          */
+    struct pollfd pfd;	     /* wait until writable    */
+
+    (void)clock_gettime (CLOCK_MONOTONIC, &t0);
+    while (0 < len) {
+	if (0 > (n = write (STDOUT_FILENO, buf, len))) {
+
+	    /* The terminal may share non-blocking mode with the input. */
+	    if (EAGAIN == errno || EINTR == errno) {
+		pfd.fd = STDOUT_FILENO;
+		pfd.events = POLLOUT;
+		(void)poll (&pfd, 1, TERM_SLOW_USEC / 1000);
+	        continue;
+	    }
+	    break;
+	}
+	buf += n;
+	len -= n;
+    }
+    (void)clock_gettime (CLOCK_MONOTONIC, &t1);
+    slow_write = (TERM_SLOW_USEC < (t1.tv_sec - t0.tv_sec) * 1000000 + 
+		  (t1.tv_nsec - t0.tv_nsec) / 1000);
+}
+
+
+/*
+ * The remaining operations act on the in-memory backend's video memory.
+ */
+
+/*
+ * vterm_clear
+ *   DESCRIPTION: Fill video memory with zeroes.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: clears all four planes
+ */
+static void
+vterm_clear ()
+{
+    vmem_video.clear ();
+}
+
+
+/*
+ * vterm_write_plane
+ *   DESCRIPTION: Copy data into one plane of video memory.
+ *   INPUTS: plane -- the plane (0-3) to write
+ *           addr -- the destination offset in video memory
+ *           src -- the data to copy
+ *           len -- number of bytes to copy
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void
+vterm_write_plane (int plane, uint16_t addr, const unsigned char* src,
+		   int len)
+{
+    vmem_video.write_plane (plane, addr, src, len);
+}
+
+
+/*
+ * vterm_set_row_bytes
+ *   DESCRIPTION: Set the distance between display rows in video memory.
+ *   INPUTS: row_bytes -- bytes per row in each plane
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void
+vterm_set_row_bytes (int row_bytes)
+{
+    vmem_video.set_row_bytes (row_bytes);
+}
+
+
+/*
+ * vterm_copy_vram
+ *   DESCRIPTION: Copy a rectangle of video memory in all four planes.
+ *   INPUTS: dst -- video memory address of destination rectangle
+ *           src -- video memory address of source rectangle
+ *           width -- bytes per row in each plane
+ *           height -- number of rows
+ *           stride -- distance between rows in bytes
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void
+vterm_copy_vram (uint16_t dst, uint16_t src, int width, int height,
+		 int stride)
+{
+    vmem_video.copy_vram (dst, src, width, height, stride);
+}
+
+
+/*
+ * vterm_load_palette
+ *   DESCRIPTION: Load palette colors; the terminal shows them with the
+ *                next frame.
+ *   INPUTS: first -- first color to load
+ *           rgb -- 6-bit RGB values, three bytes per color
+ *           count -- number of colors to load
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void
+vterm_load_palette (int first, const unsigned char* rgb, int count)
+{
+    vmem_video.load_palette (first, rgb, count);
+}
+
+
+/*
+ * vterm_write_status_bar
+ *   DESCRIPTION: Copy columns of a status bar image to the start of video
+ *                memory.
+ *   INPUTS: img -- status bar image, one plane after another
+ *           x -- first byte of each row to copy
+ *           width -- bytes of each row to copy
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void
+vterm_write_status_bar (const unsigned char* img, int x, int width)
+{
+    vmem_video.write_status_bar (img, x, width);
+}
@@ -0,0 +1,290 @@
+/*									tab:8
+ *
+ * wheel.c - hierarchical timer wheel driven by game loop ticks
+ *
+ * "Copyright (c) 2026 by Tianzuo Qin."
+ *
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation for any purpose, without fee, and without written agreement is
+ * hereby granted, provided that the above copyright notice and the following
+ * two paragraphs appear in all copies of this software.
+ *
+ * IN NO EVENT SHALL THE AUTHOR OR THE UNIVERSITY OF ILLINOIS BE LIABLE TO
+ * ANY PARTY FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL
+ * DAMAGES ARISING OUT  OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+ * EVEN IF THE AUTHOR AND/OR THE UNIVERSITY OF ILLINOIS HAS BEEN ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THE AUTHOR AND THE UNIVERSITY OF ILLINOIS SPECIFICALLY DISCLAIM ANY
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE
+ * PROVIDED HEREUNDER IS ON AN "AS IS" BASIS, AND NEITHER THE AUTHOR NOR
+ * THE UNIVERSITY OF ILLINOIS HAS ANY OBLIGATION TO PROVIDE MAINTENANCE,
+ * SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS."
+ *
+ * Author:	    Tianzuo Qin
+ * Version:	    1
+ * Creation Date:   Sun Oct 18 20:41:07 2026
+ * Filename:	    wheel.c
+ * History:
+ *	TQ	1	Sun Oct 18 20:41:07 2026
+ *		First written.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "wheel.h"
+
+
+/* 
+ * Wheel geometry: WHEEL_LEVELS levels of WHEEL_SLOTS slots covers
+ * 2^24 ticks (more than nine days of 50 millisecond ticks); timers
+ * further out are clamped to the last tick covered.
+ */
+#define WHEEL_BITS    6
+#define WHEEL_SLOTS   (1 << WHEEL_BITS)
+#define WHEEL_MASK    (WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS  4
+#define WHEEL_RANGE   (1UL << (WHEEL_BITS * WHEEL_LEVELS))
+
+
+/* local functions--see function headers for details */
+static void insert_timer (wheel_timer_t* t);
+static void unlink_timer (wheel_timer_t* t);
+static int cascade (int level);
+
+
+/* file-scope variables */
+
+static wheel_timer_t* slot[WHEEL_LEVELS][WHEEL_SLOTS]; /* timer lists  */
+static uint32_t wheel_now;	/* last tick processed                 */
+static uint32_t num_pending;	/* timers in the wheel                 */
+static uint32_t num_added, num_cancelled, num_fired, num_cascaded;
+
+
+/*
+ * wheel_add
+ *   DESCRIPTION: Schedule a timer to call fn (arg) delay ticks after the
+ *                last tick processed by wheel_advance.  A pending timer
+ *                is moved to the new time.
+ *   INPUTS: t -- the timer
+ *           delay -- ticks until the timer fires (0 is treated as 1)
+ *           fn -- function to call when the timer fires
+ *           arg -- argument to pass to fn
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: links the timer into the wheel
+ */
+void
+wheel_add (wheel_timer_t* t, uint32_t delay, void (*fn) (void* arg), 
+	   void* arg)
+{
+    if (NULL != t->pprev) {
+	unlink_timer (t);
+    } else {
+	num_pending++;
+    }
+    if (0 == delay) {
+	delay = 1;
+    } else if (WHEEL_RANGE <= delay) {
+	delay = WHEEL_RANGE - 1;
+    }
+    t->expires = wheel_now + delay;
+    t->fn = fn;
+    t->arg = arg;
+    insert_timer (t);
+    num_added++;
+}
+
+
+/*
+ * wheel_cancel
+ *   DESCRIPTION: Cancel a timer.  Does nothing if the timer is idle.
+ *   INPUTS: t -- the timer
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: unlinks the timer from the wheel
+ */
+void
+wheel_cancel (wheel_timer_t* t)
+{
+    if (NULL != t->pprev) {
+	unlink_timer (t);
+	num_pending--;
+	num_cancelled++;
+    }
+}
+
+
+/*
+ * wheel_pending
+ *   DESCRIPTION: Check whether a timer is waiting to fire.
+ *   INPUTS: t -- the timer
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if the timer is pending, or 0 if not
+ *   SIDE EFFECTS: none
+ */
+int
+wheel_pending (const wheel_timer_t* t)
+{
+    return (NULL != t->pprev);
+}
+
+
+/*
+ * wheel_advance
+ *   DESCRIPTION: Process each tick after the last one processed, up to
+ *                and including now.  At each tick, timers due in the
+ *                next WHEEL_SLOTS ticks are moved down from the higher
+ *                levels when the first level wraps around, and the 
+ *                timers due at the tick are fired.  Ticks skipped by
+ *                the game loop are processed here, so timers never fire
+ *                early and are never lost.
+ *   INPUTS: now -- the current tick
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: calls timer functions, which may add and cancel timers
+ */
+void
+wheel_advance (uint32_t now)
+{
+    wheel_timer_t* t;	/* timer to fire      */
+    int level;		/* level to cascade   */
+
+    while ((int32_t)(now - wheel_now) > 0) {
+
+	/* With nothing pending, there is nothing to do at any tick. */
+	if (0 == num_pending) {
+	    wheel_now = now;
+	    break;
+	}
+	wheel_now++;
+
+	/* 
+	 * When the first level wraps, move the next slot of the second
+	 * level down, and so on up the levels while each one also wraps.
+	 */
+	for (level = 1; WHEEL_LEVELS > level && cascade (level); level++) {
+	}
+
+	/* Fire timers due now; each is idle before its function runs. */
+	while (NULL != (t = slot[0][wheel_now & WHEEL_MASK])) {
+	    unlink_timer (t);
+	    num_pending--;
+	    num_fired++;
+	    t->fn (t->arg);
+	}
+    }
+}
+
+
+/*
+ * wheel_report
+ *   DESCRIPTION: Print counts of timers added, cancelled, fired, and 
+ *                moved down a level.
+ *   INPUTS: f -- file to which to print
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: prints to f
+ */
+void
+wheel_report (FILE* f)
+{
+    fprintf (f, "timer wheel: %u added, %u cancelled, %u fired, "
+	     "%u moved down, %u pending\n", num_added, num_cancelled,
+	     num_fired, num_cascaded, num_pending);
+}
+
+
+/*
+ * insert_timer
+ *   DESCRIPTION: Link a timer into the slot for its expiry time: in the
+ *                first level if due within WHEEL_SLOTS ticks, in the 
+ *                second if due within WHEEL_SLOTS^2 ticks, and so on.
+ *                A timer moved down at the tick at which it is due goes
+ *                into the first level's slot for that tick.
+ *   INPUTS: t -- the timer, with expires set (not before wheel_now)
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: links the timer into the wheel
+ */
+static void
+insert_timer (wheel_timer_t* t)
+{
+    uint32_t delta;	/* ticks until expiry */
+    uint32_t idx;	/* slot index         */
+    int level;		/* wheel level        */
+
+    delta = t->expires - wheel_now;
+    for (level = 0; WHEEL_LEVELS - 1 > level && 
+		    (delta >> (WHEEL_BITS * (level + 1))) != 0; level++) {
+    }
+    idx = (t->expires >> (WHEEL_BITS * level)) & WHEEL_MASK;
+
+    t->next = slot[level][idx];
+    if (NULL != t->next) {
+	t->next->pprev = &t->next;
+    }
+    t->pprev = &slot[level][idx];
+    *t->pprev = t;
+}
+
+
+/*
+ * unlink_timer
+ *   DESCRIPTION: Remove a pending timer from its slot.
+ *   INPUTS: t -- the timer
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: marks the timer idle
+ */
+static void
+unlink_timer (wheel_timer_t* t)
+{
+    *t->pprev = t->next;
+    if (NULL != t->next) {
+	t->next->pprev = t->pprev;
+    }
+    t->next = NULL;
+    t->pprev = NULL;
+}
+
+
+/*
+ * cascade
+ *   DESCRIPTION: If the levels below a level have just wrapped around,
+ *                move the timers in the level's current slot, which are
+ *                all due within the range of the lower levels, down to
+ *                their slots there.
+ *   INPUTS: level -- the level to cascade (at least one)
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if this level also wrapped, so that the next level
+ *                 up should be cascaded, or 0 if not
+ *   SIDE EFFECTS: moves timers within the wheel
+ */
+static int
+cascade (int level)
+{
+    wheel_timer_t* list;	/* timers taken from the slot */
+    wheel_timer_t* t;		/* timer to move              */
+    uint32_t idx;		/* slot index at this level   */
+
+    if (0 != (wheel_now & ((1UL << (WHEEL_BITS * level)) - 1))) {
+	return 0;
+    }
+    idx = (wheel_now >> (WHEEL_BITS * level)) & WHEEL_MASK;
+
+    /* Detach the whole list first, since timers may move to this slot. */
+    list = slot[level][idx];
+    slot[level][idx] = NULL;
+    if (NULL != list) {
+	list->pprev = &list;
+    }
+    while (NULL != (t = list)) {
+	unlink_timer (t);
+	insert_timer (t);
+	num_cascaded++;
+    }
+    return (0 == idx);
+}
@@ -0,0 +1,84 @@
+/*									tab:8
+ *
+ * wheel.h - header file for the hierarchical timer wheel
+ *
+ * "Copyright (c) 2026 by Tianzuo Qin."
+ *
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation for any purpose, without fee, and without written agreement is
+ * hereby granted, provided that the above copyright notice and the following
+ * two paragraphs appear in all copies of this software.
+ *
+ * IN NO EVENT SHALL THE AUTHOR OR THE UNIVERSITY OF ILLINOIS BE LIABLE TO
+ * ANY PARTY FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL
+ * DAMAGES ARISING OUT  OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+ * EVEN IF THE AUTHOR AND/OR THE UNIVERSITY OF ILLINOIS HAS BEEN ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THE AUTHOR AND THE UNIVERSITY OF ILLINOIS SPECIFICALLY DISCLAIM ANY
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE
+ * PROVIDED HEREUNDER IS ON AN "AS IS" BASIS, AND NEITHER THE AUTHOR NOR
+ * THE UNIVERSITY OF ILLINOIS HAS ANY OBLIGATION TO PROVIDE MAINTENANCE,
+ * SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS."
+ *
+ * Author:	    Tianzuo Qin
+ * Version:	    1
+ * Creation Date:   Sun Oct 18 20:41:07 2026
+ * Filename:	    wheel.h
+ * History:
+ *	TQ	1	Sun Oct 18 20:41:07 2026
+ *		First written.
+ */
+#ifndef WHEEL_H
+#define WHEEL_H
+
+
+#include <stdint.h>
+#include <stdio.h>
+
+
+/*
+ * Timed engine events (such as expiring status messages) are scheduled
+ * on a hierarchical timer wheel that the game loop advances once per 
+ * tick, rather than on helper threads that sleep.  Times are counted in
+ * ticks.  The wheel has WHEEL_LEVELS levels of WHEEL_SLOTS slots; the
+ * first level holds timers due within WHEEL_SLOTS ticks, one tick per
+ * slot, and each further level holds timers WHEEL_SLOTS times further
+ * out, which move down a level as their time approaches.  Adding and
+ * cancelling a timer take constant time.  Timers are owned by the caller
+ * and linked into the wheel directly, so the wheel never allocates.
+ *
+ * The wheel is not thread-safe: only the game loop thread may use it.
+ */
+
+/* a timer; fields are private to the wheel (zero means idle) */
+typedef struct wheel_timer_t wheel_timer_t;
+struct wheel_timer_t {
+    wheel_timer_t*  next;		/* next timer in slot          */
+    wheel_timer_t** pprev;		/* link to us, or NULL if idle */
+    uint32_t        expires;		/* tick at which to fire       */
+    void (*fn) (void* arg);		/* called when timer fires     */
+    void*           arg;
+};
+
+/* 
+ * Arrange for fn (arg) to be called delay ticks from now (at least one).
+ * A timer that is already pending is moved. 
+ */
+extern void wheel_add (wheel_timer_t* t, uint32_t delay, 
+		       void (*fn) (void* arg), void* arg);
+
+/* cancel a timer if it is pending */
+extern void wheel_cancel (wheel_timer_t* t);
+
+/* return 1 if a timer is pending, or 0 if not */
+extern int wheel_pending (const wheel_timer_t* t);
+
+/* fire all timers due up to and including tick now */
+extern void wheel_advance (uint32_t now);
+
+/* print counts of timers added, cancelled, fired, and moved down */
+extern void wheel_report (FILE* f);
+
+#endif /* WHEEL_H */
@@ -34,11 +34,13 @@
  */
  
 
+#include <stdio.h>
 #include <string.h>
 #include <strings.h>
 
 #include "assert.h"
 #include "photo.h"
+#include "trace.h"
 #include "world.h"
 
 
@@ -184,6 +186,7 @@ struct room_t {
     room_t*     left;   	/* room to the "left"             */
     room_t*     enter;  	/* doors, etc.                    */
     room_t*     right;  	/* room to the "right"            */
+    uint32_t    entries;	/* times entered (for reports)    */
 };
 
 /*
@@ -444,6 +447,7 @@ static room_t   room[N_ROOMS];			     /* rooms                */
 static object_t object[N_OBJECTS];		     /* objects              */
 static uint32_t player_flags[(NUM_FLAGS + 31) / 32]; /* accomplishment flags */
 static photo_t* swap_photo[N_SWAPS];                 /* swapping photos      */
+static uint32_t swaps[N_SWAPS];                      /* times swapped        */
 
 
 /* 
@@ -464,6 +468,7 @@ do_photo_swap (room_t* r, int32_t which)
     tmp               = r->view;
     r->view           = swap_photo[which];
     swap_photo[which] = tmp;
+    swaps[which]++;
 }
 
 
@@ -864,8 +869,10 @@ room_photo_width (const room_t* r)
 int32_t
 build_world ()
 {
-    int32_t idx;	/* index over data arrays   */
-    int32_t which;	/* id for current data item */
+    int32_t  idx;	/* index over data arrays   */
+    int32_t  which;	/* id for current data item */
+    photo_t* photos[N_ROOMS + N_SWAPS]; /* all room photos read */
+    int32_t  n_photos = 0;		 /* number of photos read  */
 
     /* Clear all accomplishment flags. */
     (void)memset (player_flags, 0, sizeof (player_flags));
@@ -891,12 +898,15 @@ build_world ()
 
 	/* Set up the room. */
         room[which].name = room_data[idx].name;
+	TRACE_BEGIN (read_start);
 	room[which].view = read_photo (room_data[idx].filename);
+	TRACE_END ("read_photo", room_data[idx].filename, read_start);
 	if (NULL == room[which].view) {
 	    fprintf (stderr, "Can't read room photo %s.\n", 
 	    	     room_data[idx].filename);
 	    return 0;
 	}
+	photos[n_photos++] = room[which].view;
 	room[which].contents = NULL;
 	room[which].left  = (R_NONE == room_data[idx].left ? NULL : 
 			     &room[room_data[idx].left]);
@@ -969,14 +979,22 @@ build_world ()
 	}
 
 	/* Read in the swap photo. */
+	TRACE_BEGIN (read_start);
 	swap_photo[which] = read_photo (swap_data[idx].filename);
+	TRACE_END ("read_photo", swap_data[idx].filename, read_start);
 	if (NULL == swap_photo[which]) {
 	    fprintf (stderr, "Can't read room photo %s.\n", 
 	    	     swap_data[idx].filename);
 	    return 0;
 	}
+	photos[n_photos++] = swap_photo[which];
     }
 
+    /* Build the downscaled photos used by the overview mode. */
+    TRACE_BEGIN (pyramid_start);
+    build_photo_pyramids (photos, n_photos);
+    TRACE_END ("build_photo_pyramids", NULL, pyramid_start);
+
     /* Everything worked! */
     return 1;
 }
@@ -998,6 +1016,62 @@ start_in_room ()
 }
 
 
+/* 
+ * room_enter
+ *   DESCRIPTION: Count an entry to a room, for world_report.
+ *   INPUTS: r -- the room entered
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void
+room_enter (room_t* r)
+{
+    r->entries++;
+}
+
+
+/* 
+ * world_report
+ *   DESCRIPTION: Print the number of rooms entered and of entries, the
+ *                times that each swapping photo was swapped, and the 
+ *                names of any rooms never entered.
+ *   INPUTS: f -- output stream
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: prints to f
+ */
+void
+world_report (FILE* f)
+{
+    uint32_t entered;	/* rooms entered           */
+    uint32_t entries;	/* entries to all rooms    */
+    int32_t i;		/* index over rooms        */
+
+    entered = entries = 0;
+    for (i = 0; N_ROOMS > i; i++) {
+        entered += (0 != room[i].entries);
+	entries += room[i].entries;
+    }
+    if (0 == entries) {
+        return;
+    }
+    fprintf (f, "world: %u of %u rooms entered (%u entries); photos "
+	     "swapped %u times at the bridge, %u at the car\n", entered, 
+	     N_ROOMS, entries, swaps[SWAP_CIRCLE], swaps[SWAP_CAR]);
+    if (N_ROOMS == entered) {
+        return;
+    }
+    fprintf (f, "world: never entered");
+    for (i = 0; N_ROOMS > i; i++) {
+        if (0 == room[i].entries) {
+	    fprintf (f, " %d (%s)", i, room[i].name);
+	}
+    }
+    fprintf (f, "\n");
+}
+
+
 /* 
  * player_has_board
  *   DESCRIPTION: Check whether the player has the board in inventory.
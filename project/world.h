@@ -36,6 +36,8 @@
 #define WORLD_H
 
 
+#include <stdio.h>
+
 #include "types.h"
 
 
@@ -56,6 +58,12 @@ extern int32_t build_world (void);
 /* Get pointer to starting room for player. */
 extern room_t* start_in_room (void);
 
+/* Count an entry to a room (by the player). */
+extern void room_enter (room_t* r);
+
+/* Print the rooms entered and photos swapped. */
+extern void world_report (FILE* f);
+
 /*
  * checks for accelerator object ownership; these make horizontal (board)
  * and vertical (jetpack) pixel panning faster